@@ -0,0 +1,414 @@
+// Microbenchmarks for the in-process hot paths: message cleanup, payload building and escaping,
+// chat response parsing, diff rendering and untracked-file synthesis on a synthetic repository,
+// and log summaries. `--json FILE` writes the results for comparing builds with `--compare FILE`.
+#include <CLI/CLI.hpp>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "commit_message.hpp"
+#include "git_utils.hpp"
+#include "json_writer.hpp"
+#include "response_parser.hpp"
+#include "statistics.hpp"
+
+namespace fs = std::filesystem;
+
+struct BenchOptions {
+    std::string filter;          // Only benchmarks whose name contains this
+    double min_time = 0.5;       // Seconds spent measuring each benchmark
+    size_t diff_kib = 1024;      // Size of the diff for the payload benchmarks
+    int repo_files = 2000;       // Tracked files in the synthetic repository
+    int repo_modified = 200;     // Of which modified in the worktree
+    int repo_untracked = 50;
+    int file_lines = 60;
+    int log_entries = 100000;    // Entries in the synthetic generation stats log
+    std::string work_dir;        // Defaults to a new temporary directory, removed afterwards
+    std::string json_path;
+    std::string compare_path;
+};
+
+struct BenchResult {
+    std::string name;
+    size_t iterations = 0;
+    double mean_ns = 0.0;
+    double p50_ns = 0.0;
+    double p95_ns = 0.0;
+    double min_ns = 0.0;
+    size_t bytes = 0;  // Input bytes per iteration, 0 when throughput does not apply
+};
+
+// Changes the working directory until the end of the scope, also when a benchmark throws
+class ScopedCurrentPath {
+public:
+    explicit ScopedCurrentPath(const fs::path& dir) : previous_(fs::current_path()) { fs::current_path(dir); }
+    ~ScopedCurrentPath() {
+        std::error_code ec;
+        fs::current_path(previous_, ec);
+    }
+    ScopedCurrentPath(const ScopedCurrentPath&) = delete;
+    ScopedCurrentPath& operator=(const ScopedCurrentPath&) = delete;
+
+private:
+    fs::path previous_;
+};
+
+// Sends std::cout to `buffer` until the end of the scope
+class ScopedCoutBuffer {
+public:
+    explicit ScopedCoutBuffer(std::streambuf* buffer) : previous_(std::cout.rdbuf(buffer)) {}
+    ~ScopedCoutBuffer() { std::cout.rdbuf(previous_); }
+    ScopedCoutBuffer(const ScopedCoutBuffer&) = delete;
+    ScopedCoutBuffer& operator=(const ScopedCoutBuffer&) = delete;
+
+private:
+    std::streambuf* previous_;
+};
+
+static BenchOptions options;
+static std::vector<BenchResult> results;
+size_t bench_sink = 0;  // Not static, so that the results cannot be optimized away
+
+// Whether --filter can match a benchmark of the group, so that its setup can be skipped otherwise
+static bool wanted(const std::string& group) {
+    return options.filter.empty() || group.find(options.filter) != std::string::npos || options.filter.find(group) != std::string::npos;
+}
+
+// Times fn in batches long enough for the clock to be accurate, until min_time has passed.
+// With a setup function every call is timed on its own, after setup has run untimed.
+static void bench(const std::string& name, size_t bytes, const std::function<void()>& fn, const std::function<void()>& setup = nullptr) {
+    if (!options.filter.empty() && name.find(options.filter) == std::string::npos) return;
+    using clock = std::chrono::steady_clock;
+    auto time_batch = [&](size_t batch) {
+        if (setup) setup();
+        auto start = clock::now();
+        for (size_t i = 0; i < batch; ++i) fn();
+        return std::chrono::duration<double, std::nano>(clock::now() - start).count();
+    };
+
+    size_t batch = 1;
+    time_batch(1);  // Warm up
+    while (!setup && time_batch(batch) < 20000.0 && batch < (1u << 24)) {
+        batch *= 2;
+    }
+
+    std::vector<double> samples;
+    double total_ns = 0.0;
+    while (total_ns < options.min_time * 1e9 || samples.size() < 5) {
+        double ns = time_batch(batch);
+        total_ns += ns;
+        samples.push_back(ns / batch);
+    }
+    std::sort(samples.begin(), samples.end());
+
+    BenchResult result;
+    result.name = name;
+    result.iterations = samples.size() * batch;
+    result.mean_ns = total_ns / result.iterations;
+    result.p50_ns = samples[samples.size() / 2];
+    result.p95_ns = samples[std::min(samples.size() - 1, samples.size() * 95 / 100)];
+    result.min_ns = samples.front();
+    result.bytes = bytes;
+    results.push_back(result);
+
+    std::cout << std::left << std::setw(44) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(14) << result.p50_ns << std::setw(14) << result.p95_ns << std::setw(12) << result.iterations;
+    if (bytes > 0) {
+        std::cout << std::setw(10) << std::setprecision(2) << bytes / result.p50_ns;
+    }
+    std::cout << std::endl;
+}
+
+// Builds diff-shaped text: mostly ASCII source lines with tabs, quotes and the
+// occasional multi-byte character, which is what the payload path sees in practice.
+static std::string make_diff(size_t target_size) {
+    static const char* lines[] = {
+        "+    std::string payload = build_chat_payload(fields, instructions, diff);\n",
+        "-    if (model.find(\"claude-\") == 0) {\n",
+        "+\t\treturn \"$\" + std::to_string(balance); // see \\docs\\balance\n",
+        " // Gr\xC3\xBC\xC3\x9F" "e aus M\xC3\xBCnchen \xE2\x80\x94 \xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E\n",
+        "@@ -17,7 +17,9 @@ GenerationResult OpenRouterBackend::generate_commit_message(\n",
+    };
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<size_t> pick(0, std::size(lines) - 1);
+    std::string diff;
+    diff.reserve(target_size + 128);
+    while (diff.size() < target_size) {
+        size_t i = pick(rng);
+        // Non-ASCII lines are rare in real diffs
+        if (i == 3 && rng() % 8 != 0) i = 0;
+        diff += lines[i];
+    }
+    return diff;
+}
+
+static void bench_commit_message() {
+    std::string message =
+        "Add a stage graph for the commit flow\n\n"
+        "Run the status scan, the diff and the backend connection in parallel and wait for each\n"
+        "result where it is first needed. Failures propagate to dependent stages.\n";
+    std::string fenced = "```diff\n" + message + "```";
+    bench("clean_commit_message/plain", message.size(), [&] { bench_sink += clean_commit_message(message).size(); });
+    bench("clean_commit_message/fenced", fenced.size(), [&] { bench_sink += clean_commit_message(fenced).size(); });
+}
+
+static void bench_payload() {
+    if (!wanted("json/")) return;
+    std::string diff = make_diff(options.diff_kib * 1024);
+    std::string out;
+    bench("json/nlohmann_dump", diff.size(), [&] { bench_sink += nlohmann::json(diff).dump().size(); });
+    bench("json/append_json_string_scalar", diff.size(), [&] {
+        out.clear();
+        append_json_string_scalar(out, diff);
+        bench_sink += out.size();
+    });
+    bench(std::string("json/append_json_string_") + json_escape_kernel_name(), diff.size(), [&] {
+        out.clear();
+        append_json_string(out, diff);
+        bench_sink += out.size();
+    });
+    bench(std::string("json/is_valid_utf8_") + json_escape_kernel_name(), diff.size(), [&] { bench_sink += is_valid_utf8(diff); });
+
+    out.clear();
+    append_json_string(out, diff);
+    if (out != nlohmann::json(diff).dump()) {
+        throw std::runtime_error("append_json_string output differs from nlohmann::json::dump()");
+    }
+
+    nlohmann::json fields = {{"model", "openai/gpt-4o-mini"}, {"temperature", 0.7}, {"provider", {{"order", {"openai"}}}}};
+    std::string instructions(2048, 'i');
+    bench("json/build_chat_payload", diff.size(), [&] { bench_sink += build_chat_payload(fields, instructions, diff).size(); });
+}
+
+static void bench_response_parsing() {
+    std::string content = make_diff(2048);
+    nlohmann::json openai = {
+        {"id", "gen-1700000000-abcdefghijklmnop"},
+        {"object", "chat.completion"},
+        {"model", "openai/gpt-4o-mini"},
+        {"choices", {{{"index", 0}, {"finish_reason", "stop"}, {"message", {{"role", "assistant"}, {"content", content}}}}}},
+        {"usage", {{"prompt_tokens", 12000}, {"completion_tokens", 80}, {"total_tokens", 12080}, {"prompt_tokens_details", {{"cached_tokens", 8000}}}}}
+    };
+    nlohmann::json anthropic = {
+        {"id", "msg_01XFDUDYJgAACzvnptvVoYEL"},
+        {"type", "message"},
+        {"role", "assistant"},
+        {"content", {{{"type", "text"}, {"text", content}}}},
+        {"usage", {{"input_tokens", 12000}, {"output_tokens", 80}, {"cache_read_input_tokens", 8000}}}
+    };
+    std::string openai_response = openai.dump();
+    std::string anthropic_response = anthropic.dump();
+    bench("parse_chat_response/openai", openai_response.size(), [&] { bench_sink += parse_chat_response(openai_response).content.size(); });
+    bench("parse_chat_response/anthropic", anthropic_response.size(), [&] { bench_sink += parse_chat_response(anthropic_response).content.size(); });
+}
+
+static std::string file_content(int file, int revision) {
+    std::string content;
+    for (int line = 0; line < options.file_lines; ++line) {
+        content += "file " + std::to_string(file) + " line " + std::to_string(line) + " revision " + std::to_string(revision) + "\n";
+    }
+    return content;
+}
+
+static void shell(const std::string& command) {
+    if (std::system(command.c_str()) != 0) {
+        throw std::runtime_error("Command failed: " + command);
+    }
+}
+
+static void bench_git(const fs::path& work_dir) {
+    if (!wanted("git/")) return;
+    fs::path repo_dir = work_dir / "repo";
+    fs::create_directories(repo_dir);
+    for (int file = 0; file < options.repo_files; ++file) {
+        fs::path path = repo_dir / ("d" + std::to_string(file / 100)) / ("f" + std::to_string(file) + ".txt");
+        fs::create_directories(path.parent_path());
+        std::ofstream(path) << file_content(file, 0);
+    }
+    shell("cd '" + repo_dir.string() + "' && git init -q && git add -A"
+          " && git -c user.name=Bench -c user.email=bench@example.com commit -q -m 'Synthetic repository'");
+    for (int file = 0; file < std::min(options.repo_modified, options.repo_files); ++file) {
+        // Spread the changes over the tree, one hunk per file
+        int target = file * std::max(1, options.repo_files / std::max(1, options.repo_modified));
+        fs::path path = repo_dir / ("d" + std::to_string(target / 100)) / ("f" + std::to_string(target) + ".txt");
+        std::ofstream(path) << file_content(target, 1);
+    }
+    std::vector<std::string> untracked;
+    for (int file = 0; file < options.repo_untracked; ++file) {
+        std::string name = "new/u" + std::to_string(file) + ".txt";
+        fs::create_directories(repo_dir / "new");
+        std::ofstream(repo_dir / name) << file_content(file, 2);
+        untracked.push_back(name);
+    }
+
+    {
+        ScopedCurrentPath in_repo(repo_dir);
+        GitRepository repo;
+        GitUtils git_utils(repo);
+        size_t diff_size = git_utils.get_full_diff().size();
+        size_t untracked_size = git_utils.get_untracked_diff(untracked).size();
+        bench("git/get_status", 0, [&] { bench_sink += git_utils.get_status().unstaged.size(); });
+        bench("git/get_full_diff", diff_size, [&] { bench_sink += git_utils.get_full_diff().size(); });
+        bench("git/get_untracked_diff", untracked_size, [&] { bench_sink += git_utils.get_untracked_diff(untracked).size(); });
+    }
+}
+
+static void bench_summaries(const fs::path& work_dir) {
+    if (!wanted("summarize_generation_stats/")) return;
+    std::string log_path = (work_dir / "generation_stats.log").string();
+    {
+        std::ofstream log(log_path);
+        const char* models[] = {"openai/gpt-4o-mini", "anthropic/claude-3.5-haiku", "google/gemini-flash-1.5", "qwen/qwen-2.5-coder-32b"};
+        for (int i = 0; i < options.log_entries; ++i) {
+            std::time_t time = 1700000000 + static_cast<std::time_t>(i) * 600;
+            std::stringstream date;
+            date << std::put_time(std::gmtime(&time), "%Y-%m-%dT%H:%M:%SZ");
+            nlohmann::json j = {
+                {"date", date.str()},
+                {"backend", i % 5 == 0 ? "zen" : "openrouter"},
+                {"model", models[i % 4]},
+                {"input_tokens", 1000 + i % 3000},
+                {"output_tokens", 40 + i % 200},
+                {"total_cost", 0.0001 * (1 + i % 50)},
+                {"latency", 300 + i % 900},
+                {"generation_time", 800 + i % 4000},
+                {"request_time", 900 + i % 4500},
+                {"dry_run", i % 7 == 0}
+            };
+            log << j.dump() << "\n";
+        }
+    }
+    size_t log_size = fs::file_size(log_path);
+
+    // The summaries are printed; keep them out of the results
+    std::ofstream null_stream("/dev/null");
+    auto quiet = [&](const std::function<void()>& fn) {
+        return [&, fn] {
+            ScopedCoutBuffer silenced(null_stream.rdbuf());
+            fn();
+        };
+    };
+    StatsQuery by_week;
+    by_week.group_by = "week";
+    StatsQuery window;
+    window.since = "2024-01-01";
+    // The first summary builds the columnar sidecar next to the log; later ones read it
+    bench("summarize_generation_stats/rebuild", log_size, quiet([&] { summarize_generation_stats(log_path); }),
+          [&] { fs::remove_all(log_path + ".cols"); });
+    bench("summarize_generation_stats/cached", log_size, quiet([&] { summarize_generation_stats(log_path); }));
+    bench("summarize_generation_stats/by_week", log_size, quiet([&] { summarize_generation_stats(log_path, by_week); }));
+    bench("summarize_generation_stats/since", log_size, quiet([&] { summarize_generation_stats(log_path, window); }));
+}
+
+static void write_json(const std::string& path) {
+    nlohmann::json j;
+    j["build"] = {
+        {"compiler", __VERSION__},
+        {"json_escape_kernel", json_escape_kernel_name()},
+    };
+    j["options"] = {
+        {"diff_kib", options.diff_kib},
+        {"repo_files", options.repo_files},
+        {"repo_modified", options.repo_modified},
+        {"repo_untracked", options.repo_untracked},
+        {"log_entries", options.log_entries},
+    };
+    j["results"] = nlohmann::json::array();
+    for (const auto& result : results) {
+        j["results"].push_back({
+            {"name", result.name},
+            {"iterations", result.iterations},
+            {"mean_ns", result.mean_ns},
+            {"p50_ns", result.p50_ns},
+            {"p95_ns", result.p95_ns},
+            {"min_ns", result.min_ns},
+            {"bytes", result.bytes},
+        });
+    }
+    std::ofstream(path) << j.dump(2) << "\n";
+}
+
+// Prints the p50 of each benchmark against the same benchmark in an earlier --json file
+static void compare(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Cannot read " + path);
+    }
+    std::map<std::string, double> baseline;
+    for (const auto& result : nlohmann::json::parse(file).at("results")) {
+        baseline[result.at("name").get<std::string>()] = result.at("p50_ns").get<double>();
+    }
+    std::cout << "\nAgainst " << path << " (p50, new / old):" << std::endl;
+    for (const auto& result : results) {
+        auto it = baseline.find(result.name);
+        if (it == baseline.end() || it->second <= 0) continue;
+        std::cout << "  " << std::left << std::setw(44) << result.name << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(8) << result.p50_ns / it->second << "x" << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    CLI::App app{"commit_bench - microbenchmarks for commit's in-process hot paths"};
+    app.add_option("--filter", options.filter, "Only run benchmarks whose name contains this");
+    app.add_option("--min-time", options.min_time, "Seconds to measure each benchmark");
+    app.add_option("--diff-kib", options.diff_kib, "Diff size for the payload benchmarks, in KiB");
+    app.add_option("--repo-files", options.repo_files, "Tracked files in the synthetic repository");
+    app.add_option("--repo-modified", options.repo_modified, "Tracked files modified in the worktree");
+    app.add_option("--repo-untracked", options.repo_untracked, "Untracked files");
+    app.add_option("--file-lines", options.file_lines, "Lines per file");
+    app.add_option("--log-entries", options.log_entries, "Entries in the synthetic generation stats log");
+    app.add_option("--work-dir", options.work_dir, "Directory for the synthetic repository and log (default: a new temporary directory)");
+    app.add_option("--json", options.json_path, "Write the results as JSON to this file");
+    app.add_option("--compare", options.compare_path, "Compare against the results in an earlier --json file");
+    CLI11_PARSE(app, argc, argv);
+
+    bool temporary = options.work_dir.empty();
+    fs::path work_dir = options.work_dir;
+    int rc = 0;
+    try {
+        if (temporary) {
+            std::string pattern = (fs::temp_directory_path() / "commit_bench.XXXXXX").string();
+            if (!::mkdtemp(pattern.data())) {
+                throw std::runtime_error("mkdtemp() failed");
+            }
+            work_dir = pattern;
+        }
+        fs::create_directories(work_dir);
+
+        std::cout << std::left << std::setw(44) << "benchmark" << std::right << std::setw(14) << "p50 ns" << std::setw(14) << "p95 ns"
+                  << std::setw(12) << "iterations" << std::setw(10) << "GB/s" << std::endl;
+        bench_commit_message();
+        bench_payload();
+        bench_response_parsing();
+        bench_git(work_dir);
+        bench_summaries(work_dir);
+
+        if (!options.json_path.empty()) {
+            write_json(options.json_path);
+        }
+        if (!options.compare_path.empty()) {
+            compare(options.compare_path);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        rc = 1;
+    }
+    if (temporary && !work_dir.empty()) {
+        std::error_code ec;
+        fs::remove_all(work_dir, ec);
+    }
+    return rc;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "config.hpp"
+#include "llm_backend.hpp"
+
+// Describes one selectable backend. Each backend's .cpp registers itself with a static
+// BackendRegistrar, so adding a backend needs no changes to main.cpp or the configure UI.
+struct BackendInfo {
+    std::string name;
+    std::string description;
+    std::string api_key_env;            // Environment variable overriding the key; empty for none
+    bool requires_api_key = true;
+    std::string Config::* api_key_field = nullptr;
+    std::string Config::* base_url_field = nullptr;
+    std::function<std::unique_ptr<LLMBackend>()> create;
+};
+
+class BackendRegistry {
+public:
+    static BackendRegistry& instance();
+
+    void add(BackendInfo info);
+    // Returns nullptr for unknown names
+    const BackendInfo* find(const std::string& name) const;
+    // Throws std::runtime_error listing the known backends for unknown names
+    const BackendInfo& get(const std::string& name) const;
+    // Registration order is link order, so names are sorted with openrouter first as the default
+    std::vector<std::string> names() const;
+
+private:
+    BackendRegistry() = default;
+    std::vector<BackendInfo> backends_;
+};
+
+struct BackendRegistrar {
+    explicit BackendRegistrar(BackendInfo info) {
+        BackendRegistry::instance().add(std::move(info));
+    }
+};
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+#include "llm_backend.hpp"
+
+// Generates `n` candidate messages for one diff. Backends that support it return all of them
+// from a single request, so the prompt is uploaded and billed once and the candidates arrive
+// together; the rest are filled in with concurrent requests. Empty and duplicate messages are
+// blanked, or dropped when another result already carries their request's usage.
+std::vector<GenerationResult> generate_candidates(LLMBackend& llm, const std::string& diff, const std::string& instructions, const std::string& model, const std::string& provider, double temperature, size_t n);
+
+// Lists the candidates and asks which one to use. Returns the index, or nullopt if the user
+// quits. Picks the first without asking when stdin is not a terminal.
+std::optional<size_t> select_candidate(const std::vector<GenerationResult>& candidates);
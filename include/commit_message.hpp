@@ -0,0 +1,6 @@
+#pragma once
+
+#include <string>
+
+// Strips code fences and stray "diff" markers that models sometimes wrap messages in
+std::string clean_commit_message(const std::string& msg);
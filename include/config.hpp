@@ -8,12 +8,30 @@ struct Config {
     std::string model;
     std::string openrouter_api_key;
     std::string zen_api_key;
+    std::string openrouter_base_url;
+    std::string zen_base_url;
+    std::string local_api_key;
+    std::string local_base_url;
     bool time_run;
     std::string provider;
     double temperature;
     bool auto_push;
+    std::string tokenizer_vocab;
+    long max_input_tokens;
+    std::string oversize_action;
+    double auto_latency_slo;
+    double auto_latency_percentile;
+    size_t concurrency;
+    double requests_per_minute;
+    bool fsync_stats_log;
+    std::string metrics_path;  // Rewritten with Prometheus metrics after every logged run when set
+    double watch_quiet_seconds;
+    double watch_budget;       // Dollars one `commit --watch` may spend; 0 for no limit
 
     static Config load_from_file(const std::string& path);
 };
 
+std::string trim(const std::string& s);
+
+// Runs the interactive setup from the commit_configure.so module, loaded on first use
 void configure_app(const std::string& config_path);
\ No newline at end of file
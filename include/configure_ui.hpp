@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "backend_registry.hpp"
+#include "config.hpp"
+
+// Interface between the executable and the commit_configure module, which configure_app()
+// loads with dlopen(). The module resolves nothing from the executable: everything it needs
+// beyond inline code is passed in this table, so the executable exports no symbols.
+struct ConfigureHost {
+    static constexpr int VERSION = 1;
+
+    int version = VERSION;  // Built from the same sources; checked so a stale module fails cleanly
+    Config (*load_config)(const std::string& path) = nullptr;
+    std::vector<std::string> (*backend_names)() = nullptr;
+    // Throws std::runtime_error for unknown names
+    const BackendInfo& (*backend)(const std::string& name) = nullptr;
+    std::string (*trim)(const std::string& s) = nullptr;
+};
+
+// The module's only exported symbol; returns false when `host` is from another version
+inline constexpr const char* CONFIGURE_UI_ENTRY = "commit_configure_ui";
+using ConfigureUiEntry = bool (*)(const char* config_path, const ConfigureHost* host);
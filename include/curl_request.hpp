@@ -4,10 +4,36 @@
 #include <string>
 #include <stdexcept>
 
+// Where the time of one transfer went, from libcurl. The times are cumulative, in ms from
+// the start of the request, and -1 when unknown; a reused connection reports 0 for the
+// lookup, connect and TLS steps.
+struct HttpTiming {
+    double namelookup = -1.0;
+    double connect = -1.0;
+    double appconnect = -1.0;     // TLS handshake done; 0 for plain HTTP
+    double pretransfer = -1.0;
+    double starttransfer = -1.0;  // First response byte
+    double total = -1.0;
+    double bytes_up = -1.0;
+    double bytes_down = -1.0;
+    std::string http_version;     // "1.0", "1.1", "2" or "3"
+};
+
+// The numeric timings and the keys they are serialized under, in the same order
+inline constexpr double HttpTiming::* HTTP_TIMING_FIELDS[] = {
+    &HttpTiming::namelookup, &HttpTiming::connect, &HttpTiming::appconnect, &HttpTiming::pretransfer,
+    &HttpTiming::starttransfer, &HttpTiming::total, &HttpTiming::bytes_up, &HttpTiming::bytes_down,
+};
+inline constexpr const char* HTTP_TIMING_KEYS[] = {
+    "namelookup", "connect", "appconnect", "pretransfer", "starttransfer", "total", "bytes_up", "bytes_down",
+};
+
 class CurlRequest {
 private:
     CURL* handle;
     curl_slist* headers;
+    std::string body;  // libcurl does not copy POSTFIELDS, so the request owns it
+    HttpTiming timing_;
 
 public:
     CurlRequest() : handle(nullptr), headers(nullptr) {
@@ -34,14 +60,20 @@ public:
         curl_easy_setopt(handle, CURLOPT_URL, url.c_str());
     }
 
-    void set_postfields(const std::string& data) {
-        curl_easy_setopt(handle, CURLOPT_POSTFIELDS, data.c_str());
+    void set_postfields(std::string data) {
+        body = std::move(data);
+        curl_easy_setopt(handle, CURLOPT_POSTFIELDSIZE, static_cast<long>(body.size()));
+        curl_easy_setopt(handle, CURLOPT_POSTFIELDS, body.c_str());
     }
 
     void set_get_method() {
         curl_easy_setopt(handle, CURLOPT_HTTPGET, 1L);
     }
 
+    void set_head_method() {
+        curl_easy_setopt(handle, CURLOPT_NOBODY, 1L);
+    }
+
     void add_header(const std::string& header) {
         headers = curl_slist_append(headers, header.c_str());
     }
@@ -51,10 +83,59 @@ public:
         curl_easy_setopt(handle, CURLOPT_WRITEDATA, userdata);
     }
 
-    CURLcode perform() {
+    void set_tcp_keepalive() {
+        curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+    }
+
+    CURL* native_handle() const {
+        return handle;
+    }
+
+    // Applies the accumulated headers; perform() does this itself, HttpExecutor calls it
+    // before handing the handle to curl_multi
+    void prepare() {
         if (headers) {
             curl_easy_setopt(handle, CURLOPT_HTTPHEADER, headers);
         }
-        return curl_easy_perform(handle);
+    }
+
+    CURLcode perform() {
+        prepare();
+        CURLcode res = curl_easy_perform(handle);
+        capture_timing();
+        return res;
+    }
+
+    // Reads the timings of the finished transfer; perform() does this itself, HttpExecutor
+    // calls it when curl_multi reports the transfer done
+    void capture_timing() {
+        auto ms = [this](CURLINFO info) {
+            curl_off_t us = -1;
+            return curl_easy_getinfo(handle, info, &us) == CURLE_OK && us >= 0 ? us / 1000.0 : -1.0;
+        };
+        timing_.namelookup = ms(CURLINFO_NAMELOOKUP_TIME_T);
+        timing_.connect = ms(CURLINFO_CONNECT_TIME_T);
+        timing_.appconnect = ms(CURLINFO_APPCONNECT_TIME_T);
+        timing_.pretransfer = ms(CURLINFO_PRETRANSFER_TIME_T);
+        timing_.starttransfer = ms(CURLINFO_STARTTRANSFER_TIME_T);
+        timing_.total = ms(CURLINFO_TOTAL_TIME_T);
+        curl_off_t bytes = -1;
+        if (curl_easy_getinfo(handle, CURLINFO_SIZE_UPLOAD_T, &bytes) == CURLE_OK) timing_.bytes_up = static_cast<double>(bytes);
+        if (curl_easy_getinfo(handle, CURLINFO_SIZE_DOWNLOAD_T, &bytes) == CURLE_OK) timing_.bytes_down = static_cast<double>(bytes);
+        long version = 0;
+        curl_easy_getinfo(handle, CURLINFO_HTTP_VERSION, &version);
+        switch (version) {
+            case CURL_HTTP_VERSION_1_0: timing_.http_version = "1.0"; break;
+            case CURL_HTTP_VERSION_1_1: timing_.http_version = "1.1"; break;
+            case CURL_HTTP_VERSION_2_0: timing_.http_version = "2"; break;
+#if LIBCURL_VERSION_NUM >= 0x074200
+            case CURL_HTTP_VERSION_3: timing_.http_version = "3"; break;
+#endif
+            default: timing_.http_version.clear(); break;
+        }
+    }
+
+    const HttpTiming& timing() const {
+        return timing_;
     }
 };
\ No newline at end of file
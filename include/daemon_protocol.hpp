@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "llm_backend.hpp"
+
+// Wire format between `commit` and `commitd`: one JSON request and one JSON response per
+// connection, each on a single line. Requests carry an "op" (ping, generate, choices, models,
+// balance, warm_up) plus the backend settings; responses are {"result": ...} or {"error": "..."}.
+
+// $COMMITD_SOCKET if set, else $XDG_RUNTIME_DIR/commit/commitd.sock, else
+// /tmp/commit-<uid>/commitd.sock
+std::string daemon_socket_path();
+
+// Empty when the socket's directory is a real directory owned by this user with mode 0700,
+// else what is wrong with it. Requests carry API keys, so neither side trusts any other.
+std::string socket_dir_problem(const std::string& socket_path);
+// True when the process at the other end of a connected Unix socket runs as this user
+bool peer_is_same_user(int fd);
+
+// Connects to the daemon's socket; returns -1 when no daemon is listening, or when the socket
+// directory or the listening process does not belong to this user
+int connect_daemon(const std::string& path);
+// True when a daemon answers a ping on `path`
+bool ping_daemon(const std::string& path);
+
+// Throw std::runtime_error on I/O errors; receive_message() also when the peer closes early
+void send_message(int fd, const nlohmann::json& message);
+nlohmann::json receive_message(int fd);
+
+nlohmann::json result_to_json(const GenerationResult& result);
+GenerationResult result_from_json(const nlohmann::json& j);
+nlohmann::json models_to_json(const std::vector<Model>& models);
+std::vector<Model> models_from_json(const nlohmann::json& j);
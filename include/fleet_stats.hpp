@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "statistics.hpp"
+
+// Finds every `.commit/generation_stats.log` under `roots` and prints one report with totals
+// by repository, model and backend/provider. The logs are memory-mapped and parsed on a
+// thread pool; each worker aggregates on its own and the results are merged at the end.
+// Only the JSONL is read, so no column stores are created in the scanned checkouts.
+void summarize_fleet_stats(const std::vector<std::string>& roots, const StatsQuery& query);
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <git2.h>
+#include <future>
+#include <memory>
 #include <string>
 #include <vector>
 #include <utility>
@@ -18,6 +20,45 @@ private:
     std::string commit_dir_;
 };
 
+// A connection to origin for pushing the current branch, opened by GitUtils::prepare_push()
+// while other work runs. It has its own repository handle, so it can be set up on another
+// thread; once handed back it belongs to the caller's thread.
+class PreparedPush {
+public:
+    PreparedPush() = default;
+    ~PreparedPush();
+    PreparedPush(const PreparedPush&) = delete;
+    PreparedPush& operator=(const PreparedPush&) = delete;
+
+    // Why no connection was opened; push() then connects afresh and reports the failure
+    std::string error;
+    // The branch on origin has commits that HEAD does not contain, so a push would be rejected
+    bool diverged = false;
+
+private:
+    friend class GitUtils;
+    git_repository* repo_ = nullptr;
+    git_remote* remote_ = nullptr;
+};
+
+struct StatusLists {
+    std::vector<std::string> staged;     // Modified in the index
+    std::vector<std::string> unstaged;   // Modified in the worktree
+    std::vector<std::string> untracked;
+};
+
+struct RangeCommit {
+    git_oid id;
+    std::string short_id;
+    std::string summary;
+    std::string message;
+};
+
+struct CommitRange {
+    std::string head_ref;  // Branch HEAD pointed to when the range was read; empty when detached
+    std::vector<RangeCommit> commits;
+};
+
 class GitUtils {
 public:
     GitUtils(GitRepository& repo);
@@ -26,14 +67,33 @@ public:
     static std::string get_cached_git_dir();
     std::string get_diff(bool cached = true);
     std::string get_full_diff();
+    // All three lists from one status scan
+    StatusLists get_status();
     std::vector<std::string> get_unstaged_files();
     std::vector<std::string> get_tracked_modified_files();
     std::vector<std::string> get_untracked_files();
+    // Patch that adds each of `files` (paths relative to the repository root) as a new file,
+    // for untracked files that are about to be committed
+    std::string get_untracked_diff(const std::vector<std::string>& files);
     void add_files();
     void add_files(const std::vector<std::string>& files);
     void commit(const std::string& message);
     std::pair<std::string, std::string> commit_with_output(const std::string& message);
-    void push();
+    // Connects to origin, authenticates and reads the ref advertisement on a background thread
+    std::future<std::unique_ptr<PreparedPush>> prepare_push();
+    // Pushes the current branch to origin; over `prepared`'s connection when it has one, so only
+    // the pack is left to send
+    void push(PreparedPush* prepared = nullptr);
+    // Commits in `range` ("A..B", or "A" for A..HEAD), oldest first. The range must end at
+    // HEAD and contain no merges, since the commits are rewritten in place.
+    CommitRange get_commit_range(const std::string& range);
+    // Patch of a commit against its first parent, or against the empty tree for a root commit
+    static std::string get_commit_diff(git_repository* repo, const git_oid& commit_id);
+    // Recreates the commits from the first one whose message changed, reusing their trees and
+    // authors, then moves the range's branch (or detached HEAD) to the new tip. Throws when it
+    // no longer points at the range's last commit. Returns the new HEAD hash, or "" when no
+    // message changed and nothing was rewritten.
+    std::string rewrite_messages(const CommitRange& range, const std::vector<std::string>& messages);
 private:
     static std::string cached_repo_root_;
     static std::string cached_git_dir_;
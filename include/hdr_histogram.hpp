@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// High dynamic range histogram: values from 1 to `highest` are counted in log-linear buckets
+// that keep `significant_figures` decimal digits of precision, so percentiles stay accurate
+// from milliseconds to minutes in a fixed amount of memory. Values outside the range are
+// clamped to it; the exact minimum and maximum are tracked separately. The counts are only
+// allocated by the first value, so an empty histogram costs nothing.
+class HdrHistogram {
+public:
+    explicit HdrHistogram(int64_t highest = 3600000, int significant_figures = 3) {
+        if (highest < 2 || significant_figures < 1 || significant_figures > 5) {
+            throw std::invalid_argument("HdrHistogram: invalid range or precision");
+        }
+        int64_t largest_single_unit = 2 * static_cast<int64_t>(std::pow(10, significant_figures));
+        sub_bucket_half_count_magnitude_ = static_cast<int>(std::ceil(std::log2(static_cast<double>(largest_single_unit)))) - 1;
+        sub_bucket_half_count_ = int64_t{1} << sub_bucket_half_count_magnitude_;
+        sub_bucket_mask_ = (sub_bucket_half_count_ * 2) - 1;
+
+        int bucket_count = 1;
+        int64_t smallest_untrackable = sub_bucket_half_count_ * 2;
+        while (smallest_untrackable <= highest) {
+            smallest_untrackable <<= 1;
+            bucket_count++;
+        }
+        highest_ = highest;
+        slots_ = static_cast<size_t>(bucket_count + 1) * static_cast<size_t>(sub_bucket_half_count_);
+    }
+
+    void record(int64_t value) {
+        value = std::clamp<int64_t>(value, 1, highest_);
+        if (counts_.empty()) counts_.assign(slots_, 0);
+        counts_[index_of(value)]++;
+        total_++;
+        min_ = total_ == 1 ? value : std::min(min_, value);
+        max_ = std::max(max_, value);
+    }
+
+    // Adds the counts of a histogram created with the same range and precision
+    void add(const HdrHistogram& other) {
+        if (other.slots_ != slots_ || other.highest_ != highest_) {
+            throw std::invalid_argument("HdrHistogram: cannot add histograms of different shapes");
+        }
+        if (other.total_ == 0) return;
+        if (counts_.empty()) counts_.assign(slots_, 0);
+        for (size_t i = 0; i < counts_.size(); ++i) {
+            counts_[i] += other.counts_[i];
+        }
+        min_ = total_ == 0 ? other.min_ : std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+        total_ += other.total_;
+    }
+
+    // Smallest recorded value (to the histogram's precision) that `percentile` percent of
+    // the values are at or below; 0 when empty
+    int64_t value_at_percentile(double percentile) const {
+        if (total_ == 0) return 0;
+        uint64_t target = static_cast<uint64_t>(std::ceil(std::clamp(percentile, 0.0, 100.0) / 100.0 * static_cast<double>(total_)));
+        target = std::max<uint64_t>(target, 1);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts_.size(); ++i) {
+            seen += counts_[i];
+            if (seen >= target) {
+                return std::clamp(highest_equivalent(i), min_, max_);
+            }
+        }
+        return max_;
+    }
+
+    uint64_t count() const { return total_; }
+    int64_t min() const { return min_; }
+    int64_t max() const { return max_; }
+
+    // The non-zero slots as (index, count) pairs, which with min() and max() are all that
+    // restore() needs to rebuild the histogram, e.g. from a checkpoint
+    std::vector<std::pair<size_t, uint64_t>> nonzero_counts() const {
+        std::vector<std::pair<size_t, uint64_t>> slots;
+        for (size_t i = 0; i < counts_.size(); ++i) {
+            if (counts_[i] != 0) slots.emplace_back(i, counts_[i]);
+        }
+        return slots;
+    }
+
+    // Adds saved counts to a histogram of the same range and precision
+    void restore(const std::vector<std::pair<size_t, uint64_t>>& slots, int64_t min, int64_t max) {
+        uint64_t total = 0;
+        for (const auto& [index, count] : slots) {
+            if (index >= slots_) {
+                throw std::invalid_argument("HdrHistogram: saved counts do not fit this histogram");
+            }
+            total += count;
+        }
+        if (total == 0) return;
+        if (counts_.empty()) counts_.assign(slots_, 0);
+        for (const auto& [index, count] : slots) {
+            counts_[index] += count;
+        }
+        min_ = total_ == 0 ? min : std::min(min_, min);
+        max_ = std::max(max_, max);
+        total_ += total;
+    }
+
+private:
+    int sub_bucket_half_count_magnitude_;
+    int64_t sub_bucket_half_count_;
+    int64_t sub_bucket_mask_;
+    int64_t highest_;
+    size_t slots_;
+    std::vector<uint64_t> counts_;
+    uint64_t total_ = 0;
+    int64_t min_ = 0;
+    int64_t max_ = 0;
+
+    size_t index_of(int64_t value) const {
+        int pow2_ceiling = 64 - std::countl_zero(static_cast<uint64_t>(value | sub_bucket_mask_));
+        int bucket = pow2_ceiling - (sub_bucket_half_count_magnitude_ + 1);
+        int64_t sub_bucket = value >> bucket;
+        return static_cast<size_t>(((static_cast<int64_t>(bucket) + 1) << sub_bucket_half_count_magnitude_) + (sub_bucket - sub_bucket_half_count_));
+    }
+
+    // Largest value that shares a bucket slot with the values counted at `index`
+    int64_t highest_equivalent(size_t index) const {
+        int64_t bucket = (static_cast<int64_t>(index) >> sub_bucket_half_count_magnitude_) - 1;
+        int64_t sub_bucket = (static_cast<int64_t>(index) & (sub_bucket_half_count_ - 1)) + sub_bucket_half_count_;
+        if (bucket < 0) {
+            sub_bucket -= sub_bucket_half_count_;
+            bucket = 0;
+        }
+        return (sub_bucket << bucket) + (int64_t{1} << bucket) - 1;
+    }
+};
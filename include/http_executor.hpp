@@ -0,0 +1,95 @@
+#pragma once
+
+#include <chrono>
+#include <curl/curl.h>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "curl_request.hpp"
+
+// Runs every HTTP request of the process on one curl_multi event loop thread, so any
+// number of requests can be in flight without a thread each. Connections are pooled
+// by the multi handle and reused across requests to the same host. TLS sessions are kept
+// in $XDG_CACHE_HOME/commit/tls_sessions between runs, so the next process resumes them
+// instead of doing a full handshake (libcurl 8.12 or later).
+class HttpExecutor {
+public:
+    // Runs on the executor thread; must not block
+    using Completion = std::function<void(CURLcode result, std::string&& response, const HttpTiming& timing)>;
+
+    static HttpExecutor& instance();
+
+    // Takes ownership of `request`; the body is collected by the executor and handed to
+    // `done`. A non-zero `delay` holds the request back, e.g. for polling with backoff.
+    void submit(std::unique_ptr<CurlRequest> request, Completion done, std::chrono::milliseconds delay = std::chrono::milliseconds(0));
+
+    // Opens a pooled connection to the host of `url` with a HEAD request whose response is
+    // dropped; a request submitted meanwhile waits for that connection instead of opening another
+    void preconnect(const std::string& url);
+
+    ~HttpExecutor();
+    HttpExecutor(const HttpExecutor&) = delete;
+    HttpExecutor& operator=(const HttpExecutor&) = delete;
+
+private:
+    struct Transfer {
+        std::unique_ptr<CurlRequest> request;
+        Completion done;
+        std::string response;
+        std::chrono::steady_clock::time_point start_at;
+        std::chrono::steady_clock::time_point started;  // When it was handed to curl_multi
+    };
+
+    HttpExecutor();
+    void run();
+    void start_transfer(std::unique_ptr<Transfer> transfer);
+
+    CURLM* multi_;
+    CURLSH* share_;  // TLS session cache; only the executor thread uses it while it runs
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Transfer>> submitted_;  // Guarded by mutex_
+    bool stopping_ = false;                             // Guarded by mutex_
+    // Owned by the executor thread
+    std::multimap<std::chrono::steady_clock::time_point, std::unique_ptr<Transfer>> delayed_;
+    std::map<CURL*, std::unique_ptr<Transfer>> active_;
+    std::thread thread_;
+};
+
+inline std::runtime_error curl_error(const std::string& url, CURLcode res) {
+    std::cerr << "Failed to fetch URL: " << url << ", libcurl error: " << curl_easy_strerror(res) << std::endl;
+    return std::runtime_error("Curl error: " + std::string(curl_easy_strerror(res)));
+}
+
+// Submits `request` and fulfils the future with `parse(response)`, or with
+// `parse(response, timing)` when the parser wants the transfer timings. Transport failures
+// and exceptions thrown by `parse` are delivered through the future.
+template <class T, class Parse>
+std::future<T> fetch_async(std::unique_ptr<CurlRequest> request, const std::string& url, Parse parse) {
+    auto promise = std::make_shared<std::promise<T>>();
+    std::future<T> future = promise->get_future();
+    request->set_url(url);
+    HttpExecutor::instance().submit(std::move(request), [promise, url, parse = std::move(parse)](CURLcode res, std::string&& response, const HttpTiming& timing) mutable {
+        try {
+            if (res != CURLE_OK) {
+                throw curl_error(url, res);
+            }
+            if constexpr (std::is_invocable_v<Parse&, const std::string&, const HttpTiming&>) {
+                promise->set_value(parse(response, timing));
+            } else {
+                promise->set_value(parse(response));
+            }
+        } catch (...) {
+            promise->set_exception(std::current_exception());
+        }
+    });
+    return future;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <nlohmann/json.hpp>
+
+// Name of the kernel selected at startup ("avx2", "sse4.2" or "scalar").
+const char* json_escape_kernel_name();
+
+bool is_valid_utf8(std::string_view input);
+
+// Appends `input` as a quoted JSON string. Invalid UTF-8 sequences are replaced
+// with U+FFFD instead of throwing the way nlohmann::json::dump() does.
+void append_json_string(std::string& out, std::string_view input);
+void append_json_string_scalar(std::string& out, std::string_view input);
+
+// Serializes `fields` with a single user message holding `content` (written as
+// `instructions` + "\n\nDiff:\n" + `diff`) without copying the diff into a json value.
+std::string build_chat_payload(const nlohmann::json& fields, std::string_view instructions, std::string_view diff);
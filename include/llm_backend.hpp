@@ -3,8 +3,12 @@
 #include <string>
 #include <vector>
 #include <optional>
+#include <functional>
+#include <future>
+#include <memory>
 #include <curl/curl.h>
 #include <nlohmann/json.hpp>
+#include "curl_request.hpp"
 
 inline size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
     ((std::string*)userp)->append((char*)contents, size * nmemb);
@@ -23,9 +27,13 @@ struct GenerationResult {
     std::string generation_id;
     double input_tokens = -1;
     double output_tokens = -1;
+    double cached_tokens = -1;  // Input tokens read from the provider's prompt cache
     double total_cost = -1.0;
     double latency = -1.0;
     double generation_time = -1.0;
+    double request_time = -1.0;  // Client-side wall clock in ms, when measured per request
+    bool shared_request = false;  // Extra choice of a request whose usage and cost another result carries
+    HttpTiming http;              // The chat request's transfer timings
 };
 
 struct GenerationStats {
@@ -38,6 +46,11 @@ struct GenerationStats {
     double total_cost = -1.0;
     double latency = -1.0;
     double generation_time = -1.0;
+    double request_time = -1.0;  // Client-side wall clock for the request, in ms
+    double cached_tokens = -1;
+    double commit_time = -1.0;   // Per run, on the run's first entry only: git commit and push, in ms
+    double push_time = -1.0;
+    HttpTiming http;
     bool dry_run = false;
 };
 
@@ -45,36 +58,175 @@ class LLMBackend {
 public:
     virtual ~LLMBackend() = default;
     virtual void set_api_key(const std::string& key) = 0;
+    // Points the backend at a different server (e.g. a local stand-in); the URL includes the API version path
+    virtual void set_base_url(const std::string& url) = 0;
     virtual GenerationResult generate_commit_message(const std::string& diff, const std::string& instructions, const std::string& model, const std::string& provider = "", double temperature = -1.0) = 0;
     virtual std::vector<Model> get_available_models() = 0;
     virtual std::string get_balance() = 0;
+    // Starts opening the connection to the API in the background (DNS, TCP, TLS, HTTP/2
+    // settings) so the first real request finds it ready; returns at once
+    virtual void warm_up() {}
+
+    // Non-blocking variants. HTTP backends run these on the shared HttpExecutor and build the
+    // blocking calls on top of them; the defaults run the blocking call on a worker thread.
+    // The backend must outlive the returned futures.
+    virtual std::future<GenerationResult> generate_commit_message_async(const std::string& diff, const std::string& instructions, const std::string& model, const std::string& provider = "", double temperature = -1.0) {
+        return std::async(std::launch::async, [this, diff, instructions, model, provider, temperature] {
+            return generate_commit_message(diff, instructions, model, provider, temperature);
+        });
+    }
+    virtual std::future<std::vector<Model>> get_available_models_async() {
+        return std::async(std::launch::async, [this] { return get_available_models(); });
+    }
+    virtual std::future<std::string> get_balance_async() {
+        return std::async(std::launch::async, [this] { return get_balance(); });
+    }
+
+    // Whether generate_choices_async() can return several completions from one request
+    virtual bool supports_choices() const { return false; }
+    // Asks for `n` completions of one prompt in a single request, so the prompt is uploaded and
+    // billed once. Providers may return fewer than asked for. The first result carries the
+    // request's usage and cost; the others are marked `shared_request`.
+    virtual std::future<std::vector<GenerationResult>> generate_choices_async(const std::string& diff, const std::string& instructions, const std::string& model, const std::string& provider, double temperature, size_t n) {
+        (void)n;
+        return std::async(std::launch::async, [this, diff, instructions, model, provider, temperature] {
+            return std::vector<GenerationResult>{generate_commit_message(diff, instructions, model, provider, temperature)};
+        });
+    }
 };
 
 class OpenRouterBackend : public LLMBackend {
 public:
     void set_api_key(const std::string& key) override;
+    void set_base_url(const std::string& url) override;
     GenerationResult generate_commit_message(const std::string& diff, const std::string& instructions, const std::string& model, const std::string& provider = "", double temperature = -1.0) override;
     std::vector<Model> get_available_models() override;
     std::string get_balance() override;
+    void warm_up() override;
+    std::future<GenerationResult> generate_commit_message_async(const std::string& diff, const std::string& instructions, const std::string& model, const std::string& provider = "", double temperature = -1.0) override;
+    std::future<std::vector<Model>> get_available_models_async() override;
+    std::future<std::string> get_balance_async() override;
+    bool supports_choices() const override { return true; }
+    std::future<std::vector<GenerationResult>> generate_choices_async(const std::string& diff, const std::string& instructions, const std::string& model, const std::string& provider, double temperature, size_t n) override;
 
 private:
+    // Receives either the choices of a chat request or the error that ended it
+    using ChatDone = std::function<void(std::vector<GenerationResult>&& results, std::exception_ptr error)>;
+
     std::string api_key;
-    GenerationResult handle_chat_response(const std::string& response, const std::string& payload);
-    void fetch_generation_stats(GenerationResult& result, const std::string& generation_id);
+    std::string base_url = "https://openrouter.ai/api/v1";
+    void submit_chat(const std::string& diff, const std::string& instructions, const std::string& model, const std::string& provider, double temperature, size_t n, ChatDone done);
+    static std::vector<GenerationResult> handle_chat_response(const std::string& response, const std::string& payload);
+    static void fetch_generation_stats(ChatDone done, std::vector<GenerationResult> results, const std::string& base_url, const std::string& api_key, int attempt);
 };
 
 class ZenBackend : public LLMBackend {
 public:
     void set_api_key(const std::string& key) override;
+    void set_base_url(const std::string& url) override;
     GenerationResult generate_commit_message(const std::string& diff, const std::string& instructions, const std::string& model, const std::string& provider = "", double temperature = -1.0) override;
     std::vector<Model> get_available_models() override;
     std::string get_balance() override;
+    void warm_up() override;
+    std::future<GenerationResult> generate_commit_message_async(const std::string& diff, const std::string& instructions, const std::string& model, const std::string& provider = "", double temperature = -1.0) override;
+    std::future<std::vector<Model>> get_available_models_async() override;
 private:
     std::string api_key;
-    GenerationResult handle_chat_response(const std::string& response, const std::string& payload);
-    std::vector<Model> parse_models_response(const std::string& response);
-    void handle_api_error(const std::string& response, const std::string& error_msg);
-    std::string get_pricing_for_model(const std::string& id);
+    std::string base_url = "https://opencode.ai/zen/v1";
+    static GenerationResult handle_chat_response(const std::string& response, const std::string& payload);
+    static std::vector<Model> parse_models_response(const std::string& response);
+    static void handle_api_error(const std::string& response, const std::string& error_msg);
+    static std::string get_pricing_for_model(const std::string& id);
     std::string get_endpoint_for_model(const std::string& model);
-    nlohmann::json build_payload_for_model(const std::string& model, const std::string& instructions, const std::string& diff);
-};
\ No newline at end of file
+    std::string build_payload_for_model(const std::string& model, const std::string& instructions, const std::string& diff);
+};
+
+// Any server speaking the OpenAI chat completions API, by default a local llama.cpp or
+// vLLM server. Requests go through HttpExecutor, whose connection pool keeps the
+// connection open between requests.
+class OpenAICompatBackend : public LLMBackend {
+public:
+    void set_api_key(const std::string& key) override;
+    void set_base_url(const std::string& url) override;
+    GenerationResult generate_commit_message(const std::string& diff, const std::string& instructions, const std::string& model, const std::string& provider = "", double temperature = -1.0) override;
+    std::vector<Model> get_available_models() override;
+    std::string get_balance() override;
+    void warm_up() override;
+    std::future<GenerationResult> generate_commit_message_async(const std::string& diff, const std::string& instructions, const std::string& model, const std::string& provider = "", double temperature = -1.0) override;
+    std::future<std::vector<Model>> get_available_models_async() override;
+    bool supports_choices() const override { return true; }
+    std::future<std::vector<GenerationResult>> generate_choices_async(const std::string& diff, const std::string& instructions, const std::string& model, const std::string& provider, double temperature, size_t n) override;
+
+private:
+    std::string api_key;  // Optional; local servers usually run without one
+    std::string base_url = "http://127.0.0.1:8080/v1";
+    std::unique_ptr<CurlRequest> make_request() const;
+    std::unique_ptr<CurlRequest> make_chat_request(const std::string& diff, const std::string& instructions, const std::string& model, double temperature, size_t n) const;
+    static std::vector<GenerationResult> parse_choices(const std::string& response);
+};
+
+// Records exchanges with a real backend into a fixture directory, or serves them
+// back without network access so the whole pipeline can be benchmarked offline.
+class ReplayBackend : public LLMBackend {
+public:
+    // Record mode: forwards every call to `inner` and saves the exchange
+    ReplayBackend(std::unique_ptr<LLMBackend> inner, const std::string& fixture_dir);
+    // Replay mode: `latency_spec` is "none", "recorded", "fixed:MS", "uniform:MIN:MAX" or "normal:MEAN:STDDEV".
+    // With `any_match`, a generation with no recording of its own is served the first recorded one.
+    ReplayBackend(const std::string& fixture_dir, const std::string& latency_spec, bool any_match = false);
+    void set_api_key(const std::string& key) override;
+    void set_base_url(const std::string& url) override;
+    GenerationResult generate_commit_message(const std::string& diff, const std::string& instructions, const std::string& model, const std::string& provider = "", double temperature = -1.0) override;
+    std::vector<Model> get_available_models() override;
+    std::string get_balance() override;
+    void warm_up() override;
+
+private:
+    enum class Latency { None, Recorded, Fixed, Uniform, Normal };
+    std::unique_ptr<LLMBackend> inner;
+    std::string fixture_dir;
+    Latency latency = Latency::None;
+    bool any_match = false;
+    double latency_a = 0.0;
+    double latency_b = 0.0;
+
+    nlohmann::json load_fixture(const std::string& name, const std::string& fallback_prefix);
+    void save_fixture(const std::string& name, const nlohmann::json& fixture);
+    // Draws from its own engine, so that concurrent requests do not share one
+    void simulate_latency(double recorded_ms, uint64_t seed);
+};
+
+// Forwards every call to a running commitd over its Unix socket. The daemon keeps backends,
+// their pooled HTTP connections and the model catalog between runs, so a run skips the
+// TCP and TLS setup and the catalog download. With `set_preview(true)` the daemon keeps the
+// response, and the next identical non-preview request gets that message instead of a new
+// generation.
+class DaemonClientBackend : public LLMBackend {
+public:
+    // Returns nullptr when no daemon is listening on `socket_path`, so the caller can run
+    // the backend in-process instead
+    static std::unique_ptr<DaemonClientBackend> connect(const std::string& backend, const std::string& socket_path);
+
+    void set_api_key(const std::string& key) override;
+    void set_base_url(const std::string& url) override;
+    void set_preview(bool preview) { this->preview = preview; }
+    GenerationResult generate_commit_message(const std::string& diff, const std::string& instructions, const std::string& model, const std::string& provider = "", double temperature = -1.0) override;
+    std::vector<Model> get_available_models() override;
+    std::string get_balance() override;
+    // Has the daemon reopen its connection if the server closed it while idle
+    void warm_up() override;
+    bool supports_choices() const override { return true; }
+    std::future<std::vector<GenerationResult>> generate_choices_async(const std::string& diff, const std::string& instructions, const std::string& model, const std::string& provider, double temperature, size_t n) override;
+
+private:
+    DaemonClientBackend(const std::string& backend, const std::string& socket_path) : backend(backend), socket_path(socket_path) {}
+
+    std::string backend;
+    std::string socket_path;
+    std::string api_key;
+    std::string base_url;
+    bool preview = false;
+
+    // One connection per call, so concurrent calls need no coordination
+    nlohmann::json call(nlohmann::json request) const;
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+#include "stats_store.hpp"
+
+// Renders the aggregates of a stats log as counters and histograms in the Prometheus text
+// exposition format, which node_exporter's textfile collector reads. Counter families keep
+// their `_total` suffix as that format expects; histograms match OpenMetrics.
+std::string format_metrics(const StatsSummary& summary);
+
+// Writes the metrics for the stats log at `log_path` to `output_path`. The file is written
+// under a temporary name in the same directory and renamed over the target, so a scrape
+// never sees a partial file. Totals come from the store's checkpoint plus the rows after it.
+void export_metrics(const std::string& log_path, const std::string& output_path);
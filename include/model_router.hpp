@@ -0,0 +1,37 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include "stats_store.hpp"
+
+// Picks a model for `model=auto` from the generation stats log: among the model/provider
+// pairs with enough history, the cheapest one for this request size whose latency at the
+// configured percentile is within the SLO. When none is, the fastest.
+struct RoutingPolicy {
+    double latency_slo_ms = 3000.0;
+    double percentile = 90.0;
+    size_t min_samples = 3;
+};
+
+struct RouteCandidate {
+    std::string model;
+    std::string provider;
+    size_t samples = 0;
+    double latency_ms = -1.0;     // At the policy percentile; -1 when no timings were logged
+    double expected_cost = -1.0;  // For the current request; -1 when no costs were logged
+    bool meets_slo = false;
+};
+
+struct RouteDecision {
+    std::string model;
+    std::string provider;
+    std::string reason;
+    std::vector<RouteCandidate> candidates;  // Best first
+};
+
+// Routes on the per-series request time histograms and cost fits of a stats summary, which the
+// store keeps checkpointed. Throws std::runtime_error when there is no usable history for `backend`.
+RouteDecision route_model(const std::map<SeriesKey, SeriesTotals>& series, const std::string& backend, const std::string& provider, size_t input_tokens, const RoutingPolicy& policy);
+
+void print_route_decision(const RouteDecision& decision, const RoutingPolicy& policy, size_t input_tokens);
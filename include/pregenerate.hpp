@@ -0,0 +1,33 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include "config.hpp"
+#include "git_utils.hpp"
+#include "llm_backend.hpp"
+
+// `commit --watch` generates messages speculatively while the worktree is quiet and stores them
+// in .commit/pregenerated/<key>.json. A later `commit` whose request has the same key uses the
+// stored message instead of calling the LLM.
+
+// Hash of everything that decides the message: the diff (the index and worktree against HEAD,
+// plus the untracked files to be added), the instructions and the model settings
+std::string pregeneration_key(const std::string& diff, const Config& config);
+
+// The stored result is marked shared_request, since the watch run already logged its cost
+std::optional<GenerationResult> load_pregenerated(const std::string& commit_dir, const std::string& key);
+// Written under a temporary name and renamed into place; only the newest few are kept
+void store_pregenerated(const std::string& commit_dir, const std::string& key, const GenerationResult& result);
+void remove_pregenerated(const std::string& commit_dir, const std::string& key);
+
+// Applies max_input_tokens and model=auto the way a commit would; false when the request
+// cannot be sent
+using FitRequest = std::function<bool(Config& config, std::string& diff)>;
+
+// Watches the worktree and the index with inotify until SIGINT or SIGTERM, or until
+// watch_budget dollars have been spent. Each time nothing has changed for watch_quiet_seconds,
+// the diff a commit would send is built and, unless a message for it is already stored, one is
+// generated on a background thread while watching continues.
+int watch_worktree(GitRepository& repo, GitUtils& git_utils, const Config& config, std::unique_ptr<LLMBackend>& llm, const FitRequest& fit_request);
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+// SAX handler that tracks the path of the value being parsed so subclasses can pick
+// out the few fields they need without building a DOM for the whole response.
+class PathSax : public nlohmann::json_sax<nlohmann::json> {
+public:
+    static constexpr size_t ANY_INDEX = std::numeric_limits<size_t>::max();
+
+    struct Segment {
+        std::string_view key;
+        size_t index = ANY_INDEX;
+        bool is_index = false;
+        Segment(const char* k) : key(k) {}
+        Segment(size_t i) : index(i), is_index(true) {}
+        Segment(int i) : index(static_cast<size_t>(i)), is_index(true) {}
+    };
+
+    bool null() override;
+    bool boolean(bool val) override;
+    bool number_integer(number_integer_t val) override;
+    bool number_unsigned(number_unsigned_t val) override;
+    bool number_float(number_float_t val, const string_t& s) override;
+    bool string(string_t& val) override;
+    bool binary(binary_t& val) override;
+    bool start_object(std::size_t elements) override;
+    bool key(string_t& val) override;
+    bool end_object() override;
+    bool start_array(std::size_t elements) override;
+    bool end_array() override;
+    bool parse_error(std::size_t position, const std::string& last_token, const nlohmann::json::exception& ex) override;
+
+protected:
+    // True when the value currently being parsed sits exactly at `path`
+    bool at(std::initializer_list<Segment> path) const;
+    // Index of the enclosing array at `depth` (0 is the outermost container)
+    size_t index_at(size_t depth) const { return frames_[depth].index; }
+
+    virtual void on_string(string_t&) {}
+    virtual void on_number(double) {}
+    // Floating-point values also arrive with their source text; the default forwards to on_number
+    virtual void on_float(double value, const string_t&) { on_number(value); }
+    virtual void on_boolean(bool) {}
+    virtual void on_object_start() {}
+    virtual void on_array_start() {}
+
+private:
+    struct Frame {
+        bool array = false;
+        size_t index = 0;
+        std::string key;
+    };
+    std::vector<Frame> frames_;
+    size_t depth_ = 0;  // frames_ is reused across containers to keep key capacity
+
+    void value_done();
+    void push_frame(bool array);
+};
+
+struct ChatResponseFields {
+    bool has_error = false;
+    std::string error_message;
+    std::string id;
+    bool has_content = false;
+    std::string content;
+    std::vector<std::string> alternatives;  // choices[1..] when several completions were requested
+    double prompt_tokens = -1;
+    double completion_tokens = -1;
+    double cached_tokens = -1;
+};
+
+// Extracts the message, id and usage from an OpenAI (`choices[0].message.content`,
+// `usage.prompt_tokens`, `usage.prompt_tokens_details.cached_tokens`) or Anthropic
+// (`content[0].text`, `usage.input_tokens`, `usage.cache_read_input_tokens`) chat response. Throws nlohmann::json::parse_error on malformed JSON.
+ChatResponseFields parse_chat_response(std::string_view response);
+
+struct CatalogEntry {
+    std::string id;
+    std::string name;
+    std::string description;
+    std::string pricing;           // Set when the provider sends pricing as a string
+    std::string prompt_price;      // Per-token prices when pricing is an object
+    std::string completion_price;
+};
+
+struct ModelCatalog {
+    bool has_error = false;
+    std::string error_message;
+    bool has_data = false;
+    std::vector<CatalogEntry> models;
+};
+
+// Extracts `data[*].{id,name,description,pricing}` from a models listing.
+ModelCatalog parse_model_catalog(std::string_view response);
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "config.hpp"
+#include "git_utils.hpp"
+#include "llm_backend.hpp"
+
+struct RewordOptions {
+    std::string range;
+    size_t concurrency = 8;
+    double requests_per_minute = 0.0;  // 0 for no limit
+    bool dry_run = false;
+};
+
+// Regenerates the message of every commit in `options.range` and rewrites the range in one
+// pass. Diffs are computed on a thread pool and requests run concurrently, bounded by the
+// concurrency limit and a requests-per-minute token bucket. Each generation is appended to
+// `generations` for the stats log. Returns the process exit code.
+int reword_commits(GitRepository& repo, LLMBackend& llm, Config& config, const RewordOptions& options, std::vector<GenerationResult>& generations);
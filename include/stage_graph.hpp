@@ -0,0 +1,49 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "thread_pool.hpp"
+
+// Runs named stages on a ThreadPool, each as soon as the stages it depends on have finished,
+// so independent work overlaps. Stages can be added while others run; one whose dependencies
+// are already done starts at once. A stage that throws fails every stage depending on it, and
+// wait() rethrows the exception. Each stage is traced under its name (--time-run, --trace).
+class StageGraph {
+public:
+    explicit StageGraph(ThreadPool& pool) : pool_(pool) {}
+    // Waits for started stages, so none outlives the state it captured
+    ~StageGraph();
+
+    StageGraph(const StageGraph&) = delete;
+    StageGraph& operator=(const StageGraph&) = delete;
+
+    // Throws std::runtime_error for a duplicate name or an unknown dependency
+    void add(const std::string& name, const std::vector<std::string>& dependencies, std::function<void()> run);
+    // Blocks until the stage has finished; rethrows its exception, or that of a failed dependency
+    void wait(const std::string& name);
+    void wait_all();
+
+private:
+    struct Stage {
+        std::function<void()> run;
+        std::vector<std::string> dependents;
+        size_t pending = 0;  // Dependencies not finished yet
+        bool done = false;
+        std::exception_ptr error;
+    };
+
+    // Called with mutex_ held
+    void start(const std::string& name);
+    void finish(const std::string& name, std::exception_ptr error);
+
+    ThreadPool& pool_;
+    std::mutex mutex_;
+    std::condition_variable finished_;
+    std::map<std::string, Stage> stages_;  // Guarded by mutex_
+    size_t in_flight_ = 0;                 // Guarded by mutex_; submitted to the pool, not finished
+};
@@ -7,18 +7,37 @@
 #include "llm_backend.hpp"
 #include "config.hpp"
 #include "colors.hpp"
+#include "stats_store.hpp"
 
 std::string get_xdg_data_path();
 std::string get_current_timestamp();
 
-void log_generation_stats(const std::vector<GenerationStats>& stats_list, const std::string& log_path);
+// Appends the batch as one locked write; safe to call from concurrent processes
+void log_generation_stats(const std::vector<GenerationStats>& stats_list, const std::string& log_path, bool fsync = false);
 
-void summarize_generation_stats(const std::string& log_path);
+// Checkpointed totals and per-series distributions of a stats log, read without taking the
+// write lock when the columns are current; empty when the log does not exist
+StatsSummary read_stats_summary(const std::string& log_path);
+
+struct StatsQuery {
+    std::string since;              // Inclusive; YYYY-MM-DD or a longer UTC timestamp prefix
+    std::string until;              // Inclusive, same format
+    std::string group_by = "none";  // none, day or week
+};
+
+// Throws std::runtime_error when a date or the grouping is malformed
+void validate_stats_query(const StatsQuery& query);
+
+// Prints cost and token totals, then latency percentiles and output throughput per model and
+// per provider, optionally restricted to a time window and split by day or week
+void summarize_generation_stats(const std::string& log_path, const StatsQuery& query = {});
 
 class TimingGuard {
 public:
     TimingGuard(bool enabled, const Config& config, const std::vector<GenerationResult>& generations, std::unique_ptr<LLMBackend>& llm, const std::string& repo_root, bool dry_run = false, bool llm_generated = true);
     void set_llm_time(long long ms);
+    void set_commit_time(double ms) { commit_ms_ = ms; }
+    void set_push_time(double ms) { push_ms_ = ms; }
     ~TimingGuard();
 private:
     bool enabled_;
@@ -30,4 +49,6 @@ private:
     bool llm_generated_;
     std::chrono::high_resolution_clock::time_point start_;
     long long llm_ms_;
+    double commit_ms_ = -1.0;
+    double push_ms_ = -1.0;
 };
\ No newline at end of file
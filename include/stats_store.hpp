@@ -0,0 +1,246 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <span>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include "hdr_histogram.hpp"
+#include "llm_backend.hpp"
+
+struct ModelTotals {
+    long long count = 0;
+    double cost = 0.0;
+};
+
+// Upper bounds, in seconds, of the fixed histogram buckets kept for metrics exports
+inline constexpr double LATENCY_BUCKETS[] = {0.25, 0.5, 1, 2, 5, 10, 20, 30, 60, 120};
+inline constexpr double GIT_BUCKETS[] = {0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30};
+
+// Observations per bucket, with one extra slot for values above every bound
+struct Buckets {
+    std::vector<long long> counts;
+    long long count = 0;
+    double sum = 0.0;
+
+    void record(double value, std::span<const double> bounds) {
+        if (counts.empty()) counts.assign(bounds.size() + 1, 0);
+        counts[static_cast<size_t>(std::lower_bound(bounds.begin(), bounds.end(), value) - bounds.begin())]++;
+        count++;
+        sum += value;
+    }
+
+    void add(const Buckets& other) {
+        if (counts.empty()) counts.assign(other.counts.size(), 0);
+        for (size_t i = 0; i < other.counts.size() && i < counts.size(); ++i) {
+            counts[i] += other.counts[i];
+        }
+        count += other.count;
+        sum += other.sum;
+    }
+};
+
+struct LatencyStats {
+    // 1% precision is plenty for reporting and keeps one histogram at a few KB
+    HdrHistogram latency{3600000, 2};     // ms
+    HdrHistogram throughput{10000000, 2}; // Output tokens per second, in tenths
+
+    void add(const LatencyStats& other) {
+        latency.add(other.latency);
+        throughput.add(other.throughput);
+    }
+};
+
+// Per-phase durations of the chat request, from the cumulative libcurl timings, in us
+struct NetworkStats {
+    HdrHistogram dns{3600000000, 2};
+    HdrHistogram connect{3600000000, 2};
+    HdrHistogram tls{3600000000, 2};
+    HdrHistogram wait{3600000000, 2};      // Request sent to first response byte: upload, queueing, prompt processing
+    HdrHistogram download{3600000000, 2};  // First byte to last: generation and transfer of the reply
+    HdrHistogram total{3600000000, 2};
+    HdrHistogram bytes_up{1000000000, 2};
+    std::map<std::string, long long> versions;
+
+    void add(const NetworkStats& other) {
+        dns.add(other.dns);
+        connect.add(other.connect);
+        tls.add(other.tls);
+        wait.add(other.wait);
+        download.add(other.download);
+        total.add(other.total);
+        bytes_up.add(other.bytes_up);
+        for (const auto& [version, count] : other.versions) {
+            versions[version] += count;
+        }
+    }
+};
+
+// Least-squares sums for fitting cost = input_price * input_tokens + output_price * output_tokens,
+// over the generations whose cost and token counts are both known
+struct CostFit {
+    double s_ii = 0, s_io = 0, s_oo = 0, s_ic = 0, s_oc = 0;
+    double total_output = 0, total_tokens = 0, total_cost = 0;
+    long long count = 0;
+
+    void record(double in, double out, double cost) {
+        s_ii += in * in;
+        s_io += in * out;
+        s_oo += out * out;
+        s_ic += in * cost;
+        s_oc += out * cost;
+        total_output += out;
+        total_tokens += in + out;
+        total_cost += cost;
+        count++;
+    }
+
+    void add(const CostFit& other) {
+        s_ii += other.s_ii;
+        s_io += other.s_io;
+        s_oo += other.s_oo;
+        s_ic += other.s_ic;
+        s_oc += other.s_oc;
+        total_output += other.total_output;
+        total_tokens += other.total_tokens;
+        total_cost += other.total_cost;
+        count += other.count;
+    }
+
+    // Expected cost of a request with `input_tokens` and the mean output seen so far; -1
+    // without history
+    double expected(double input_tokens) const {
+        if (count == 0) return -1.0;
+        return expected(input_tokens, total_output / static_cast<double>(count));
+    }
+
+    double expected(double input_tokens, double output_tokens) const {
+        if (count == 0) return -1.0;
+        double det = s_ii * s_oo - s_io * s_io;
+        if (count >= 2 && det > 1e-9 * s_ii * s_oo) {
+            double input_price = (s_ic * s_oo - s_oc * s_io) / det;
+            double output_price = (s_oc * s_ii - s_ic * s_io) / det;
+            if (input_price >= 0 && output_price >= 0) {
+                return input_price * input_tokens + output_price * output_tokens;
+            }
+        }
+        // Too few or too similar requests to separate the two prices: use the blended rate
+        if (total_tokens <= 0) return total_cost / static_cast<double>(count);
+        return total_cost / total_tokens * (input_tokens + output_tokens);
+    }
+};
+
+// Totals for one backend, model and provider
+struct SeriesTotals {
+    long long count = 0;
+    long long dry_run_count = 0;
+    double cost = 0.0;
+    double input_tokens = 0.0;
+    double output_tokens = 0.0;
+    long long cache_hits = 0;  // Generations that read part of the prompt from the provider's cache
+    double cached_tokens = 0.0;
+    Buckets latency;           // Seconds, LATENCY_BUCKETS
+    LatencyStats percentiles;  // For the summary's latency and throughput tables
+    NetworkStats network;      // Requests with libcurl timings only
+    // For model=auto: the client's request time, else server latency plus generation time, in ms
+    HdrHistogram request_ms{3600000, 2};
+    CostFit cost_fit;
+
+    void add(const SeriesTotals& other) {
+        count += other.count;
+        dry_run_count += other.dry_run_count;
+        cost += other.cost;
+        input_tokens += other.input_tokens;
+        output_tokens += other.output_tokens;
+        cache_hits += other.cache_hits;
+        cached_tokens += other.cached_tokens;
+        latency.add(other.latency);
+        percentiles.add(other.percentiles);
+        network.add(other.network);
+        request_ms.add(other.request_ms);
+        cost_fit.add(other.cost_fit);
+    }
+};
+
+using SeriesKey = std::tuple<std::string, std::string, std::string>;  // Backend, model, provider
+
+// Aggregates over a stats log. Negative (unknown) costs and token counts are left out of the sums.
+struct StatsSummary {
+    long long count = 0;
+    long long actual_count = 0;
+    long long dry_run_count = 0;
+    double total_cost = 0.0;
+    double actual_cost = 0.0;
+    double dry_run_cost = 0.0;
+    double input_tokens = 0.0;
+    double output_tokens = 0.0;
+    std::map<std::string, ModelTotals> models;
+    std::map<SeriesKey, SeriesTotals> series;
+    Buckets commit_time;  // Seconds per run, GIT_BUCKETS
+    Buckets push_time;
+};
+
+// Totals over an arbitrary set of entries, e.g. those in a time window
+StatsSummary summarize_stats(const std::vector<GenerationStats>& stats_list);
+
+// Binary columnar copy of a JSONL stats log, kept in `<log>.cols/`. Each field is an
+// append-only file of fixed-width values and strings are interned in a dictionary, so
+// reading a column never parses JSON. Aggregates, including the latency, throughput and
+// network histograms of each series, are checkpointed every CHECKPOINT_INTERVAL rows; a
+// summary loads the checkpoint and scans only the rows after it.
+//
+// The JSONL log stays the export format and is still appended on every write. On open,
+// lines that some other writer appended to it since the last sync are imported; the first
+// open imports the whole log. Opening and appending hold an exclusive flock() on the log,
+// so concurrent processes neither interleave lines nor corrupt the columns.
+//
+// A ReadOnly open only takes a shared flock() while the columns already cover the log, and
+// writes nothing. When they are behind it imports under the exclusive lock like any open,
+// and if the sidecar cannot be written it parses the JSONL log into memory instead.
+class StatsStore {
+public:
+    static constexpr size_t CHECKPOINT_INTERVAL = 4096;
+
+    enum class Access { ReadWrite, ReadOnly };
+
+    explicit StatsStore(const std::string& log_path, Access access = Access::ReadWrite);
+
+    // Appends the batch to the JSONL log with a single O_APPEND write, then to the columns.
+    // With `fsync` the log is flushed to disk before returning; the columns can always be
+    // rebuilt from it.
+    void append(const std::vector<GenerationStats>& stats_list, bool fsync = false);
+    StatsSummary summary() const;
+    std::vector<GenerationStats> read_all() const;
+    // Entries dated within [since, until], in seconds since the epoch. Only the span of rows
+    // between the first and the last match is read beyond the date column.
+    std::vector<GenerationStats> read_between(int64_t since, int64_t until) const;
+    size_t size() const { return rows_; }
+
+private:
+    std::string log_path_;
+    std::filesystem::path dir_;
+    size_t rows_ = 0;
+    uintmax_t jsonl_bytes_ = 0;  // Length of the JSONL log already in the columns
+    std::vector<std::string> strings_;
+    std::unordered_map<std::string, uint32_t> string_ids_;
+    bool in_memory_ = false;  // Read-only fallback: the log's entries, without the columns
+    std::vector<GenerationStats> memory_;
+
+    bool load_current();
+    void load_jsonl();
+    void sync();
+    void repair();
+    void load_strings();
+    void import_jsonl();
+    uint32_t intern(const std::string& value);
+    void append_columns(const std::vector<GenerationStats>& stats_list);
+    void save_source() const;
+    void maybe_checkpoint() const;
+    bool load_checkpoint(StatsSummary& summary, size_t& rows) const;
+    void scan(StatsSummary& summary, size_t from) const;
+    std::vector<GenerationStats> read_rows(size_t from, size_t to) const;
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Byte-pair-encoding token counter for tiktoken vocabularies (cl100k_base, o200k_base).
+// Used to budget requests before they are uploaded; the pre-tokenizer approximates the
+// tiktoken regex with ASCII character classes, so counts on non-English text are estimates.
+// A default-constructed tokenizer has no vocabulary and falls back to estimate_tokens().
+class BpeTokenizer {
+public:
+    // Loads a tiktoken-format file: one "<base64 token> <rank>" pair per line
+    static BpeTokenizer load_from_file(const std::string& path);
+
+    size_t count(std::string_view text);
+    std::vector<uint32_t> encode(std::string_view text) const;
+    bool has_vocab() const { return !ranks_.empty(); }
+    const std::string& name() const { return name_; }
+    size_t vocab_size() const { return ranks_.size(); }
+
+private:
+    struct StringHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+    };
+    using RankMap = std::unordered_map<std::string, uint32_t, StringHash, std::equal_to<>>;
+
+    std::string name_;
+    RankMap ranks_;
+    RankMap piece_counts_;  // Diffs repeat identifiers a lot, so merged pieces are cached
+
+    size_t count_piece(std::string_view piece);
+    void merge_piece(std::string_view piece, std::vector<uint32_t>& out) const;
+    std::vector<size_t> merge_boundaries(std::string_view piece) const;
+};
+
+// Splits text the way the cl100k regex does: contractions, letter runs with one leading
+// symbol or space, 1-3 digit groups, punctuation runs and whitespace runs.
+std::vector<std::string_view> pretokenize(std::string_view text);
+
+// Rough count (about four bytes per token) for when no vocabulary file is installed
+size_t estimate_tokens(std::string_view text);
+
+// Cuts `diff` at a line boundary so that `instructions` plus the diff fit in `budget` tokens.
+// Throws std::runtime_error when the instructions alone leave no room for any diff.
+std::string trim_diff_to_budget(BpeTokenizer& tokenizer, const std::string& instructions, const std::string& diff, size_t budget);
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Collects named spans for one run: where the time went between repo discovery and the
+// final log write. Disabled by default; spans started while disabled record nothing, so
+// the instrumentation costs a clock read and a flag check.
+class Tracer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static Tracer& instance();
+
+    void enable() { enabled_ = true; }
+    bool enabled() const { return enabled_; }
+
+    // Thread-safe; `detail` is shown in the trace viewer's argument pane
+    void record(std::string name, Clock::time_point start, Clock::time_point end, std::string detail = "");
+
+    // Chrome trace-event JSON, viewable in chrome://tracing or ui.perfetto.dev
+    void write_chrome_trace(const std::string& path) const;
+    // One line per span name in order of first appearance, with count, total and max
+    void print_table() const;
+
+private:
+    struct Span {
+        std::string name;
+        std::string detail;
+        Clock::time_point start;
+        Clock::time_point end;
+        int thread;
+    };
+
+    Tracer() : origin_(Clock::now()) {}
+
+    std::atomic<bool> enabled_ = false;
+    Clock::time_point origin_;
+    mutable std::mutex mutex_;
+    std::vector<Span> spans_;                 // Guarded by mutex_
+    std::map<std::thread::id, int> threads_;  // Guarded by mutex_; small ids for the viewer
+};
+
+// Records the time from construction to end() or destruction as one span
+class TraceSpan {
+public:
+    explicit TraceSpan(std::string name) : name_(std::move(name)), active_(Tracer::instance().enabled()) {
+        if (active_) start_ = Tracer::Clock::now();
+    }
+    ~TraceSpan() { end(); }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    void end() {
+        if (!active_) return;
+        active_ = false;
+        Tracer::instance().record(std::move(name_), start_, Tracer::Clock::now());
+    }
+
+private:
+    std::string name_;
+    bool active_;
+    Tracer::Clock::time_point start_;
+};
+
+// Writes the trace to `path`, unless it is empty, when it goes out of scope
+class TraceFile {
+public:
+    explicit TraceFile(std::string path) : path_(std::move(path)) {}
+    ~TraceFile();
+
+    TraceFile(const TraceFile&) = delete;
+    TraceFile& operator=(const TraceFile&) = delete;
+
+private:
+    std::string path_;
+};
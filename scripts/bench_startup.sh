@@ -0,0 +1,40 @@
+#!/bin/bash
+# Startup cost of one or more commit binaries, e.g. before and after a change:
+#   scripts/bench_startup.sh old/bin/commit bin/commit
+# For each binary: file size, time spent in the dynamic loader before main (relocations and
+# symbol lookup, from LD_DEBUG=statistics), mean wall time of `--help` over RUNS runs, and the
+# maximum RSS of one run (needs GNU time in /usr/bin/time).
+
+set -e
+
+RUNS=${RUNS:-200}
+if [ $# -eq 0 ]; then
+    set -- bin/commit
+fi
+
+printf "%-32s %10s %14s %8s %12s %10s\n" "binary" "size KiB" "loader" "relocs" "mean --help" "max RSS"
+for binary in "$@"; do
+    if [ ! -x "$binary" ]; then
+        echo "Not an executable: $binary" >&2
+        exit 1
+    fi
+    size_kib=$(( $(stat -c %s "$binary") / 1024 ))
+
+    stats=$(LD_DEBUG=statistics "$binary" --help 2>&1 >/dev/null)
+    loader=$(echo "$stats" | sed -n 's/.*total startup time in dynamic loader: *\([0-9]*\) *\([a-z]*\).*/\1 \2/p' | head -1)
+    relocs=$(echo "$stats" | sed -n 's/.*number of relocations: *\([0-9]*\).*/\1/p' | head -1)
+
+    start=$(date +%s%N)
+    for ((i = 0; i < RUNS; i++)); do
+        "$binary" --help >/dev/null
+    done
+    end=$(date +%s%N)
+    mean_ms=$(awk -v ns=$((end - start)) -v runs="$RUNS" 'BEGIN { printf "%.2f ms", ns / runs / 1e6 }')
+
+    rss="n/a"
+    if [ -x /usr/bin/time ]; then
+        rss="$(/usr/bin/time -f %M "$binary" --help 2>&1 >/dev/null | tail -1) KiB"
+    fi
+
+    printf "%-32s %10s %14s %8s %12s %10s\n" "$binary" "$size_kib" "${loader:-n/a}" "${relocs:-n/a}" "$mean_ms" "$rss"
+done
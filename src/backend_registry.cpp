@@ -0,0 +1,44 @@
+#include "backend_registry.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+BackendRegistry& BackendRegistry::instance() {
+    static BackendRegistry registry;
+    return registry;
+}
+
+void BackendRegistry::add(BackendInfo info) {
+    auto it = std::find_if(backends_.begin(), backends_.end(), [&](const BackendInfo& b) { return b.name == info.name; });
+    if (it != backends_.end()) {
+        throw std::logic_error("Backend registered twice: " + info.name);
+    }
+    backends_.push_back(std::move(info));
+}
+
+const BackendInfo* BackendRegistry::find(const std::string& name) const {
+    auto it = std::find_if(backends_.begin(), backends_.end(), [&](const BackendInfo& b) { return b.name == name; });
+    return it == backends_.end() ? nullptr : &*it;
+}
+
+const BackendInfo& BackendRegistry::get(const std::string& name) const {
+    if (const BackendInfo* info = find(name)) {
+        return *info;
+    }
+    std::string known;
+    for (const auto& n : names()) {
+        known += (known.empty() ? "" : ", ") + n;
+    }
+    throw std::runtime_error("Unknown backend '" + name + "' (available: " + known + ")");
+}
+
+std::vector<std::string> BackendRegistry::names() const {
+    std::vector<std::string> result;
+    for (const auto& b : backends_) {
+        result.push_back(b.name);
+    }
+    std::sort(result.begin(), result.end(), [](const std::string& a, const std::string& b) {
+        if ((a == "openrouter") != (b == "openrouter")) return a == "openrouter";
+        return a < b;
+    });
+    return result;
+}
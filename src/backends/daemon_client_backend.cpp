@@ -0,0 +1,89 @@
+#include "llm_backend.hpp"
+#include <stdexcept>
+#include <unistd.h>
+#include "daemon_protocol.hpp"
+
+std::unique_ptr<DaemonClientBackend> DaemonClientBackend::connect(const std::string& backend, const std::string& socket_path) {
+    if (!ping_daemon(socket_path)) {
+        return nullptr;
+    }
+    return std::unique_ptr<DaemonClientBackend>(new DaemonClientBackend(backend, socket_path));
+}
+
+void DaemonClientBackend::set_api_key(const std::string& key) {
+    api_key = key;
+}
+
+void DaemonClientBackend::set_base_url(const std::string& url) {
+    base_url = url;
+}
+
+nlohmann::json DaemonClientBackend::call(nlohmann::json request) const {
+    request["backend"] = backend;
+    request["api_key"] = api_key;
+    request["base_url"] = base_url;
+    int fd = connect_daemon(socket_path);
+    if (fd < 0) {
+        throw std::runtime_error("commitd is not running at " + socket_path);
+    }
+    nlohmann::json response;
+    try {
+        send_message(fd, request);
+        response = receive_message(fd);
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+    if (response.contains("error")) {
+        throw std::runtime_error(response["error"].get<std::string>());
+    }
+    return response.at("result");
+}
+
+GenerationResult DaemonClientBackend::generate_commit_message(const std::string& diff, const std::string& instructions, const std::string& model, const std::string& provider, double temperature) {
+    return result_from_json(call({
+        {"op", "generate"},
+        {"diff", diff},
+        {"instructions", instructions},
+        {"model", model},
+        {"provider", provider},
+        {"temperature", temperature},
+        {"preview", preview}
+    }));
+}
+
+std::future<std::vector<GenerationResult>> DaemonClientBackend::generate_choices_async(const std::string& diff, const std::string& instructions, const std::string& model, const std::string& provider, double temperature, size_t n) {
+    return std::async(std::launch::async, [this, diff, instructions, model, provider, temperature, n] {
+        nlohmann::json results = call({
+            {"op", "choices"},
+            {"diff", diff},
+            {"instructions", instructions},
+            {"model", model},
+            {"provider", provider},
+            {"temperature", temperature},
+            {"n", n}
+        });
+        std::vector<GenerationResult> choices;
+        for (const auto& r : results) {
+            choices.push_back(result_from_json(r));
+        }
+        return choices;
+    });
+}
+
+std::vector<Model> DaemonClientBackend::get_available_models() {
+    return models_from_json(call({{"op", "models"}}));
+}
+
+std::string DaemonClientBackend::get_balance() {
+    return call({{"op", "balance"}}).get<std::string>();
+}
+
+void DaemonClientBackend::warm_up() {
+    try {
+        call({{"op", "warm_up"}});
+    } catch (const std::exception&) {
+        // Only a head start; the real request reports any problem
+    }
+}
@@ -0,0 +1,155 @@
+#include "llm_backend.hpp"
+#include <curl/curl.h>
+#include <iostream>
+#include <stdexcept>
+#include <nlohmann/json.hpp>
+#include "backend_registry.hpp"
+#include "curl_request.hpp"
+#include "http_executor.hpp"
+#include "json_writer.hpp"
+#include "response_parser.hpp"
+
+namespace {
+
+BackendRegistrar registrar({
+    "local",
+    "OpenAI-compatible server, e.g. llama.cpp or vLLM on localhost",
+    "",
+    false,
+    &Config::local_api_key,
+    &Config::local_base_url,
+    [] { return std::make_unique<OpenAICompatBackend>(); }
+});
+
+} // namespace
+
+void OpenAICompatBackend::set_api_key(const std::string& key) {
+    api_key = key;
+}
+
+void OpenAICompatBackend::set_base_url(const std::string& url) {
+    base_url = url;
+}
+
+std::unique_ptr<CurlRequest> OpenAICompatBackend::make_request() const {
+    auto req = std::make_unique<CurlRequest>();
+    req->set_tcp_keepalive();
+    if (!api_key.empty()) {
+        req->add_header("Authorization: Bearer " + api_key);
+    }
+    return req;
+}
+
+GenerationResult OpenAICompatBackend::generate_commit_message(const std::string& diff, const std::string& instructions, const std::string& model, const std::string& provider, double temperature) {
+    return generate_commit_message_async(diff, instructions, model, provider, temperature).get();
+}
+
+std::future<GenerationResult> OpenAICompatBackend::generate_commit_message_async(const std::string& diff, const std::string& instructions, const std::string& model, const std::string& provider, double temperature) {
+    return fetch_async<GenerationResult>(make_chat_request(diff, instructions, model, temperature, 1), base_url + "/chat/completions", [](const std::string& response, const HttpTiming& timing) {
+        GenerationResult result = std::move(parse_choices(response).front());
+        result.http = timing;
+        return result;
+    });
+}
+
+std::future<std::vector<GenerationResult>> OpenAICompatBackend::generate_choices_async(const std::string& diff, const std::string& instructions, const std::string& model, const std::string& provider, double temperature, size_t n) {
+    return fetch_async<std::vector<GenerationResult>>(make_chat_request(diff, instructions, model, temperature, n), base_url + "/chat/completions", [](const std::string& response, const HttpTiming& timing) {
+        std::vector<GenerationResult> results = parse_choices(response);
+        results.front().http = timing;
+        return results;
+    });
+}
+
+std::unique_ptr<CurlRequest> OpenAICompatBackend::make_chat_request(const std::string& diff, const std::string& instructions, const std::string& model, double temperature, size_t n) const {
+    nlohmann::json payload_json = {
+        {"model", model}
+    };
+    if (temperature >= 0.0) {
+        payload_json["temperature"] = temperature;
+    }
+    if (n > 1) {
+        payload_json["n"] = n;
+    }
+    auto req = make_request();
+    req->set_postfields(build_chat_payload(payload_json, instructions, diff));
+    req->add_header("Content-Type: application/json");
+    return req;
+}
+
+std::vector<GenerationResult> OpenAICompatBackend::parse_choices(const std::string& response) {
+    try {
+        ChatResponseFields fields = parse_chat_response(response);
+        if (fields.has_error) {
+            std::cerr << "API error: " << fields.error_message << std::endl;
+            throw std::runtime_error("API error: " + fields.error_message);
+        }
+        if (!fields.has_content) {
+            std::cerr << "Unexpected response format in commit message generation" << std::endl;
+            std::cerr << "Full response: " << response << std::endl;
+            throw std::runtime_error("Unexpected response format");
+        }
+        std::vector<GenerationResult> results(1);
+        GenerationResult& result = results.front();
+        result.content = std::move(fields.content);
+        result.generation_id = std::move(fields.id);
+        result.input_tokens = fields.prompt_tokens;
+        result.output_tokens = fields.completion_tokens;
+        result.cached_tokens = fields.cached_tokens;
+        // Local inference has no per-request charge
+        result.total_cost = 0.0;
+        for (auto& alternative : fields.alternatives) {
+            if (alternative.empty()) continue;
+            GenerationResult extra;
+            extra.content = std::move(alternative);
+            extra.generation_id = results.front().generation_id;
+            extra.shared_request = true;
+            results.push_back(std::move(extra));
+        }
+        return results;
+    } catch (const nlohmann::json::exception& e) {
+        std::cerr << "JSON parsing error in commit message generation: " << e.what() << std::endl;
+        std::cerr << "Full response: " << response << std::endl;
+        throw;
+    }
+}
+
+std::vector<Model> OpenAICompatBackend::get_available_models() {
+    return get_available_models_async().get();
+}
+
+std::future<std::vector<Model>> OpenAICompatBackend::get_available_models_async() {
+    auto req = make_request();
+    req->set_get_method();
+
+    return fetch_async<std::vector<Model>>(std::move(req), base_url + "/models", [](const std::string& response) {
+        try {
+            ModelCatalog catalog = parse_model_catalog(response);
+            if (catalog.has_error) {
+                throw std::runtime_error("API error: " + catalog.error_message);
+            }
+            std::vector<Model> models;
+            models.reserve(catalog.models.size());
+            for (auto& entry : catalog.models) {
+                Model m;
+                m.id = entry.id;
+                m.name = entry.name.empty() ? std::move(entry.id) : std::move(entry.name);
+                m.description = std::move(entry.description);
+                m.pricing = "local";
+                models.push_back(std::move(m));
+            }
+            return models;
+        } catch (const nlohmann::json::exception& e) {
+            std::cerr << "JSON parsing error in models query: " << e.what() << std::endl;
+            std::cerr << "Full response: " << response << std::endl;
+            throw;
+        }
+    });
+}
+
+void OpenAICompatBackend::warm_up() {
+    HttpExecutor::instance().preconnect(base_url);
+}
+
+std::string OpenAICompatBackend::get_balance() {
+    return "n/a (local backend)";
+}
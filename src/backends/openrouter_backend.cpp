@@ -11,25 +11,73 @@
 #include <chrono>
 #include "llm_backend.hpp"
 #include "curl_request.hpp"
+#include "http_executor.hpp"
+#include "json_writer.hpp"
+#include "response_parser.hpp"
+#include "backend_registry.hpp"
+
+namespace {
+
+BackendRegistrar registrar({
+    "openrouter",
+    "OpenRouter (openrouter.ai)",
+    "OPENROUTER_API_KEY",
+    true,
+    &Config::openrouter_api_key,
+    &Config::openrouter_base_url,
+    [] { return std::make_unique<OpenRouterBackend>(); }
+});
+
+} // namespace
 
 void OpenRouterBackend::set_api_key(const std::string& key) {
     api_key = key;
 }
 
+void OpenRouterBackend::set_base_url(const std::string& url) {
+    base_url = url;
+}
+
 GenerationResult OpenRouterBackend::generate_commit_message(const std::string& diff, const std::string& instructions, const std::string& model, const std::string& provider, double temperature) {
-    CurlRequest req;
+    return generate_commit_message_async(diff, instructions, model, provider, temperature).get();
+}
+
+std::future<GenerationResult> OpenRouterBackend::generate_commit_message_async(const std::string& diff, const std::string& instructions, const std::string& model, const std::string& provider, double temperature) {
+    auto promise = std::make_shared<std::promise<GenerationResult>>();
+    std::future<GenerationResult> future = promise->get_future();
+    submit_chat(diff, instructions, model, provider, temperature, 1, [promise](std::vector<GenerationResult>&& results, std::exception_ptr error) {
+        if (error) {
+            promise->set_exception(error);
+        } else {
+            promise->set_value(std::move(results.front()));
+        }
+    });
+    return future;
+}
+
+std::future<std::vector<GenerationResult>> OpenRouterBackend::generate_choices_async(const std::string& diff, const std::string& instructions, const std::string& model, const std::string& provider, double temperature, size_t n) {
+    auto promise = std::make_shared<std::promise<std::vector<GenerationResult>>>();
+    std::future<std::vector<GenerationResult>> future = promise->get_future();
+    submit_chat(diff, instructions, model, provider, temperature, n, [promise](std::vector<GenerationResult>&& results, std::exception_ptr error) {
+        if (error) {
+            promise->set_exception(error);
+        } else {
+            promise->set_value(std::move(results));
+        }
+    });
+    return future;
+}
 
-    std::string url = "https://openrouter.ai/api/v1/chat/completions";
+void OpenRouterBackend::submit_chat(const std::string& diff, const std::string& instructions, const std::string& model, const std::string& provider, double temperature, size_t n, ChatDone done) {
+    auto req = std::make_unique<CurlRequest>();
+
+    std::string url = base_url + "/chat/completions";
     if (api_key.empty()) {
         throw std::runtime_error("API key not set");
     }
 
     nlohmann::json payload_json = {
-        {"model", model},
-        {"messages", {{
-            {"role", "user"},
-            {"content", instructions + "\n\nDiff:\n" + diff}
-        }}}
+        {"model", model}
     };
     if (!provider.empty()) {
         payload_json["provider"] = {
@@ -40,37 +88,43 @@ GenerationResult OpenRouterBackend::generate_commit_message(const std::string& d
     if (temperature >= 0.0) {
         payload_json["temperature"] = temperature;
     }
-    std::string payload = payload_json.dump();
-
-    req.set_url(url);
-    req.set_postfields(payload);
-    req.add_header("Authorization: Bearer " + api_key);
-    req.add_header("Content-Type: application/json");
-
-    std::string response;
-    req.set_write_callback(WriteCallback, &response);
-
-    CURLcode res = req.perform();
-    if (res != CURLE_OK) {
-        std::cerr << "Failed to fetch URL: " << url << ", libcurl error: " << curl_easy_strerror(res) << std::endl;
-        throw std::runtime_error("Curl error: " + std::string(curl_easy_strerror(res)));
+    if (n > 1) {
+        payload_json["n"] = n;
     }
+    std::string payload = build_chat_payload(payload_json, instructions, diff);
 
-    GenerationResult result = handle_chat_response(response, payload);
+    req->set_url(url);
+    req->set_postfields(payload);
+    req->add_header("Authorization: Bearer " + api_key);
+    req->add_header("Content-Type: application/json");
 
-    // Fetch detailed generation statistics
-    if (!result.generation_id.empty()) {
-        fetch_generation_stats(result, result.generation_id);
-    }
-
-    return result;
+    HttpExecutor::instance().submit(std::move(req), [done, url, payload = std::move(payload), base_url = base_url, api_key = api_key](CURLcode res, std::string&& response, const HttpTiming& timing) {
+        std::vector<GenerationResult> results;
+        try {
+            if (res != CURLE_OK) {
+                throw curl_error(url, res);
+            }
+            results = handle_chat_response(response, payload);
+            // The stats request that follows is not part of the generation's timing
+            results.front().http = timing;
+        } catch (...) {
+            done({}, std::current_exception());
+            return;
+        }
+        // Fetch detailed generation statistics before completing
+        if (!results.front().generation_id.empty()) {
+            fetch_generation_stats(done, std::move(results), base_url, api_key, 0);
+            return;
+        }
+        done(std::move(results), nullptr);
+    });
 }
 
-GenerationResult OpenRouterBackend::handle_chat_response(const std::string& response, const std::string& payload) {
+std::vector<GenerationResult> OpenRouterBackend::handle_chat_response(const std::string& response, const std::string& payload) {
     try {
-        nlohmann::json j = nlohmann::json::parse(response);
-        if (j.contains("error")) {
-            std::string error_msg = j["error"]["message"];
+        ChatResponseFields fields = parse_chat_response(response);
+        if (fields.has_error) {
+            std::string error_msg = fields.error_message;
             try {
                 std::ofstream query_file("/tmp/query.txt");
                 query_file << payload;
@@ -82,20 +136,31 @@ GenerationResult OpenRouterBackend::handle_chat_response(const std::string& resp
             std::cerr << "API error: " << error_msg << std::endl;
             throw std::runtime_error("API error: " + error_msg);
         }
-        GenerationResult result;
-        result.content = j["choices"][0]["message"]["content"];
-        result.generation_id = j["id"];
-
-        // Extract usage statistics if available
-        if (j.contains("usage")) {
-            auto& usage = j["usage"];
-            result.input_tokens = usage.value("prompt_tokens", -1.0);
-            result.output_tokens = usage.value("completion_tokens", -1.0);
-            // Note: total_cost, latency, generation_time would need to be calculated or left as -1
-            // since they're not directly in the usage response
+        if (!fields.has_content) {
+            std::cerr << "Unexpected response format in commit message generation" << std::endl;
+            std::cerr << "Full response: " << response << std::endl;
+            throw std::runtime_error("Unexpected response format");
         }
-
-        return result;
+        std::vector<GenerationResult> results(1);
+        GenerationResult& result = results.front();
+        result.content = std::move(fields.content);
+        result.generation_id = std::move(fields.id);
+
+        // Usage statistics if available; total_cost, latency and generation_time
+        // come from the generation endpoint instead
+        result.input_tokens = fields.prompt_tokens;
+        result.output_tokens = fields.completion_tokens;
+        result.cached_tokens = fields.cached_tokens;
+
+        for (auto& alternative : fields.alternatives) {
+            if (alternative.empty()) continue;
+            GenerationResult extra;
+            extra.content = std::move(alternative);
+            extra.generation_id = results.front().generation_id;
+            extra.shared_request = true;
+            results.push_back(std::move(extra));
+        }
+        return results;
     } catch (const nlohmann::json::exception& e) {
         std::cerr << "JSON parsing error in commit message generation: " << e.what() << std::endl;
         std::cerr << "Full response: " << response << std::endl;
@@ -103,136 +168,129 @@ GenerationResult OpenRouterBackend::handle_chat_response(const std::string& resp
     }
 }
 
-void OpenRouterBackend::fetch_generation_stats(GenerationResult& result, const std::string& generation_id) {
-    for (int attempt = 0; attempt < 3; ++attempt) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-
-        CurlRequest req;
-
-        std::string url = "https://openrouter.ai/api/v1/generation?id=" + generation_id;
-        if (api_key.empty()) {
-            continue;
-        }
-
-        req.set_url(url);
-        req.add_header("Authorization: Bearer " + api_key);
-
-        std::string response;
-        req.set_write_callback(WriteCallback, &response);
-
-        CURLcode res = req.perform();
-        if (res != CURLE_OK) {
-            continue;
-        }
-
-        if (res != CURLE_OK) {
-            continue;
-        }
+void OpenRouterBackend::fetch_generation_stats(ChatDone done, std::vector<GenerationResult> results, const std::string& base_url, const std::string& api_key, int attempt) {
+    // If all retries fail, stats stay at -1 and the results are delivered as is
+    if (attempt >= 3 || api_key.empty()) {
+        done(std::move(results), nullptr);
+        return;
+    }
 
-        try {
-            nlohmann::json j = nlohmann::json::parse(response);
-            if (j.contains("data")) {
-                auto& data = j["data"];
-                result.total_cost = data.value("total_cost", -1.0);
-                result.latency = data.value("latency", -1.0);
-                result.generation_time = data.value("generation_time", -1.0);
-                // Update token counts if more accurate data available
-                if (data.contains("tokens_prompt") && data["tokens_prompt"].is_number()) {
-                    result.input_tokens = data["tokens_prompt"];
-                }
-                if (data.contains("tokens_completion") && data["tokens_completion"].is_number()) {
-                    result.output_tokens = data["tokens_completion"];
+    auto req = std::make_unique<CurlRequest>();
+    std::string url = base_url + "/generation?id=" + results.front().generation_id;
+    req->set_url(url);
+    req->add_header("Authorization: Bearer " + api_key);
+
+    // The stats are not available immediately after the generation completes
+    auto shared_results = std::make_shared<std::vector<GenerationResult>>(std::move(results));
+    HttpExecutor::instance().submit(std::move(req), [done, shared_results, base_url, api_key, attempt](CURLcode res, std::string&& response, const HttpTiming&) {
+        // The stats cover the whole request, so they go on the first result only
+        GenerationResult& result = shared_results->front();
+        if (res == CURLE_OK) {
+            try {
+                nlohmann::json j = nlohmann::json::parse(response);
+                if (j.contains("data")) {
+                    auto& data = j["data"];
+                    result.total_cost = data.value("total_cost", -1.0);
+                    result.latency = data.value("latency", -1.0);
+                    result.generation_time = data.value("generation_time", -1.0);
+                    // Update token counts if more accurate data available
+                    if (data.contains("tokens_prompt") && data["tokens_prompt"].is_number()) {
+                        result.input_tokens = data["tokens_prompt"];
+                    }
+                    if (data.contains("tokens_completion") && data["tokens_completion"].is_number()) {
+                        result.output_tokens = data["tokens_completion"];
+                    }
+                    if (data.contains("native_tokens_cached") && data["native_tokens_cached"].is_number()) {
+                        result.cached_tokens = data["native_tokens_cached"];
+                    }
+                    done(std::move(*shared_results), nullptr);
+                    return; // Success
                 }
-                return; // Success
+            } catch (const nlohmann::json::exception&) {
+                // Continue to next attempt
             }
-        } catch (const nlohmann::json::exception&) {
-            // Continue to next attempt
         }
-    }
-    // If all retries failed, leave stats as -1 (already set)
+        fetch_generation_stats(done, std::move(*shared_results), base_url, api_key, attempt + 1);
+    }, std::chrono::milliseconds(100));
 }
 
 std::vector<Model> OpenRouterBackend::get_available_models() {
-    CurlRequest req;
+    return get_available_models_async().get();
+}
 
-    std::string url = "https://openrouter.ai/api/v1/models";
+std::future<std::vector<Model>> OpenRouterBackend::get_available_models_async() {
+    auto req = std::make_unique<CurlRequest>();
+
+    std::string url = base_url + "/models";
     if (api_key.empty()) {
         throw std::runtime_error("API key not set");
     }
     std::cout << "\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\nUsing API key: \"" << api_key << "\"" << std::endl;
 
-    req.set_url(url);
-    req.add_header("Authorization: Bearer " + api_key);
-
-    std::string response;
-    req.set_write_callback(WriteCallback, &response);
+    req->add_header("Authorization: Bearer " + api_key);
 
-    CURLcode res = req.perform();
-    if (res != CURLE_OK) {
-        std::cerr << "Failed to fetch URL: " << url << ", libcurl error: " << curl_easy_strerror(res) << std::endl;
-        throw std::runtime_error("Curl error: " + std::string(curl_easy_strerror(res)));
-    }
-
-    try {
-        nlohmann::json j = nlohmann::json::parse(response);
-        std::vector<Model> models;
-        for (const auto& item : j["data"]) {
-            Model m;
-            m.id = item["id"];
-            m.name = item["name"];
-            m.description = item["description"];
-        auto pricing = item["pricing"];
-        double prompt = std::stod(pricing.value("prompt", "0.0"));
-        double completion = std::stod(pricing.value("completion", "0.0"));
-        std::stringstream ss;
-        ss << std::fixed << std::setprecision(2) << (prompt * 1000000) << "/1M input, $" << (completion * 1000000) << "/1M output";
-        m.pricing = "$" + ss.str();
-            models.push_back(m);
+    return fetch_async<std::vector<Model>>(std::move(req), url, [](const std::string& response) {
+        try {
+            ModelCatalog catalog = parse_model_catalog(response);
+            std::vector<Model> models;
+            models.reserve(catalog.models.size());
+            for (auto& entry : catalog.models) {
+                Model m;
+                m.id = std::move(entry.id);
+                m.name = std::move(entry.name);
+                m.description = std::move(entry.description);
+                double prompt = std::stod(entry.prompt_price.empty() ? "0.0" : entry.prompt_price);
+                double completion = std::stod(entry.completion_price.empty() ? "0.0" : entry.completion_price);
+                std::stringstream ss;
+                ss << std::fixed << std::setprecision(2) << (prompt * 1000000) << "/1M input, $" << (completion * 1000000) << "/1M output";
+                m.pricing = "$" + ss.str();
+                models.push_back(std::move(m));
+            }
+            return models;
+        } catch (const nlohmann::json::exception& e) {
+            std::cerr << "JSON parsing error in models query: " << e.what() << std::endl;
+            std::cerr << "Full response: " << response << std::endl;
+            throw;
         }
-        return models;
-    } catch (const nlohmann::json::exception& e) {
-        std::cerr << "JSON parsing error in models query: " << e.what() << std::endl;
-        std::cerr << "Full response: " << response << std::endl;
-        throw;
-    }
+    });
+}
+
+void OpenRouterBackend::warm_up() {
+    HttpExecutor::instance().preconnect(base_url);
 }
 
 std::string OpenRouterBackend::get_balance() {
-    CurlRequest req;
+    return get_balance_async().get();
+}
+
+std::future<std::string> OpenRouterBackend::get_balance_async() {
+    auto req = std::make_unique<CurlRequest>();
 
-    std::string url = "https://openrouter.ai/api/v1/credits";
+    std::string url = base_url + "/credits";
     if (api_key.empty()) {
         throw std::runtime_error("API key not set");
     }
 
-    req.set_url(url);
-    req.add_header("Authorization: Bearer " + api_key);
+    req->add_header("Authorization: Bearer " + api_key);
 
-    std::string response;
-    req.set_write_callback(WriteCallback, &response);
-
-    CURLcode res = req.perform();
-    if (res != CURLE_OK) {
-        std::cerr << "Failed to fetch URL: " << url << ", libcurl error: " << curl_easy_strerror(res) << std::endl;
-        throw std::runtime_error("Curl error: " + std::string(curl_easy_strerror(res)));
-    }
-
-    try {
-        nlohmann::json j = nlohmann::json::parse(response);
-        if (j.contains("data") && j["data"].contains("total_credits") && j["data"].contains("total_usage") &&
-            !j["data"]["total_credits"].is_null() && !j["data"]["total_usage"].is_null()) {
-            double total_credits = j["data"]["total_credits"];
-            double total_usage = j["data"]["total_usage"];
-            double balance = total_credits - total_usage;
-            return "$" + std::to_string(balance);
-        } else {
-            std::cerr << "Balance query response: " << response << std::endl;
-            throw std::runtime_error("Balance data not available or null in response");
+    return fetch_async<std::string>(std::move(req), url, [](const std::string& response) -> std::string {
+        try {
+            nlohmann::json j = nlohmann::json::parse(response);
+            if (j.contains("data") && j["data"].contains("total_credits") && j["data"].contains("total_usage") &&
+                !j["data"]["total_credits"].is_null() && !j["data"]["total_usage"].is_null()) {
+                double total_credits = j["data"]["total_credits"];
+                double total_usage = j["data"]["total_usage"];
+                double balance = total_credits - total_usage;
+                return "$" + std::to_string(balance);
+            } else {
+                std::cerr << "Balance query response: " << response << std::endl;
+                throw std::runtime_error("Balance data not available or null in response");
+            }
+        } catch (const nlohmann::json::exception& e) {
+            std::cerr << "JSON parsing error in balance query: " << e.what() << std::endl;
+            std::cerr << "Full response: " << response << std::endl;
+            throw;
         }
-    } catch (const nlohmann::json::exception& e) {
-        std::cerr << "JSON parsing error in balance query: " << e.what() << std::endl;
-        std::cerr << "Full response: " << response << std::endl;
-        throw;
-    }
+    });
 }
 
@@ -0,0 +1,252 @@
+#include "llm_backend.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+uint64_t fnv1a(uint64_t hash, const std::string& data) {
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    // Field separator so ("ab", "c") and ("a", "bc") hash differently
+    hash ^= 0xFF;
+    hash *= 1099511628211ULL;
+    return hash;
+}
+
+std::string request_key(const std::string& diff, const std::string& instructions, const std::string& model, const std::string& provider, double temperature) {
+    uint64_t hash = 14695981039346656037ULL;
+    hash = fnv1a(hash, model);
+    hash = fnv1a(hash, provider);
+    hash = fnv1a(hash, std::to_string(temperature));
+    hash = fnv1a(hash, instructions);
+    hash = fnv1a(hash, diff);
+    std::stringstream ss;
+    ss << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return ss.str();
+}
+
+double elapsed_ms_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+ReplayBackend::ReplayBackend(std::unique_ptr<LLMBackend> inner, const std::string& fixture_dir)
+    : inner(std::move(inner)), fixture_dir(fixture_dir) {
+    std::filesystem::create_directories(fixture_dir);
+}
+
+ReplayBackend::ReplayBackend(const std::string& fixture_dir, const std::string& latency_spec, bool any_match)
+    : fixture_dir(fixture_dir), any_match(any_match) {
+    if (!std::filesystem::is_directory(fixture_dir)) {
+        throw std::runtime_error("Replay fixture directory not found: " + fixture_dir);
+    }
+    std::string kind = latency_spec.substr(0, latency_spec.find(':'));
+    std::vector<double> params;
+    size_t pos = latency_spec.find(':');
+    while (pos != std::string::npos) {
+        size_t next = latency_spec.find(':', pos + 1);
+        try {
+            params.push_back(std::stod(latency_spec.substr(pos + 1, next - pos - 1)));
+        } catch (const std::exception&) {
+            throw std::runtime_error("Invalid replay latency: " + latency_spec);
+        }
+        pos = next;
+    }
+    size_t expected = 0;
+    if (kind.empty() || kind == "none") {
+        latency = Latency::None;
+    } else if (kind == "recorded") {
+        latency = Latency::Recorded;
+    } else if (kind == "fixed") {
+        latency = Latency::Fixed;
+        expected = 1;
+    } else if (kind == "uniform") {
+        latency = Latency::Uniform;
+        expected = 2;
+    } else if (kind == "normal") {
+        latency = Latency::Normal;
+        expected = 2;
+    } else {
+        throw std::runtime_error("Unknown replay latency distribution: " + kind);
+    }
+    if (params.size() != expected) {
+        throw std::runtime_error("Invalid replay latency: " + latency_spec);
+    }
+    if (expected > 0) latency_a = params[0];
+    if (expected > 1) latency_b = params[1];
+}
+
+void ReplayBackend::set_api_key(const std::string& key) {
+    if (inner) {
+        inner->set_api_key(key);
+    }
+}
+
+void ReplayBackend::set_base_url(const std::string& url) {
+    if (inner) {
+        inner->set_base_url(url);
+    }
+}
+
+GenerationResult ReplayBackend::generate_commit_message(const std::string& diff, const std::string& instructions, const std::string& model, const std::string& provider, double temperature) {
+    std::string key = request_key(diff, instructions, model, provider, temperature);
+    std::string name = "generation-" + key + ".json";
+
+    if (inner) {
+        auto start = std::chrono::steady_clock::now();
+        GenerationResult result = inner->generate_commit_message(diff, instructions, model, provider, temperature);
+        nlohmann::json fixture = {
+            {"request", {
+                {"model", model},
+                {"provider", provider},
+                {"temperature", temperature},
+                {"instructions_bytes", instructions.size()},
+                {"diff_bytes", diff.size()}
+            }},
+            {"elapsed_ms", elapsed_ms_since(start)},
+            {"result", {
+                {"content", result.content},
+                {"generation_id", result.generation_id},
+                {"input_tokens", result.input_tokens},
+                {"output_tokens", result.output_tokens},
+                {"total_cost", result.total_cost},
+                {"latency", result.latency},
+                {"generation_time", result.generation_time}
+            }}
+        };
+        save_fixture(name, fixture);
+        return result;
+    }
+
+    nlohmann::json fixture = load_fixture(name, "generation-");
+    // Seeded from the request, so a replayed run is reproducible even with concurrent requests
+    simulate_latency(fixture.value("elapsed_ms", 0.0), std::stoull(key, nullptr, 16));
+    const auto& r = fixture.at("result");
+    GenerationResult result;
+    result.content = r.value("content", "");
+    result.generation_id = r.value("generation_id", "");
+    result.input_tokens = r.value("input_tokens", -1.0);
+    result.output_tokens = r.value("output_tokens", -1.0);
+    result.total_cost = r.value("total_cost", -1.0);
+    result.latency = r.value("latency", -1.0);
+    result.generation_time = r.value("generation_time", -1.0);
+    return result;
+}
+
+std::vector<Model> ReplayBackend::get_available_models() {
+    if (inner) {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<Model> models = inner->get_available_models();
+        nlohmann::json list = nlohmann::json::array();
+        for (const auto& m : models) {
+            list.push_back({{"id", m.id}, {"name", m.name}, {"pricing", m.pricing}, {"description", m.description}});
+        }
+        save_fixture("models.json", {{"elapsed_ms", elapsed_ms_since(start)}, {"models", list}});
+        return models;
+    }
+
+    nlohmann::json fixture = load_fixture("models.json", "");
+    simulate_latency(fixture.value("elapsed_ms", 0.0), 0);
+    std::vector<Model> models;
+    for (const auto& m : fixture.at("models")) {
+        models.push_back({m.value("id", ""), m.value("name", ""), m.value("pricing", ""), m.value("description", "")});
+    }
+    return models;
+}
+
+void ReplayBackend::warm_up() {
+    if (inner) {
+        inner->warm_up();
+    }
+}
+
+std::string ReplayBackend::get_balance() {
+    if (inner) {
+        auto start = std::chrono::steady_clock::now();
+        std::string balance = inner->get_balance();
+        save_fixture("balance.json", {{"elapsed_ms", elapsed_ms_since(start)}, {"balance", balance}});
+        return balance;
+    }
+
+    nlohmann::json fixture = load_fixture("balance.json", "");
+    simulate_latency(fixture.value("elapsed_ms", 0.0), 0);
+    return fixture.value("balance", "");
+}
+
+nlohmann::json ReplayBackend::load_fixture(const std::string& name, const std::string& fallback_prefix) {
+    std::filesystem::path path = std::filesystem::path(fixture_dir) / name;
+    if (!std::filesystem::exists(path) && !fallback_prefix.empty()) {
+        if (!any_match) {
+            throw std::runtime_error("No recorded response for " + name + " in " + fixture_dir +
+                                     " (the request differs from the recorded ones; --replay-any serves the first recording instead)");
+        }
+        // No exact match for this request (e.g. a different diff on CI): serve the
+        // first recorded exchange of the same kind instead
+        std::vector<std::filesystem::path> candidates;
+        for (const auto& entry : std::filesystem::directory_iterator(fixture_dir)) {
+            if (entry.path().filename().string().rfind(fallback_prefix, 0) == 0) {
+                candidates.push_back(entry.path());
+            }
+        }
+        if (!candidates.empty()) {
+            path = *std::min_element(candidates.begin(), candidates.end());
+            std::cerr << "Warning: no recorded response for " << name << "; replaying "
+                      << path.filename().string() << " instead" << std::endl;
+        }
+    }
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("No recorded response for " + name + " in " + fixture_dir);
+    }
+    try {
+        return nlohmann::json::parse(file);
+    } catch (const nlohmann::json::exception& e) {
+        throw std::runtime_error("Invalid replay fixture " + path.string() + ": " + e.what());
+    }
+}
+
+void ReplayBackend::save_fixture(const std::string& name, const nlohmann::json& fixture) {
+    std::filesystem::path path = std::filesystem::path(fixture_dir) / name;
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Warning: Could not write replay fixture " << path << std::endl;
+        return;
+    }
+    file << fixture.dump(2) << "\n";
+}
+
+void ReplayBackend::simulate_latency(double recorded_ms, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    double ms = 0.0;
+    switch (latency) {
+        case Latency::None:
+            return;
+        case Latency::Recorded:
+            ms = recorded_ms;
+            break;
+        case Latency::Fixed:
+            ms = latency_a;
+            break;
+        case Latency::Uniform:
+            ms = std::uniform_real_distribution<double>(latency_a, latency_b)(rng);
+            break;
+        case Latency::Normal:
+            ms = std::normal_distribution<double>(latency_a, latency_b)(rng);
+            break;
+    }
+    if (ms > 0.0) {
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(ms));
+    }
+}
@@ -6,44 +6,63 @@
 #include <nlohmann/json.hpp>
 #include <fstream>
 #include "curl_request.hpp"
+#include "http_executor.hpp"
+#include "json_writer.hpp"
+#include "response_parser.hpp"
+#include "backend_registry.hpp"
+
+namespace {
+
+BackendRegistrar registrar({
+    "zen",
+    "OpenCode Zen (opencode.ai)",
+    "ZEN_API_KEY",
+    true,
+    &Config::zen_api_key,
+    &Config::zen_base_url,
+    [] { return std::make_unique<ZenBackend>(); }
+});
+
+} // namespace
 
 void ZenBackend::set_api_key(const std::string& key) {
     api_key = key;
 }
 
+void ZenBackend::set_base_url(const std::string& url) {
+    base_url = url;
+}
+
 GenerationResult ZenBackend::generate_commit_message(const std::string& diff, const std::string& instructions, const std::string& model, const std::string& provider, double temperature) {
-    CurlRequest req;
+    return generate_commit_message_async(diff, instructions, model, provider, temperature).get();
+}
+
+std::future<GenerationResult> ZenBackend::generate_commit_message_async(const std::string& diff, const std::string& instructions, const std::string& model, const std::string& provider, double temperature) {
+    auto req = std::make_unique<CurlRequest>();
 
     std::string url = get_endpoint_for_model(model);
     if (api_key.empty()) {
         throw std::runtime_error("API key not set");
     }
 
-    nlohmann::json payload_json = build_payload_for_model(model, instructions, diff);
-    std::string payload = payload_json.dump();
-
-    req.set_url(url);
-    req.set_postfields(payload);
-    req.add_header("Authorization: Bearer " + api_key);
-    req.add_header("Content-Type: application/json");
+    std::string payload = build_payload_for_model(model, instructions, diff);
 
-    std::string response;
-    req.set_write_callback(WriteCallback, &response);
+    req->set_postfields(payload);
+    req->add_header("Authorization: Bearer " + api_key);
+    req->add_header("Content-Type: application/json");
 
-    CURLcode res = req.perform();
-    if (res != CURLE_OK) {
-        std::cerr << "Failed to fetch URL: " << url << ", libcurl error: " << curl_easy_strerror(res) << std::endl;
-        throw std::runtime_error("Curl error: " + std::string(curl_easy_strerror(res)));
-    }
-
-    return handle_chat_response(response, payload);
+    return fetch_async<GenerationResult>(std::move(req), url, [payload = std::move(payload)](const std::string& response, const HttpTiming& timing) {
+        GenerationResult result = handle_chat_response(response, payload);
+        result.http = timing;
+        return result;
+    });
 }
 
 GenerationResult ZenBackend::handle_chat_response(const std::string& response, const std::string& payload) {
     try {
-        nlohmann::json j = nlohmann::json::parse(response);
-        if (j.contains("error")) {
-            std::string error_msg = j["error"]["message"];
+        ChatResponseFields fields = parse_chat_response(response);
+        if (fields.has_error) {
+            std::string error_msg = fields.error_message;
             try {
                 std::ofstream query_file("/tmp/query.txt");
                 query_file << payload;
@@ -55,22 +74,18 @@ GenerationResult ZenBackend::handle_chat_response(const std::string& response, c
             std::cerr << "API error: " << error_msg << std::endl;
             throw std::runtime_error("API error: " + error_msg);
         }
-        GenerationResult result;
-        // Try OpenAI format first
-        if (j.contains("choices") && j["choices"].is_array() && !j["choices"].empty()) {
-            result.content = j["choices"][0]["message"]["content"];
-            // Zen may not provide generation IDs like OpenRouter, so leave empty
-            result.generation_id = "";
-        }
-        // Try Anthropic format
-        else if (j.contains("content") && j["content"].is_array() && !j["content"].empty()) {
-            result.content = j["content"][0]["text"];
-            result.generation_id = "";
-        }
-        // Fallback
-        else {
+        // Both the OpenAI (choices[0].message.content) and Anthropic (content[0].text)
+        // shapes land in the same field
+        if (!fields.has_content) {
             throw std::runtime_error("Unexpected response format");
         }
+        GenerationResult result;
+        result.content = std::move(fields.content);
+        // Zen may not provide generation IDs like OpenRouter, so leave empty
+        result.generation_id = "";
+        result.input_tokens = fields.prompt_tokens;
+        result.output_tokens = fields.completion_tokens;
+        result.cached_tokens = fields.cached_tokens;
         return result;
     } catch (const nlohmann::json::exception& e) {
         std::cerr << "JSON parsing error in commit message generation: " << e.what() << std::endl;
@@ -80,27 +95,25 @@ GenerationResult ZenBackend::handle_chat_response(const std::string& response, c
 }
 
 std::vector<Model> ZenBackend::get_available_models() {
-    CurlRequest req;
+    return get_available_models_async().get();
+}
 
-    std::string url = "https://opencode.ai/zen/v1/models";
+std::future<std::vector<Model>> ZenBackend::get_available_models_async() {
+    auto req = std::make_unique<CurlRequest>();
+
+    std::string url = base_url + "/models";
     if (api_key.empty()) {
         throw std::runtime_error("API key not set");
     }
 
-    req.set_url(url);
-    req.set_get_method();
-    req.add_header("Authorization: Bearer " + api_key);
-
-    std::string response;
-    req.set_write_callback(WriteCallback, &response);
+    req->set_get_method();
+    req->add_header("Authorization: Bearer " + api_key);
 
-    CURLcode res = req.perform();
-    if (res != CURLE_OK) {
-        std::cerr << "Failed to fetch URL: " << url << ", libcurl error: " << curl_easy_strerror(res) << std::endl;
-        throw std::runtime_error("Curl error: " + std::string(curl_easy_strerror(res)));
-    }
+    return fetch_async<std::vector<Model>>(std::move(req), url, parse_models_response);
+}
 
-    return parse_models_response(response);
+void ZenBackend::warm_up() {
+    HttpExecutor::instance().preconnect(base_url);
 }
 
 std::string ZenBackend::get_balance() {
@@ -110,20 +123,20 @@ std::string ZenBackend::get_balance() {
 std::vector<Model> ZenBackend::parse_models_response(const std::string& response) {
     std::vector<Model> models;
     try {
-        nlohmann::json j = nlohmann::json::parse(response);
-        if (j.contains("error")) {
-            handle_api_error(response, j["error"]["message"]);
+        ModelCatalog catalog = parse_model_catalog(response);
+        if (catalog.has_error) {
+            handle_api_error(response, catalog.error_message);
         }
-        if (!j.contains("data") || !j["data"].is_array()) {
+        if (!catalog.has_data) {
             handle_api_error(response, "Expected JSON object with 'data' array");
         }
-        for (const auto& model_json : j["data"]) {
-            if (!model_json.is_object()) continue;
-            std::string id = model_json.at("id");
-            std::string name = model_json.value("name", id);
-            std::string pricing = model_json.value("pricing", get_pricing_for_model(id));
-            std::string description = model_json.value("description", "Model for coding agents.");
-            models.push_back({id, name, pricing, description});
+        models.reserve(catalog.models.size());
+        for (auto& entry : catalog.models) {
+            if (entry.id.empty()) continue;
+            std::string name = entry.name.empty() ? entry.id : std::move(entry.name);
+            std::string pricing = entry.pricing.empty() ? get_pricing_for_model(entry.id) : std::move(entry.pricing);
+            std::string description = entry.description.empty() ? "Model for coding agents." : std::move(entry.description);
+            models.push_back({std::move(entry.id), std::move(name), std::move(pricing), std::move(description)});
         }
     } catch (const nlohmann::json::exception& e) {
         handle_api_error(response, "JSON parsing error: " + std::string(e.what()));
@@ -160,34 +173,23 @@ std::string ZenBackend::get_pricing_for_model(const std::string& id) {
 
 std::string ZenBackend::get_endpoint_for_model(const std::string& model) {
     if (model.find("claude-") == 0) {
-        return "https://opencode.ai/zen/v1/messages";
+        return base_url + "/messages";
     } else if (model.find("gemini-") == 0) {
-        return "https://opencode.ai/zen/v1/models/" + model;
+        return base_url + "/models/" + model;
     } else {
         // Default to OpenAI compatible
-        return "https://opencode.ai/zen/v1/chat/completions";
+        return base_url + "/chat/completions";
     }
 }
 
-nlohmann::json ZenBackend::build_payload_for_model(const std::string& model, const std::string& instructions, const std::string& diff) {
+std::string ZenBackend::build_payload_for_model(const std::string& model, const std::string& instructions, const std::string& diff) {
+    nlohmann::json fields = {
+        {"model", model}
+    };
     if (model.find("claude-") == 0) {
         // Anthropic format
-        return {
-            {"model", model},
-            {"messages", {{
-                {"role", "user"},
-                {"content", instructions + "\n\nDiff:\n" + diff}
-            }}},
-            {"max_tokens", 1000}
-        };
-    } else {
-        // OpenAI format
-        return {
-            {"model", model},
-            {"messages", {{
-                {"role", "user"},
-                {"content", instructions + "\n\nDiff:\n" + diff}
-            }}}
-        };
+        fields["max_tokens"] = 1000;
     }
+    // OpenAI format needs nothing beyond the model and messages
+    return build_chat_payload(fields, instructions, diff);
 }
\ No newline at end of file
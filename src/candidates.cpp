@@ -0,0 +1,92 @@
+#include "candidates.hpp"
+#include <future>
+#include <iostream>
+#include <stdexcept>
+#include <unistd.h>
+#include "colors.hpp"
+#include "commit_message.hpp"
+
+std::vector<GenerationResult> generate_candidates(LLMBackend& llm, const std::string& diff, const std::string& instructions, const std::string& model, const std::string& provider, double temperature, size_t n) {
+    std::vector<GenerationResult> results;
+    if (llm.supports_choices()) {
+        results = llm.generate_choices_async(diff, instructions, model, provider, temperature, n).get();
+    }
+
+    // Providers that ignore `n` return a single choice; top up with separate requests
+    std::vector<std::future<GenerationResult>> extra;
+    for (size_t i = results.size(); i < n; ++i) {
+        extra.push_back(llm.generate_commit_message_async(diff, instructions, model, provider, temperature));
+    }
+    std::exception_ptr failure;
+    for (auto& future : extra) {
+        try {
+            results.push_back(future.get());
+        } catch (const std::exception& e) {
+            failure = std::current_exception();
+            std::cerr << Colors::YELLOW << "Candidate request failed: " << e.what() << Colors::RESET << std::endl;
+        }
+    }
+    if (results.empty() && failure) {
+        std::rethrow_exception(failure);
+    }
+
+    std::vector<GenerationResult> unique;
+    std::vector<std::string> seen;
+    for (auto& result : results) {
+        std::string message = clean_commit_message(result.content);
+        bool duplicate = false;
+        for (const auto& s : seen) {
+            duplicate = duplicate || s == message;
+        }
+        if (message.empty() || duplicate) {
+            // A result billed on its own stays in the list for the stats log
+            if (!result.shared_request) {
+                result.content.clear();
+                unique.push_back(std::move(result));
+            }
+            continue;
+        }
+        seen.push_back(std::move(message));
+        unique.push_back(std::move(result));
+    }
+    return unique;
+}
+
+std::optional<size_t> select_candidate(const std::vector<GenerationResult>& candidates) {
+    std::vector<size_t> choices;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (!candidates[i].content.empty()) {
+            choices.push_back(i);
+        }
+    }
+    if (choices.empty()) {
+        throw std::runtime_error("No usable commit message candidates");
+    }
+    if (choices.size() == 1 || !isatty(STDIN_FILENO)) {
+        return choices.front();
+    }
+
+    std::cout << std::endl;
+    for (size_t i = 0; i < choices.size(); ++i) {
+        std::cout << Colors::GREEN << "[" << (i + 1) << "]" << Colors::RESET << " " << clean_commit_message(candidates[choices[i]].content) << std::endl << std::endl;
+    }
+    while (true) {
+        std::cout << "Select a message [1-" << choices.size() << ", q to quit] (1): " << std::flush;
+        std::string line;
+        if (!std::getline(std::cin, line) || line == "q" || line == "Q") {
+            return std::nullopt;
+        }
+        if (line.empty()) {
+            return choices.front();
+        }
+        try {
+            size_t pick = std::stoul(line);
+            if (pick >= 1 && pick <= choices.size()) {
+                return choices[pick - 1];
+            }
+        } catch (const std::exception&) {
+            // Fall through and ask again
+        }
+        std::cout << Colors::YELLOW << "Enter a number between 1 and " << choices.size() << Colors::RESET << std::endl;
+    }
+}
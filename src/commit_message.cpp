@@ -0,0 +1,19 @@
+#include "commit_message.hpp"
+#include <algorithm>
+#include <cctype>
+
+std::string clean_commit_message(const std::string& msg) {
+    std::string cleaned = msg;
+    // Remove surrounding ```
+    if (cleaned.size() >= 6 && cleaned.substr(0, 3) == "```" && cleaned.substr(cleaned.size() - 3) == "```") {
+        cleaned = cleaned.substr(3, cleaned.size() - 6);
+    }
+    // Remove "diff" at start and end if present
+    if (cleaned.size() >= 8 && cleaned.substr(0, 4) == "diff" && cleaned.substr(cleaned.size() - 4) == "diff") {
+        cleaned = cleaned.substr(4, cleaned.size() - 8);
+    }
+    // Trim whitespace
+    cleaned.erase(cleaned.begin(), std::find_if(cleaned.begin(), cleaned.end(), [](unsigned char ch) { return !std::isspace(ch); }));
+    cleaned.erase(std::find_if(cleaned.rbegin(), cleaned.rend(), [](unsigned char ch) { return !std::isspace(ch); }).base(), cleaned.end());
+    return cleaned;
+}
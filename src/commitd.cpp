@@ -0,0 +1,295 @@
+// commitd keeps LLM backends alive between runs of `commit`, which talks to it over a Unix
+// socket (see daemon_protocol.hpp). The daemon holds each backend's pooled HTTP/2
+// connections, a cache of the model catalog, and the responses of preview runs. Start it once
+// per session, e.g. from a systemd user unit; `commit` runs the backend in-process whenever no
+// daemon is listening.
+#include <CLI/CLI.hpp>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "backend_registry.hpp"
+#include "daemon_protocol.hpp"
+
+namespace {
+
+constexpr auto CATALOG_TTL = std::chrono::minutes(10);
+constexpr size_t MAX_PREVIEWS = 64;
+// A client sends its request as soon as it connects and reads the reply as soon as it is sent;
+// one that stalls either way is dropped rather than holding its thread
+constexpr timeval CLIENT_IO_TIMEOUT{1, 0};
+// How long shutdown waits for requests in flight, e.g. a generation that never returns
+constexpr auto DRAIN_TIMEOUT = std::chrono::seconds(30);
+
+std::atomic<bool> stopping{false};
+
+class Daemon {
+public:
+    // Answers one request; failures are returned as {"error": ...}
+    nlohmann::json handle(const nlohmann::json& request) {
+        try {
+            std::string op = request.at("op");
+            if (op == "ping") {
+                return {{"result", "pong"}};
+            }
+            std::string key = backend_key(request);
+            LLMBackend& backend = backend_for(request, key);
+            if (op == "generate") {
+                return {{"result", result_to_json(generate(backend, key, request))}};
+            }
+            if (op == "choices") {
+                std::vector<GenerationResult> results = backend.generate_choices_async(
+                    request.at("diff"), request.at("instructions"), request.at("model"), request.value("provider", ""),
+                    request.value("temperature", -1.0), request.value("n", size_t{1})).get();
+                nlohmann::json list = nlohmann::json::array();
+                for (const auto& result : results) {
+                    list.push_back(result_to_json(result));
+                }
+                return {{"result", list}};
+            }
+            if (op == "models") {
+                return {{"result", models_to_json(catalog(backend, key))}};
+            }
+            if (op == "balance") {
+                return {{"result", backend.get_balance()}};
+            }
+            if (op == "warm_up") {
+                backend.warm_up();
+                return {{"result", true}};
+            }
+            return {{"error", "commitd: unknown request " + op}};
+        } catch (const std::exception& e) {
+            return {{"error", e.what()}};
+        }
+    }
+
+private:
+    struct CachedCatalog {
+        std::chrono::steady_clock::time_point fetched;
+        std::vector<Model> models;
+    };
+
+    std::mutex mutex_;
+    std::map<std::string, std::unique_ptr<LLMBackend>> backends_;
+    std::map<std::string, CachedCatalog> catalogs_;
+    std::list<std::pair<size_t, GenerationResult>> previews_;  // Most recent first
+
+    static std::string backend_key(const nlohmann::json& request) {
+        return request.value("backend", "") + '\n' + request.value("base_url", "") + '\n' + request.value("api_key", "");
+    }
+
+    // Backends live as long as the daemon; their requests share the process's HttpExecutor
+    LLMBackend& backend_for(const nlohmann::json& request, const std::string& key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = backends_.find(key);
+        if (it != backends_.end()) return *it->second;
+        const BackendInfo& info = BackendRegistry::instance().get(request.value("backend", ""));
+        std::unique_ptr<LLMBackend> backend = info.create();
+        backend->set_api_key(request.value("api_key", ""));
+        std::string base_url = request.value("base_url", "");
+        if (!base_url.empty()) {
+            backend->set_base_url(base_url);
+        }
+        return *backends_.emplace(key, std::move(backend)).first->second;
+    }
+
+    // A preview's message is kept so that committing the same diff right after it reuses the
+    // message the user just saw. The reused result is marked shared_request because the
+    // preview run already logged its cost.
+    GenerationResult generate(LLMBackend& backend, const std::string& key, const nlohmann::json& request) {
+        std::string diff = request.at("diff");
+        std::string instructions = request.at("instructions");
+        std::string model = request.at("model");
+        std::string provider = request.value("provider", "");
+        double temperature = request.value("temperature", -1.0);
+        bool preview = request.value("preview", false);
+        size_t id = std::hash<std::string>{}(key + '\n' + model + '\n' + provider + '\n' + std::to_string(temperature) + '\n' + instructions + '\n' + diff);
+
+        if (!preview) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto it = previews_.begin(); it != previews_.end(); ++it) {
+                if (it->first != id) continue;
+                GenerationResult result = std::move(it->second);
+                previews_.erase(it);
+                result.shared_request = true;
+                result.http = HttpTiming();
+                return result;
+            }
+        }
+
+        GenerationResult result = backend.generate_commit_message(diff, instructions, model, provider, temperature);
+        if (preview) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::erase_if(previews_, [id](const auto& entry) { return entry.first == id; });
+            previews_.emplace_front(id, result);
+            if (previews_.size() > MAX_PREVIEWS) {
+                previews_.pop_back();
+            }
+        }
+        return result;
+    }
+
+    std::vector<Model> catalog(LLMBackend& backend, const std::string& key) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = catalogs_.find(key);
+            if (it != catalogs_.end() && std::chrono::steady_clock::now() - it->second.fetched < CATALOG_TTL) {
+                return it->second.models;
+            }
+        }
+        std::vector<Model> models = backend.get_available_models();
+        std::lock_guard<std::mutex> lock(mutex_);
+        catalogs_[key] = {std::chrono::steady_clock::now(), models};
+        return models;
+    }
+};
+
+// Connections being served, so that main() can wait for them before the process's statics
+// (the backend registry and the HTTP executor) are destroyed
+class ActiveConnections {
+public:
+    void opened() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        active_++;
+    }
+    void closed() {
+        // Notified under the lock, so the waiter cannot return while this thread still uses it
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--active_ == 0) idle_.notify_all();
+    }
+    // False if connections were still open after `limit`
+    bool wait_idle(std::chrono::steady_clock::duration limit) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return idle_.wait_for(lock, limit, [this] { return active_ == 0; });
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable idle_;
+    size_t active_ = 0;
+};
+
+void serve_connection(Daemon& daemon, int fd) {
+    if (!peer_is_same_user(fd)) {
+        std::cerr << "commitd: refused a connection from another user" << std::endl;
+        ::close(fd);
+        return;
+    }
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &CLIENT_IO_TIMEOUT, sizeof(CLIENT_IO_TIMEOUT));
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &CLIENT_IO_TIMEOUT, sizeof(CLIENT_IO_TIMEOUT));
+    try {
+        nlohmann::json request = receive_message(fd);
+        send_message(fd, daemon.handle(request));
+    } catch (const std::exception& e) {
+        std::cerr << "commitd: " << e.what() << std::endl;
+    }
+    ::close(fd);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    CLI::App app{"commitd - keeps LLM backends and their connections warm for commit"};
+    std::string socket_path = daemon_socket_path();
+    app.add_option("--socket", socket_path, "Unix socket to listen on (default: $XDG_RUNTIME_DIR/commit/commitd.sock)");
+    CLI11_PARSE(app, argc, argv);
+
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, [](int) { stopping = true; });
+    std::signal(SIGTERM, [](int) { stopping = true; });
+
+    if (ping_daemon(socket_path)) {
+        std::cerr << "Error: commitd is already running at " << socket_path << std::endl;
+        return 1;
+    }
+
+    sockaddr_un addr{};
+    if (socket_path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Error: socket path too long: " << socket_path << std::endl;
+        return 1;
+    }
+    std::filesystem::path dir = std::filesystem::path(socket_path).parent_path();
+    if (!dir.empty()) {
+        std::error_code ec;
+        std::filesystem::create_directories(dir, ec);
+        if (ec) {
+            std::cerr << "Error: cannot create " << dir.string() << ": " << ec.message() << std::endl;
+            return 1;
+        }
+        struct stat st;
+        if (::lstat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode) || st.st_uid != ::getuid()) {
+            std::cerr << "Error: " << dir.string() << " is not a directory owned by this user" << std::endl;
+            return 1;
+        }
+        // Never tighten a shared directory such as /tmp; it is the wrong place for the socket
+        if ((st.st_mode & (S_IWGRP | S_IWOTH)) != 0) {
+            std::cerr << "Error: " << dir.string() << " is writable by other users; put the socket in a private directory" << std::endl;
+            return 1;
+        }
+        if (::chmod(dir.c_str(), 0700) != 0) {
+            std::cerr << "Error: cannot chmod " << dir.string() << ": " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+    }
+    ::unlink(socket_path.c_str());  // Left behind by a daemon that did not exit cleanly
+
+    int listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0) {
+        std::cerr << "Error: socket() failed: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, socket_path.c_str(), socket_path.size() + 1);
+    // Requests carry API keys, so only the owner may connect
+    mode_t old_mask = ::umask(0077);
+    int bound = ::bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    ::umask(old_mask);
+    if (bound != 0 || ::listen(listener, 128) != 0) {
+        std::cerr << "Error: cannot listen on " << socket_path << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    std::cout << "commitd listening on " << socket_path << std::endl;
+
+    Daemon daemon;
+    ActiveConnections connections;
+    while (!stopping) {
+        pollfd pfd{listener, POLLIN, 0};
+        int ready = ::poll(&pfd, 1, 500);
+        if (ready <= 0) continue;  // Timeout or EINTR; recheck `stopping`
+        int fd = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            std::cerr << "Error: accept() failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        connections.opened();
+        std::thread([&daemon, &connections, fd] {
+            serve_connection(daemon, fd);
+            connections.closed();
+        }).detach();
+    }
+    ::close(listener);
+    ::unlink(socket_path.c_str());
+    // Requests in flight still use the daemon's backends; let them finish first. Threads still
+    // running after the limit would outlive the statics, so leave without destroying them.
+    if (!connections.wait_idle(DRAIN_TIMEOUT)) {
+        std::cerr << "commitd: requests still in flight after " << DRAIN_TIMEOUT.count() << "s; exiting anyway" << std::endl;
+        std::_Exit(1);
+    }
+    return 0;
+}
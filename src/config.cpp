@@ -2,6 +2,8 @@
 #include "default_prompt.hpp"
 #include "git_utils.hpp"
 #include "llm_backend.hpp"
+#include "backend_registry.hpp"
+#include "configure_ui.hpp"
 #include <algorithm>
 #include <cctype>
 #include <fstream>
@@ -10,15 +12,8 @@
 #include <memory>
 #include <filesystem>
 #include <sstream>
-#include <filesystem>
-#include <sstream>
-#include <ftxui/component/component.hpp>
-#include <ftxui/component/screen_interactive.hpp>
-#include <ftxui/component/event.hpp>
-#include <ftxui/dom/elements.hpp>
-#include <sys/ioctl.h>
-#include <unistd.h>
-#include <ftxui/screen/screen.hpp>
+#include <stdexcept>
+#include <dlfcn.h>
 
 std::string trim(const std::string& s) {
     auto start = std::find_if_not(s.begin(), s.end(), [](unsigned char ch) { return std::isspace(ch); });
@@ -61,6 +56,17 @@ Config Config::load_from_file(const std::string& global_path) {
     config.provider = "";
     config.temperature = 0.25;
     config.auto_push = false;
+    config.tokenizer_vocab = "";
+    config.max_input_tokens = 0;
+    config.oversize_action = "refuse";
+    config.auto_latency_slo = 3.0;
+    config.auto_latency_percentile = 90.0;
+    config.concurrency = 8;
+    config.requests_per_minute = 0.0;
+    config.fsync_stats_log = false;
+    config.metrics_path = "";
+    config.watch_quiet_seconds = 2.0;
+    config.watch_budget = 0.25;
 
     // Load global config
     auto global_values = parse_config_file(global_path);
@@ -68,10 +74,25 @@ Config Config::load_from_file(const std::string& global_path) {
     if (global_values.count("model")) config.model = global_values["model"];
     if (global_values.count("openrouter_api_key")) config.openrouter_api_key = global_values["openrouter_api_key"];
     if (global_values.count("zen_api_key")) config.zen_api_key = global_values["zen_api_key"];
+    if (global_values.count("openrouter_base_url")) config.openrouter_base_url = global_values["openrouter_base_url"];
+    if (global_values.count("zen_base_url")) config.zen_base_url = global_values["zen_base_url"];
+    if (global_values.count("local_api_key")) config.local_api_key = global_values["local_api_key"];
+    if (global_values.count("local_base_url")) config.local_base_url = global_values["local_base_url"];
     if (global_values.count("time_run")) config.time_run = (global_values["time_run"] == "true");
     if (global_values.count("provider")) config.provider = global_values["provider"];
     if (global_values.count("temperature")) config.temperature = std::stod(global_values["temperature"]);
     if (global_values.count("auto_push")) config.auto_push = (global_values["auto_push"] == "true");
+    if (global_values.count("tokenizer_vocab")) config.tokenizer_vocab = global_values["tokenizer_vocab"];
+    if (global_values.count("max_input_tokens")) config.max_input_tokens = std::stol(global_values["max_input_tokens"]);
+    if (global_values.count("oversize_action")) config.oversize_action = global_values["oversize_action"];
+    if (global_values.count("auto_latency_slo")) config.auto_latency_slo = std::stod(global_values["auto_latency_slo"]);
+    if (global_values.count("auto_latency_percentile")) config.auto_latency_percentile = std::stod(global_values["auto_latency_percentile"]);
+    if (global_values.count("concurrency")) config.concurrency = std::stoul(global_values["concurrency"]);
+    if (global_values.count("requests_per_minute")) config.requests_per_minute = std::stod(global_values["requests_per_minute"]);
+    if (global_values.count("fsync_stats_log")) config.fsync_stats_log = (global_values["fsync_stats_log"] == "true");
+    if (global_values.count("metrics_path")) config.metrics_path = global_values["metrics_path"];
+    if (global_values.count("watch_quiet_seconds")) config.watch_quiet_seconds = std::stod(global_values["watch_quiet_seconds"]);
+    if (global_values.count("watch_budget")) config.watch_budget = std::stod(global_values["watch_budget"]);
 
     std::string global_prompt_path = std::filesystem::path(global_path).parent_path().string() + "/prompt.txt";
     if (std::filesystem::exists(global_prompt_path)) {
@@ -91,10 +112,25 @@ Config Config::load_from_file(const std::string& global_path) {
         if (local_values.count("model")) config.model = local_values["model"];
         if (local_values.count("openrouter_api_key")) config.openrouter_api_key = local_values["openrouter_api_key"];
         if (local_values.count("zen_api_key")) config.zen_api_key = local_values["zen_api_key"];
+        if (local_values.count("openrouter_base_url")) config.openrouter_base_url = local_values["openrouter_base_url"];
+        if (local_values.count("zen_base_url")) config.zen_base_url = local_values["zen_base_url"];
+        if (local_values.count("local_api_key")) config.local_api_key = local_values["local_api_key"];
+        if (local_values.count("local_base_url")) config.local_base_url = local_values["local_base_url"];
         if (local_values.count("time_run")) config.time_run = (local_values["time_run"] == "true");
         if (local_values.count("provider")) config.provider = local_values["provider"];
         if (local_values.count("temperature")) config.temperature = std::stod(local_values["temperature"]);
         if (local_values.count("auto_push")) config.auto_push = (local_values["auto_push"] == "true");
+        if (local_values.count("tokenizer_vocab")) config.tokenizer_vocab = local_values["tokenizer_vocab"];
+        if (local_values.count("max_input_tokens")) config.max_input_tokens = std::stol(local_values["max_input_tokens"]);
+        if (local_values.count("oversize_action")) config.oversize_action = local_values["oversize_action"];
+        if (local_values.count("auto_latency_slo")) config.auto_latency_slo = std::stod(local_values["auto_latency_slo"]);
+        if (local_values.count("auto_latency_percentile")) config.auto_latency_percentile = std::stod(local_values["auto_latency_percentile"]);
+        if (local_values.count("concurrency")) config.concurrency = std::stoul(local_values["concurrency"]);
+        if (local_values.count("requests_per_minute")) config.requests_per_minute = std::stod(local_values["requests_per_minute"]);
+        if (local_values.count("fsync_stats_log")) config.fsync_stats_log = (local_values["fsync_stats_log"] == "true");
+        if (local_values.count("metrics_path")) config.metrics_path = local_values["metrics_path"];
+        if (local_values.count("watch_quiet_seconds")) config.watch_quiet_seconds = std::stod(local_values["watch_quiet_seconds"]);
+        if (local_values.count("watch_budget")) config.watch_budget = std::stod(local_values["watch_budget"]);
 
         std::string local_prompt_path = repo_root + "/.commit/prompt.txt";
         if (std::filesystem::exists(local_prompt_path)) {
@@ -109,211 +145,27 @@ Config Config::load_from_file(const std::string& global_path) {
 }
 
 void configure_app(const std::string& config_path) {
-    // Query terminal height
-    struct winsize ws;
-    ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws);
-    int terminal_height = ws.ws_row > 0 ? ws.ws_row : 24;
-
-    Config existing = Config::load_from_file(config_path);
-
-    enum class ConfigStep { Backend, ApiKey, Model, Instructions };
-
-    // API key input
-    std::string api_key;
-
-    // Backend selection
-    int backend_index = (existing.backend == "zen") ? 1 : 0;
-    std::vector<std::string> backends = {"openrouter", "zen"};
-
-    // Model selection
-    std::vector<std::string> model_names;
-    std::vector<std::string> model_ids;
-    int model_index = 0;
-
-    // Instructions input
-    std::string instructions = existing.llm_instructions;
-
-    // Fetch models function
-    auto fetch_models = [&]() {
-        std::string backend = backends[backend_index];
-        std::unique_ptr<LLMBackend> llm;
-        if (backend == "openrouter") {
-            llm = std::make_unique<OpenRouterBackend>();
-        } else if (backend == "zen") {
-            llm = std::make_unique<ZenBackend>();
-        } else {
-            return;
-        }
-        llm->set_api_key(api_key);
-        auto models = llm->get_available_models();
-        model_names.clear();
-        model_ids.clear();
-        for (const auto& m : models) {
-            model_names.push_back(m.name + " (" + m.pricing + ")");
-            model_ids.push_back(m.id);
-        }
-        if (!model_names.empty()) {
-            model_index = 0;
-            // Set to existing model if found
-            auto it = std::find(model_ids.begin(), model_ids.end(), existing.model);
-            if (it != model_ids.end()) {
-                model_index = std::distance(model_ids.begin(), it);
-            }
-        }
-    };
-
-    bool done = false;
-
-    auto perform_save = [&]() {
-        Config full_existing = Config::load_from_file(config_path);
-        full_existing.backend = backends[backend_index];
-        if (full_existing.backend == "openrouter") {
-            full_existing.openrouter_api_key = api_key;
-        } else {
-            full_existing.zen_api_key = api_key;
-        }
-        if (!model_ids.empty()) {
-            full_existing.model = model_ids[model_index];
-        }
-        full_existing.llm_instructions = instructions;
-        // Save config
-        std::filesystem::create_directories(std::filesystem::path(config_path).parent_path());
-        // Backup existing config if it exists
-        if (std::filesystem::exists(config_path)) {
-            std::filesystem::copy_file(config_path, config_path + ".bak", std::filesystem::copy_options::overwrite_existing);
-        }
-        std::ofstream file(config_path);
-        file << "# Backend to use for LLM requests (valid values: openrouter, zen)\n";
-        file << "backend=" << full_existing.backend << "\n";
-        file << "# Model ID to use for the selected backend\n";
-        file << "model=" << full_existing.model << "\n";
-        file << "# Provider to use for the model (optional)\n";
-        file << "provider=" << full_existing.provider << "\n";
-        file << "# Temperature for chat generation (0.0-2.0, optional)\n";
-        file << "# temperature=0.7\n";
-        file << "# Delay in milliseconds before querying generation stats (default: 100)\n";
-
-        file << "# Custom instructions for commit message generation\n";
-        file << "instructions=" << full_existing.llm_instructions << "\n";
-        std::string prompt_path = std::filesystem::path(config_path).parent_path().string() + "/prompt.txt";
-        std::ofstream prompt_file(prompt_path);
-        if (prompt_file) {
-            prompt_file << full_existing.llm_instructions;
-        }
-        if (!full_existing.openrouter_api_key.empty()) {
-            file << "# API key for OpenRouter backend\n";
-            file << "openrouter_api_key=" << full_existing.openrouter_api_key << "\n";
-        }
-        if (!full_existing.zen_api_key.empty()) {
-            file << "# API key for Zen backend\n";
-            file << "zen_api_key=" << full_existing.zen_api_key << "\n";
-        }
-        done = true;
-    };
-
-    ftxui::MenuOption backend_option;
-    auto backend_menu = ftxui::Menu(&backends, &backend_index, backend_option);
-
-    ftxui::MenuOption model_option;
-    auto model_menu = ftxui::Menu(&model_names, &model_index, model_option);
-
-    ftxui::InputOption instructions_option;
-    auto instructions_input = ftxui::Input(&instructions, "LLM Instructions", instructions_option);
-
-    // First FTXUI screen: Backend selection
-    auto screen1 = ftxui::ScreenInteractive::TerminalOutput();
-    bool backend_selected = false;
-
-    auto layout1 = ftxui::Renderer(backend_menu, [&] { return ftxui::vbox(ftxui::text("Select Backend:"), backend_menu->Render()); });
-
-    auto renderer1 = ftxui::Renderer(layout1, [&] {
-        return ftxui::vbox(
-            ftxui::text("Configuration Setup") | ftxui::bold,
-            ftxui::text("Step 1/4: Select Backend") | ftxui::dim,
-            ftxui::separator(),
-            layout1->Render() | ftxui::flex,
-            ftxui::separator(),
-            ftxui::text("Press Enter to select, Esc to cancel")
-        ) | ftxui::border | ftxui::size(ftxui::HEIGHT, ftxui::LESS_THAN, terminal_height);
-    });
-
-    auto event_handler1 = ftxui::CatchEvent(renderer1, [&](ftxui::Event event) {
-        if (event == ftxui::Event::Return) {
-            backend_selected = true;
-            screen1.ExitLoopClosure()();
-        } else if (event == ftxui::Event::Escape) {
-            done = true;
-            screen1.ExitLoopClosure()();
-        }
-        return false;
-    });
-
-    backend_menu->TakeFocus();
-    screen1.Loop(event_handler1);
-
-    if (!backend_selected || done) return;
-
-    // API key input with colorized prompt
-    std::cout << "\033[1;32mEnter API Key: \033[0m";
-    std::getline(std::cin, api_key);
-    api_key = trim(api_key);
-
-    // Second FTXUI screen: Model and Instructions
-    ConfigStep current_step = ConfigStep::Model;
-    fetch_models();
-
-    auto screen2 = ftxui::ScreenInteractive::TerminalOutput();
-
-    // Layout for second screen
-    auto layout2 = ftxui::Container::Vertical(std::vector<ftxui::Component>{
-        ftxui::Renderer(model_menu, [&] {
-            if (current_step != ConfigStep::Model) return ftxui::text("");
-            std::string selected_info = model_names.empty() ? "No models loaded" : "Selected: " + model_names[model_index];
-            return ftxui::vbox(
-                ftxui::text(selected_info) | ftxui::bold,
-                ftxui::text("Select Model:"),
-                ftxui::frame(model_menu->Render()) | ftxui::size(ftxui::HEIGHT, ftxui::LESS_THAN, terminal_height - 10)
-            );
-        }),
-        ftxui::Renderer(instructions_input, [&] { return current_step == ConfigStep::Instructions ? ftxui::vbox(ftxui::text("LLM Instructions:"), instructions_input->Render()) : ftxui::text(""); }),
-    });
-
-    auto renderer2 = ftxui::Renderer(layout2, [&] {
-        std::string step_title;
-        if (current_step == ConfigStep::Model) step_title = "Step 3/4: Select Model";
-        else if (current_step == ConfigStep::Instructions) step_title = "Step 4/4: Edit Instructions";
-        return ftxui::vbox(
-            ftxui::text("Configuration Setup") | ftxui::bold,
-            ftxui::text(step_title) | ftxui::dim,
-            ftxui::separator(),
-            layout2->Render() | ftxui::flex,
-            ftxui::separator(),
-            ftxui::text("Press Enter to advance, Esc to cancel")
-        ) | ftxui::border | ftxui::size(ftxui::HEIGHT, ftxui::LESS_THAN, terminal_height);
-    });
-
-    auto event_handler2 = ftxui::CatchEvent(renderer2, [&](ftxui::Event event) {
-        if (event == ftxui::Event::Return) {
-            if (current_step == ConfigStep::Model) {
-                current_step = ConfigStep::Instructions;
-                instructions_input->TakeFocus();
-            } else if (current_step == ConfigStep::Instructions) {
-                perform_save();
-                screen2.ExitLoopClosure()();
-            }
-        } else if (event == ftxui::Event::Escape) {
-            done = true;
-            screen2.ExitLoopClosure()();
-        } else if (event.is_mouse()) {
-            return true;
-        }
-        return (event == ftxui::Event::Return || event == ftxui::Event::Escape);
-    });
-
-    model_menu->TakeFocus();
-    screen2.Loop(event_handler2);
-
-    if (done) {
-        std::cout << "Configuration saved to " << config_path << std::endl;
+    // Next to the executable in the build tree, in ../lib/commit once installed
+    std::filesystem::path exe_dir = std::filesystem::read_symlink("/proc/self/exe").parent_path();
+    std::filesystem::path module_path = exe_dir / "commit_configure.so";
+    if (!std::filesystem::exists(module_path)) {
+        module_path = exe_dir.parent_path() / "lib" / "commit" / "commit_configure.so";
+    }
+    void* module = dlopen(module_path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!module) {
+        throw std::runtime_error(std::string("Cannot load the configuration UI: ") + dlerror());
+    }
+    auto configure_ui = reinterpret_cast<ConfigureUiEntry>(dlsym(module, CONFIGURE_UI_ENTRY));
+    if (!configure_ui) {
+        throw std::runtime_error(std::string("Invalid configuration UI module: ") + dlerror());
     }
-}
\ No newline at end of file
+    ConfigureHost host;
+    host.load_config = &Config::load_from_file;
+    host.backend_names = [] { return BackendRegistry::instance().names(); };
+    host.backend = [](const std::string& name) -> const BackendInfo& { return BackendRegistry::instance().get(name); };
+    host.trim = &trim;
+    // The module stays loaded: FTXUI's static objects are destroyed at exit
+    if (!configure_ui(config_path.c_str(), &host)) {
+        throw std::runtime_error("The configuration UI module at " + module_path.string() + " is from another version of commit");
+    }
+}
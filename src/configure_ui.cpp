@@ -0,0 +1,245 @@
+#include "configure_ui.hpp"
+#include "llm_backend.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <ftxui/component/component.hpp>
+#include <ftxui/component/screen_interactive.hpp>
+#include <ftxui/component/event.hpp>
+#include <ftxui/dom/elements.hpp>
+#include <ftxui/screen/screen.hpp>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+// Loaded with dlopen() by configure_app(), so that FTXUI is only paged in for --configure and
+// first-run setup. Config loading, the backend registry and the backends come from the
+// executable through `host`.
+extern "C" __attribute__((visibility("default"))) bool commit_configure_ui(const char* config_path_arg, const ConfigureHost* host) {
+    if (!host || host->version != ConfigureHost::VERSION) return false;
+    const std::string config_path = config_path_arg;
+
+    // Query terminal height
+    struct winsize ws;
+    ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws);
+    int terminal_height = ws.ws_row > 0 ? ws.ws_row : 24;
+
+    Config existing = host->load_config(config_path);
+
+    enum class ConfigStep { Backend, ApiKey, Model, Instructions };
+
+    // API key input
+    std::string api_key;
+
+    // Backend selection
+    std::vector<std::string> backends = host->backend_names();
+    auto existing_backend = std::find(backends.begin(), backends.end(), existing.backend);
+    int backend_index = existing_backend == backends.end() ? 0 : static_cast<int>(std::distance(backends.begin(), existing_backend));
+
+    // Model selection
+    std::vector<std::string> model_names;
+    std::vector<std::string> model_ids;
+    int model_index = 0;
+
+    // Instructions input
+    std::string instructions = existing.llm_instructions;
+
+    // Fetch models function
+    auto fetch_models = [&]() {
+        const BackendInfo& info = host->backend(backends[backend_index]);
+        std::unique_ptr<LLMBackend> llm = info.create();
+        llm->set_api_key(api_key);
+        const std::string& base_url = existing.*info.base_url_field;
+        if (!base_url.empty()) {
+            llm->set_base_url(base_url);
+        }
+        auto models = llm->get_available_models();
+        model_names.clear();
+        model_ids.clear();
+        for (const auto& m : models) {
+            model_names.push_back(m.name + " (" + m.pricing + ")");
+            model_ids.push_back(m.id);
+        }
+        if (!model_names.empty()) {
+            model_index = 0;
+            // Set to existing model if found
+            auto it = std::find(model_ids.begin(), model_ids.end(), existing.model);
+            if (it != model_ids.end()) {
+                model_index = std::distance(model_ids.begin(), it);
+            }
+        }
+    };
+
+    bool done = false;
+
+    auto perform_save = [&]() {
+        const std::string& backend = backends[backend_index];
+        std::string backend_list;
+        for (const auto& name : backends) {
+            backend_list += (backend_list.empty() ? "" : ", ") + name;
+        }
+        // The keys this UI edits. Every other line of an existing config, including settings
+        // the UI does not know about, is kept as it is.
+        struct Setting {
+            std::string key;
+            std::string value;
+            std::string comment;  // Written above keys that are not in the file yet
+            bool written = false;
+        };
+        std::vector<Setting> settings = {
+            {"backend", backend, "Backend to use for LLM requests (valid values: " + backend_list + ")"},
+            {backend + "_api_key", api_key, "API key for the " + backend + " backend"},  // Key name used by config.cpp
+            {"instructions", instructions, "Custom instructions for commit message generation"},
+        };
+        if (!model_ids.empty()) {
+            settings.push_back({"model", model_ids[model_index], "Model ID to use for the selected backend"});
+        }
+
+        std::filesystem::create_directories(std::filesystem::path(config_path).parent_path());
+        std::vector<std::string> lines;
+        // Backup existing config if it exists
+        if (std::filesystem::exists(config_path)) {
+            std::filesystem::copy_file(config_path, config_path + ".bak", std::filesystem::copy_options::overwrite_existing);
+            std::ifstream in(config_path);
+            for (std::string line; std::getline(in, line);) {
+                lines.push_back(line);
+            }
+        }
+        // Same syntax as parse_config_file(); every occurrence is replaced, since the last one wins
+        for (std::string& line : lines) {
+            std::string trimmed = host->trim(line);
+            size_t eq = trimmed.find('=');
+            if (trimmed.empty() || trimmed[0] == '#' || eq == std::string::npos) continue;
+            std::string key = trimmed.substr(0, eq);
+            for (Setting& setting : settings) {
+                if (setting.key != key) continue;
+                line = key + "=" + setting.value;
+                setting.written = true;
+            }
+        }
+        for (const Setting& setting : settings) {
+            if (setting.written || setting.value.empty()) continue;
+            lines.push_back("# " + setting.comment);
+            lines.push_back(setting.key + "=" + setting.value);
+        }
+
+        std::ofstream file(config_path);
+        for (const std::string& line : lines) {
+            file << line << "\n";
+        }
+        std::string prompt_path = std::filesystem::path(config_path).parent_path().string() + "/prompt.txt";
+        std::ofstream prompt_file(prompt_path);
+        if (prompt_file) {
+            prompt_file << instructions;
+        }
+        done = true;
+    };
+
+    ftxui::MenuOption backend_option;
+    auto backend_menu = ftxui::Menu(&backends, &backend_index, backend_option);
+
+    ftxui::MenuOption model_option;
+    auto model_menu = ftxui::Menu(&model_names, &model_index, model_option);
+
+    ftxui::InputOption instructions_option;
+    auto instructions_input = ftxui::Input(&instructions, "LLM Instructions", instructions_option);
+
+    // First FTXUI screen: Backend selection
+    auto screen1 = ftxui::ScreenInteractive::TerminalOutput();
+    bool backend_selected = false;
+
+    auto layout1 = ftxui::Renderer(backend_menu, [&] { return ftxui::vbox(ftxui::text("Select Backend:"), backend_menu->Render()); });
+
+    auto renderer1 = ftxui::Renderer(layout1, [&] {
+        return ftxui::vbox(
+            ftxui::text("Configuration Setup") | ftxui::bold,
+            ftxui::text("Step 1/4: Select Backend") | ftxui::dim,
+            ftxui::separator(),
+            layout1->Render() | ftxui::flex,
+            ftxui::separator(),
+            ftxui::text("Press Enter to select, Esc to cancel")
+        ) | ftxui::border | ftxui::size(ftxui::HEIGHT, ftxui::LESS_THAN, terminal_height);
+    });
+
+    auto event_handler1 = ftxui::CatchEvent(renderer1, [&](ftxui::Event event) {
+        if (event == ftxui::Event::Return) {
+            backend_selected = true;
+            screen1.ExitLoopClosure()();
+        } else if (event == ftxui::Event::Escape) {
+            done = true;
+            screen1.ExitLoopClosure()();
+        }
+        return false;
+    });
+
+    backend_menu->TakeFocus();
+    screen1.Loop(event_handler1);
+
+    if (!backend_selected || done) return true;
+
+    // API key input with colorized prompt
+    std::cout << "\033[1;32mEnter API Key: \033[0m";
+    std::getline(std::cin, api_key);
+    api_key = host->trim(api_key);
+
+    // Second FTXUI screen: Model and Instructions
+    ConfigStep current_step = ConfigStep::Model;
+    fetch_models();
+
+    auto screen2 = ftxui::ScreenInteractive::TerminalOutput();
+
+    // Layout for second screen
+    auto layout2 = ftxui::Container::Vertical(std::vector<ftxui::Component>{
+        ftxui::Renderer(model_menu, [&] {
+            if (current_step != ConfigStep::Model) return ftxui::text("");
+            std::string selected_info = model_names.empty() ? "No models loaded" : "Selected: " + model_names[model_index];
+            return ftxui::vbox(
+                ftxui::text(selected_info) | ftxui::bold,
+                ftxui::text("Select Model:"),
+                ftxui::frame(model_menu->Render()) | ftxui::size(ftxui::HEIGHT, ftxui::LESS_THAN, terminal_height - 10)
+            );
+        }),
+        ftxui::Renderer(instructions_input, [&] { return current_step == ConfigStep::Instructions ? ftxui::vbox(ftxui::text("LLM Instructions:"), instructions_input->Render()) : ftxui::text(""); }),
+    });
+
+    auto renderer2 = ftxui::Renderer(layout2, [&] {
+        std::string step_title;
+        if (current_step == ConfigStep::Model) step_title = "Step 3/4: Select Model";
+        else if (current_step == ConfigStep::Instructions) step_title = "Step 4/4: Edit Instructions";
+        return ftxui::vbox(
+            ftxui::text("Configuration Setup") | ftxui::bold,
+            ftxui::text(step_title) | ftxui::dim,
+            ftxui::separator(),
+            layout2->Render() | ftxui::flex,
+            ftxui::separator(),
+            ftxui::text("Press Enter to advance, Esc to cancel")
+        ) | ftxui::border | ftxui::size(ftxui::HEIGHT, ftxui::LESS_THAN, terminal_height);
+    });
+
+    auto event_handler2 = ftxui::CatchEvent(renderer2, [&](ftxui::Event event) {
+        if (event == ftxui::Event::Return) {
+            if (current_step == ConfigStep::Model) {
+                current_step = ConfigStep::Instructions;
+                instructions_input->TakeFocus();
+            } else if (current_step == ConfigStep::Instructions) {
+                perform_save();
+                screen2.ExitLoopClosure()();
+            }
+        } else if (event == ftxui::Event::Escape) {
+            done = true;
+            screen2.ExitLoopClosure()();
+        } else if (event.is_mouse()) {
+            return true;
+        }
+        return (event == ftxui::Event::Return || event == ftxui::Event::Escape);
+    });
+
+    model_menu->TakeFocus();
+    screen2.Loop(event_handler2);
+
+    if (done) {
+        std::cout << "Configuration saved to " << config_path << std::endl;
+    }
+    return true;
+}
@@ -0,0 +1,193 @@
+#include "daemon_protocol.hpp"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <filesystem>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+// Generous for a diff, but bounds what a misbehaving peer can make the other side buffer
+constexpr size_t MAX_MESSAGE_BYTES = 256 * 1024 * 1024;
+
+} // namespace
+
+std::string daemon_socket_path() {
+    const char* socket = std::getenv("COMMITD_SOCKET");
+    if (socket && std::strlen(socket) > 0) {
+        return socket;
+    }
+    const char* runtime = std::getenv("XDG_RUNTIME_DIR");
+    if (runtime && std::strlen(runtime) > 0) {
+        return std::string(runtime) + "/commit/commitd.sock";
+    }
+    return "/tmp/commit-" + std::to_string(::getuid()) + "/commitd.sock";
+}
+
+std::string socket_dir_problem(const std::string& socket_path) {
+    std::string dir = std::filesystem::path(socket_path).parent_path().string();
+    if (dir.empty()) dir = ".";
+    struct stat st;
+    if (::lstat(dir.c_str(), &st) != 0) {
+        return "cannot stat " + dir + ": " + std::strerror(errno);
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        return dir + " is not a directory";
+    }
+    if (st.st_uid != ::getuid()) {
+        return dir + " is owned by uid " + std::to_string(st.st_uid) + ", not " + std::to_string(::getuid());
+    }
+    if ((st.st_mode & 07777) != 0700) {
+        return dir + " must have mode 0700";
+    }
+    return "";
+}
+
+bool peer_is_same_user(int fd) {
+    ucred cred{};
+    socklen_t length = sizeof(cred);
+    if (::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &length) != 0 || length != sizeof(cred)) {
+        return false;
+    }
+    return cred.uid == ::getuid();
+}
+
+int connect_daemon(const std::string& path) {
+    sockaddr_un addr{};
+    if (path.size() >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+    // Anyone may create /tmp/commit-<uid> first and answer in the daemon's place
+    if (!socket_dir_problem(path).empty()) {
+        return -1;
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || !peer_is_same_user(fd)) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool ping_daemon(const std::string& path) {
+    int fd = connect_daemon(path);
+    if (fd < 0) {
+        return false;
+    }
+    // A daemon that is alive answers at once; do not let a wedged one hang every run
+    timeval timeout{1, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    bool alive = false;
+    try {
+        send_message(fd, {{"op", "ping"}});
+        alive = receive_message(fd).value("result", "") == "pong";
+    } catch (const std::exception&) {
+        alive = false;
+    }
+    ::close(fd);
+    return alive;
+}
+
+void send_message(int fd, const nlohmann::json& message) {
+    // dump() escapes control characters, so the only newline is the terminator
+    std::string data = message.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+    data += '\n';
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error(std::string("commitd: send failed: ") + std::strerror(errno));
+        }
+        sent += static_cast<size_t>(n);
+    }
+}
+
+nlohmann::json receive_message(int fd) {
+    std::string data;
+    char buffer[65536];
+    while (data.empty() || data.back() != '\n') {
+        ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error(std::string("commitd: receive failed: ") + std::strerror(errno));
+        }
+        if (n == 0) {
+            throw std::runtime_error("commitd: connection closed before a complete message");
+        }
+        data.append(buffer, static_cast<size_t>(n));
+        if (data.size() > MAX_MESSAGE_BYTES) {
+            throw std::runtime_error("commitd: message too large");
+        }
+    }
+    return nlohmann::json::parse(data);
+}
+
+nlohmann::json result_to_json(const GenerationResult& result) {
+    nlohmann::json http = {{"version", result.http.http_version}};
+    for (size_t i = 0; i < std::size(HTTP_TIMING_FIELDS); ++i) {
+        http[HTTP_TIMING_KEYS[i]] = result.http.*HTTP_TIMING_FIELDS[i];
+    }
+    return {
+        {"content", result.content},
+        {"generation_id", result.generation_id},
+        {"input_tokens", result.input_tokens},
+        {"output_tokens", result.output_tokens},
+        {"cached_tokens", result.cached_tokens},
+        {"total_cost", result.total_cost},
+        {"latency", result.latency},
+        {"generation_time", result.generation_time},
+        {"request_time", result.request_time},
+        {"shared_request", result.shared_request},
+        {"http", http}
+    };
+}
+
+GenerationResult result_from_json(const nlohmann::json& j) {
+    GenerationResult result;
+    result.content = j.value("content", "");
+    result.generation_id = j.value("generation_id", "");
+    result.input_tokens = j.value("input_tokens", -1.0);
+    result.output_tokens = j.value("output_tokens", -1.0);
+    result.cached_tokens = j.value("cached_tokens", -1.0);
+    result.total_cost = j.value("total_cost", -1.0);
+    result.latency = j.value("latency", -1.0);
+    result.generation_time = j.value("generation_time", -1.0);
+    result.request_time = j.value("request_time", -1.0);
+    result.shared_request = j.value("shared_request", false);
+    if (j.contains("http") && j["http"].is_object()) {
+        const auto& http = j["http"];
+        for (size_t i = 0; i < std::size(HTTP_TIMING_FIELDS); ++i) {
+            result.http.*HTTP_TIMING_FIELDS[i] = http.value(HTTP_TIMING_KEYS[i], -1.0);
+        }
+        result.http.http_version = http.value("version", "");
+    }
+    return result;
+}
+
+nlohmann::json models_to_json(const std::vector<Model>& models) {
+    nlohmann::json list = nlohmann::json::array();
+    for (const auto& m : models) {
+        list.push_back({{"id", m.id}, {"name", m.name}, {"pricing", m.pricing}, {"description", m.description}});
+    }
+    return list;
+}
+
+std::vector<Model> models_from_json(const nlohmann::json& j) {
+    std::vector<Model> models;
+    for (const auto& m : j) {
+        models.push_back({m.value("id", ""), m.value("name", ""), m.value("pricing", ""), m.value("description", "")});
+    }
+    return models;
+}
@@ -0,0 +1,321 @@
+#include "fleet_stats.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <set>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "colors.hpp"
+#include "hdr_histogram.hpp"
+#include "response_parser.hpp"
+#include "thread_pool.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct StatsLog {
+    std::string repo;
+    std::string path;
+};
+
+struct Totals {
+    long long count = 0;
+    long long dry_run_count = 0;
+    double cost = 0.0;
+    double input_tokens = 0.0;
+    double output_tokens = 0.0;
+
+    void add(const Totals& other) {
+        count += other.count;
+        dry_run_count += other.dry_run_count;
+        cost += other.cost;
+        input_tokens += other.input_tokens;
+        output_tokens += other.output_tokens;
+    }
+};
+
+struct GroupStats {
+    Totals totals;
+    HdrHistogram latency{3600000, 2};  // ms
+};
+
+// Everything one worker has seen; merged into a single instance once all logs are parsed
+struct Aggregate {
+    Totals totals;
+    std::map<std::string, Totals> repos;
+    std::map<std::string, GroupStats> models;
+    std::map<std::string, GroupStats> providers;
+    uintmax_t bytes = 0;
+    long long invalid_lines = 0;
+    std::vector<std::string> unreadable;
+
+    void add(Aggregate&& other) {
+        totals.add(other.totals);
+        for (auto& [name, t] : other.repos) {
+            repos[name].add(t);
+        }
+        for (const auto& groups : {std::pair{&models, &other.models}, std::pair{&providers, &other.providers}}) {
+            for (auto& [name, g] : *groups.second) {
+                auto [it, inserted] = groups.first->try_emplace(name, std::move(g));
+                if (!inserted) {
+                    it->second.totals.add(g.totals);
+                    it->second.latency.add(g.latency);
+                }
+            }
+        }
+        bytes += other.bytes;
+        invalid_lines += other.invalid_lines;
+        unreadable.insert(unreadable.end(), other.unreadable.begin(), other.unreadable.end());
+    }
+};
+
+// Picks the fields the report needs out of one log line without building a DOM
+class StatsLineSax : public PathSax {
+public:
+    std::string date;
+    std::string backend;
+    std::string model;
+    std::string provider;
+    double input_tokens = -1.0;
+    double output_tokens = -1.0;
+    double total_cost = -1.0;
+    double latency = -1.0;
+    double request_time = -1.0;
+    bool dry_run = false;
+
+protected:
+    void on_string(string_t& value) override {
+        if (at({"date"})) date = std::move(value);
+        else if (at({"backend"})) backend = std::move(value);
+        else if (at({"model"})) model = std::move(value);
+        else if (at({"provider"})) provider = std::move(value);
+    }
+
+    void on_number(double value) override {
+        if (at({"input_tokens"})) input_tokens = value;
+        else if (at({"output_tokens"})) output_tokens = value;
+        else if (at({"total_cost"})) total_cost = value;
+        else if (at({"latency"})) latency = value;
+        else if (at({"request_time"})) request_time = value;
+    }
+
+    void on_boolean(bool value) override {
+        if (at({"dry_run"})) dry_run = value;
+    }
+};
+
+std::vector<StatsLog> find_stats_logs(const std::vector<std::string>& roots) {
+    std::vector<StatsLog> logs;
+    std::set<std::string> seen;
+    for (const auto& root : roots) {
+        std::error_code ec;
+        if (!fs::is_directory(root, ec)) {
+            throw std::runtime_error("Not a directory: " + root);
+        }
+        // Symlinks are not followed, so a checkout linked from several places is read once
+        for (fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, ec), end; !ec && it != end; it.increment(ec)) {
+            if (!it->is_directory(ec)) continue;
+            std::string name = it->path().filename().string();
+            if (name == ".git") {
+                it.disable_recursion_pending();
+            } else if (name == ".commit") {
+                it.disable_recursion_pending();
+                fs::path log = it->path() / "generation_stats.log";
+                if (fs::is_regular_file(log, ec) && seen.insert(fs::weakly_canonical(log, ec).string()).second) {
+                    logs.push_back({it->path().parent_path().string(), log.string()});
+                }
+            }
+        }
+        if (ec) {
+            throw std::runtime_error("Failed to scan " + root + ": " + ec.message());
+        }
+    }
+    return logs;
+}
+
+bool in_window(const std::string& date, const StatsQuery& query) {
+    if (!query.since.empty() && date.compare(0, query.since.size(), query.since) < 0) return false;
+    if (!query.until.empty() && date.compare(0, query.until.size(), query.until) > 0) return false;
+    return true;
+}
+
+void add_entry(Aggregate& aggregate, const std::string& repo, const StatsLineSax& entry) {
+    Totals t;
+    t.count = 1;
+    t.dry_run_count = entry.dry_run ? 1 : 0;
+    t.cost = std::max(0.0, entry.total_cost);
+    t.input_tokens = std::max(0.0, entry.input_tokens);
+    t.output_tokens = std::max(0.0, entry.output_tokens);
+    aggregate.totals.add(t);
+    aggregate.repos[repo].add(t);
+
+    double latency = entry.latency >= 0 ? entry.latency : entry.request_time;
+    std::string provider = entry.backend + "/" + (entry.provider.empty() ? "default" : entry.provider);
+    for (GroupStats* group : {&aggregate.models[entry.model.empty() ? "unknown" : entry.model], &aggregate.providers[provider]}) {
+        group->totals.add(t);
+        if (latency >= 0) {
+            group->latency.record(std::llround(latency));
+        }
+    }
+}
+
+// Parses the complete lines of one log through a read-only mapping; a line still being
+// written by another process has no newline yet and is left for the next run
+void parse_log(const StatsLog& log, const StatsQuery& query, Aggregate& aggregate) {
+    int fd = ::open(log.path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || ::fstat(fd, &st) != 0) {
+        if (fd >= 0) ::close(fd);
+        aggregate.unreadable.push_back(log.path);
+        return;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    if (size == 0) {
+        ::close(fd);
+        return;
+    }
+    void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        aggregate.unreadable.push_back(log.path);
+        return;
+    }
+    ::madvise(mapped, size, MADV_SEQUENTIAL);
+
+    const char* data = static_cast<const char*>(mapped);
+    const char* end = data + size;
+    for (const char* line = data; line < end;) {
+        const char* newline = static_cast<const char*>(std::memchr(line, '\n', static_cast<size_t>(end - line)));
+        if (!newline) break;
+        if (newline > line) {
+            StatsLineSax entry;
+            try {
+                if (nlohmann::json::sax_parse(line, newline, &entry)) {
+                    if (in_window(entry.date, query)) {
+                        add_entry(aggregate, log.repo, entry);
+                    }
+                } else {
+                    aggregate.invalid_lines++;
+                }
+            } catch (const nlohmann::json::exception&) {
+                aggregate.invalid_lines++;
+            }
+        }
+        line = newline + 1;
+    }
+    aggregate.bytes += size;
+    ::munmap(mapped, size);
+}
+
+void print_totals_header(const char* title) {
+    std::cout << title << std::endl;
+    std::cout << "  " << std::left << std::setw(48) << "" << std::right << std::setw(9) << "count" << std::setw(12) << "cost"
+              << std::setw(14) << "input tok" << std::setw(13) << "output tok";
+}
+
+void print_totals(const std::string& name, const Totals& t) {
+    std::cout << "  " << std::left << std::setw(48) << name << std::right << std::setw(9) << t.count << std::fixed << std::setprecision(4)
+              << std::setw(12) << t.cost << std::setw(14) << static_cast<long long>(t.input_tokens) << std::setw(13) << static_cast<long long>(t.output_tokens);
+}
+
+void print_groups(const char* title, const std::map<std::string, GroupStats>& groups) {
+    print_totals_header(title);
+    std::cout << std::setw(9) << "p50 ms" << std::setw(9) << "p90 ms" << std::endl;
+    for (const auto& [name, group] : groups) {
+        print_totals(name, group.totals);
+        if (group.latency.count() > 0) {
+            std::cout << std::setw(9) << group.latency.value_at_percentile(50) << std::setw(9) << group.latency.value_at_percentile(90);
+        } else {
+            std::cout << std::setw(9) << "-" << std::setw(9) << "-";
+        }
+        std::cout << std::endl;
+    }
+}
+
+} // namespace
+
+void summarize_fleet_stats(const std::vector<std::string>& roots, const StatsQuery& query) {
+    validate_stats_query(query);
+    if (query.group_by != "none") {
+        throw std::runtime_error("--group-by is not supported with --roots");
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::vector<StatsLog> logs = find_stats_logs(roots);
+    if (logs.empty()) {
+        std::cout << "No generation stats logs found" << std::endl;
+        return;
+    }
+
+    // Workers take the next log as they finish one, so a few large logs do not leave the rest idle
+    size_t workers = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), logs.size());
+    std::vector<Aggregate> partial(workers);
+    std::atomic<size_t> next{0};
+    {
+        ThreadPool pool(workers);
+        std::vector<std::future<void>> done;
+        for (size_t w = 0; w < workers; ++w) {
+            done.push_back(pool.submit([&, w] {
+                for (size_t i = next++; i < logs.size(); i = next++) {
+                    parse_log(logs[i], query, partial[w]);
+                }
+            }));
+        }
+        for (auto& f : done) {
+            f.get();
+        }
+    }
+    Aggregate report = std::move(partial[0]);
+    for (size_t w = 1; w < workers; ++w) {
+        report.add(std::move(partial[w]));
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Generation Statistics Summary for " << logs.size() << " repositories";
+    if (!query.since.empty() || !query.until.empty()) {
+        std::cout << " (" << (query.since.empty() ? "start" : query.since) << " to " << (query.until.empty() ? "now" : query.until) << ")";
+    }
+    std::cout << ":" << std::endl;
+    std::cout << "Scanned " << std::fixed << std::setprecision(1) << report.bytes / 1048576.0 << " MB in " << std::setprecision(2) << seconds
+              << " s on " << workers << " threads" << std::endl;
+    if (report.invalid_lines > 0) {
+        std::cout << Colors::YELLOW << "Skipped " << report.invalid_lines << " malformed lines" << Colors::RESET << std::endl;
+    }
+    for (const auto& path : report.unreadable) {
+        std::cout << Colors::YELLOW << "Could not read " << path << Colors::RESET << std::endl;
+    }
+    if (report.totals.count == 0) {
+        std::cout << "No valid generation stats found" << std::endl;
+        return;
+    }
+    std::cout << "Total generations: " << report.totals.count;
+    if (report.totals.dry_run_count > 0) {
+        std::cout << " (" << (report.totals.count - report.totals.dry_run_count) << " actual, " << report.totals.dry_run_count << " dry runs)";
+    }
+    std::cout << std::endl;
+    std::cout << "Total cost: $" << std::fixed << std::setprecision(4) << report.totals.cost << std::endl;
+    std::cout << "Total input tokens: " << static_cast<long long>(report.totals.input_tokens) << std::endl;
+    std::cout << "Total output tokens: " << static_cast<long long>(report.totals.output_tokens) << std::endl;
+
+    std::cout << std::endl;
+    std::vector<std::pair<std::string, Totals>> repos(report.repos.begin(), report.repos.end());
+    std::sort(repos.begin(), repos.end(), [](const auto& a, const auto& b) { return a.second.cost != b.second.cost ? a.second.cost > b.second.cost : a.first < b.first; });
+    print_totals_header("By repository (highest cost first):");
+    std::cout << std::endl;
+    for (const auto& [repo, totals] : repos) {
+        print_totals(repo, totals);
+        std::cout << std::endl;
+    }
+    std::cout << std::endl;
+    print_groups("By model:", report.models);
+    std::cout << std::endl;
+    print_groups("By backend/provider:", report.providers);
+}
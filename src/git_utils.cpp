@@ -1,4 +1,6 @@
 #include "git_utils.hpp"
+#include <algorithm>
+#include <fstream>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
@@ -11,6 +13,7 @@
 #include <unistd.h>
 #include <sys/wait.h>
 #include <git2.h>
+#include "tracer.hpp"
 
 std::string GitUtils::cached_repo_root_;
 std::string GitUtils::cached_git_dir_;
@@ -123,12 +126,14 @@ std::string GitUtils::get_diff(bool cached) {
 }
 
 std::string GitUtils::get_full_diff() {
+    TraceSpan span("diff render");
     std::string staged = get_diff(true);
     std::string unstaged = get_diff(false);
     return staged + unstaged;
 }
 
-std::vector<std::string> GitUtils::get_unstaged_files() {
+StatusLists GitUtils::get_status() {
+    TraceSpan span("status scan");
     git_repository* repo = repo_.get_repo();
     git_status_list *status_list = nullptr;
     int error = git_status_list_new(&status_list, repo, nullptr);
@@ -136,59 +141,66 @@ std::vector<std::string> GitUtils::get_unstaged_files() {
         throw std::runtime_error("Failed to get status");
     }
 
-    std::vector<std::string> files;
+    StatusLists lists;
     size_t count = git_status_list_entrycount(status_list);
     for (size_t i = 0; i < count; ++i) {
         const git_status_entry *entry = git_status_byindex(status_list, i);
+        if (entry->status & GIT_STATUS_INDEX_MODIFIED) {
+            lists.staged.push_back(entry->head_to_index->new_file.path);
+        }
         if (entry->status & GIT_STATUS_WT_MODIFIED) {
-            files.push_back(entry->index_to_workdir->new_file.path);
+            lists.unstaged.push_back(entry->index_to_workdir->new_file.path);
+        }
+        if (entry->status & GIT_STATUS_WT_NEW) {
+            lists.untracked.push_back(entry->index_to_workdir->new_file.path);
         }
     }
     git_status_list_free(status_list);
-    return files;
+    return lists;
 }
 
-std::vector<std::string> GitUtils::get_tracked_modified_files() {
-    git_repository* repo = repo_.get_repo();
-    git_status_list *status_list = nullptr;
-    int error = git_status_list_new(&status_list, repo, nullptr);
-    if (error != 0) {
-        throw std::runtime_error("Failed to get status");
-    }
+std::vector<std::string> GitUtils::get_unstaged_files() {
+    return get_status().unstaged;
+}
 
-    std::vector<std::string> files;
-    size_t count = git_status_list_entrycount(status_list);
-    for (size_t i = 0; i < count; ++i) {
-        const git_status_entry *entry = git_status_byindex(status_list, i);
-        if (entry->status & GIT_STATUS_INDEX_MODIFIED) {
-            files.push_back(entry->head_to_index->new_file.path);
-        }
-    }
-    git_status_list_free(status_list);
-    return files;
+std::vector<std::string> GitUtils::get_tracked_modified_files() {
+    return get_status().staged;
 }
 
 std::vector<std::string> GitUtils::get_untracked_files() {
-    git_repository* repo = repo_.get_repo();
-    git_status_list *status_list = nullptr;
-    int error = git_status_list_new(&status_list, repo, nullptr);
-    if (error != 0) {
-        throw std::runtime_error("Failed to get status");
-    }
+    return get_status().untracked;
+}
 
-    std::vector<std::string> files;
-    size_t count = git_status_list_entrycount(status_list);
-    for (size_t i = 0; i < count; ++i) {
-        const git_status_entry *entry = git_status_byindex(status_list, i);
-        if (entry->status & GIT_STATUS_WT_NEW) {
-            files.push_back(entry->index_to_workdir->new_file.path);
+std::string GitUtils::get_untracked_diff(const std::vector<std::string>& files) {
+    TraceSpan span("untracked synthesis");
+    std::string diff;
+    for (const auto& file : files) {
+        std::ifstream file_stream(repo_.get_repo_root() + "/" + file);
+        if (!file_stream) continue;
+        std::stringstream content;
+        content << file_stream.rdbuf();
+        std::string file_content = content.str();
+        size_t line_count = std::count(file_content.begin(), file_content.end(), '\n') + (file_content.empty() ? 0 : 1);
+        diff += "diff --git a/" + file + " b/" + file + "\n";
+        diff += "new file mode 100644\n";
+        diff += "index 0000000..e69de29\n";
+        diff += "--- /dev/null\n";
+        diff += "+++ b/" + file + "\n";
+        diff += "@@ -0,0 +1," + std::to_string(line_count) + " @@\n";
+        std::istringstream iss(file_content);
+        std::string line;
+        while (std::getline(iss, line)) {
+            diff += "+" + line + "\n";
+        }
+        if (!file_content.empty() && file_content.back() != '\n') {
+            diff += "\n\\ No newline at end of file\n";
         }
     }
-    git_status_list_free(status_list);
-    return files;
+    return diff;
 }
 
 void GitUtils::add_files() {
+    TraceSpan span("index write");
     git_repository* repo = repo_.get_repo();
     git_index *index = nullptr;
     git_repository_index(&index, repo);
@@ -202,6 +214,7 @@ void GitUtils::add_files() {
 }
 
 void GitUtils::add_files(const std::vector<std::string>& files) {
+    TraceSpan span("index write");
     if (files.empty()) return;
     git_repository* repo = repo_.get_repo();
     git_index *index = nullptr;
@@ -218,6 +231,7 @@ void GitUtils::add_files(const std::vector<std::string>& files) {
 }
 
 void GitUtils::commit(const std::string& message) {
+    TraceSpan span("commit");
     git_repository* repo = repo_.get_repo();
     git_index *index = nullptr;
     git_repository_index(&index, repo);
@@ -253,6 +267,7 @@ void GitUtils::commit(const std::string& message) {
 }
 
 std::pair<std::string, std::string> GitUtils::commit_with_output(const std::string& message) {
+    TraceSpan span("commit");
     git_repository* repo = repo_.get_repo();
     git_index *index = nullptr;
     git_repository_index(&index, repo);
@@ -319,16 +334,24 @@ int transfer_progress_cb(const git_transfer_progress *stats, void *payload) {
 int credentials_cb(git_credential **out, const char *url, const char *username_from_url, unsigned int allowed_types, void *payload) {
     std::string username = username_from_url ? username_from_url : "";
     
-    // Fallback to Git config username if not provided or generic
+    // Fallback to Git config username if not provided or generic. libgit2 calls back once per
+    // authentication attempt, so the default config is read only the first time.
     if (username.empty() || username == "git") {
-        git_config *cfg = nullptr;
-        git_config_open_default(&cfg);
-        if (cfg) {
-            const char *config_username = nullptr;
-            if (git_config_get_string(&config_username, cfg, "user.name") == 0) {
-                username = config_username;
+        static const std::string config_username = [] {
+            std::string name;
+            git_config *cfg = nullptr;
+            git_config_open_default(&cfg);
+            if (cfg) {
+                const char *value = nullptr;
+                if (git_config_get_string(&value, cfg, "user.name") == 0) {
+                    name = value;
+                }
+                git_config_free(cfg);
             }
-            git_config_free(cfg);
+            return name;
+        }();
+        if (!config_username.empty()) {
+            username = config_username;
         }
     }
     
@@ -347,35 +370,94 @@ int credentials_cb(git_credential **out, const char *url, const char *username_f
     return -1;
 }
 
-void GitUtils::push() {
+PreparedPush::~PreparedPush() {
+    if (remote_) {
+        git_remote_disconnect(remote_);
+        git_remote_free(remote_);
+    }
+    if (repo_) {
+        git_repository_free(repo_);
+    }
+}
+
+std::future<std::unique_ptr<PreparedPush>> GitUtils::prepare_push() {
+    std::string git_dir = git_repository_path(repo_.get_repo());
+    return std::async(std::launch::async, [git_dir] {
+        TraceSpan span("push prepare");
+        auto prepared = std::make_unique<PreparedPush>();
+        git_reference *head_ref = nullptr;
+        git_oid head;
+        if (git_repository_open(&prepared->repo_, git_dir.c_str()) != 0 ||
+            git_repository_head(&head_ref, prepared->repo_) != 0 ||
+            git_reference_name_to_id(&head, prepared->repo_, "HEAD") != 0) {
+            prepared->error = "Failed to read HEAD";
+            git_reference_free(head_ref);
+            return prepared;
+        }
+        std::string branch_ref = std::string("refs/heads/") + git_reference_shorthand(head_ref);
+        git_reference_free(head_ref);
+
+        git_remote_callbacks callbacks = GIT_REMOTE_CALLBACKS_INIT;
+        callbacks.credentials = credentials_cb;
+        if (git_remote_lookup(&prepared->remote_, prepared->repo_, "origin") != 0 ||
+            git_remote_connect(prepared->remote_, GIT_DIRECTION_PUSH, &callbacks, nullptr, nullptr) != 0) {
+            const git_error *err = git_error_last();
+            prepared->error = err ? err->message : "Failed to connect to origin";
+            git_remote_free(prepared->remote_);
+            prepared->remote_ = nullptr;
+            return prepared;
+        }
+
+        // A tip that HEAD does not descend from (or that is not even fetched yet) cannot be
+        // fast-forwarded; descendant_of() reports the latter as an error
+        const git_remote_head **heads = nullptr;
+        size_t count = 0;
+        if (git_remote_ls(&heads, &count, prepared->remote_) == 0) {
+            for (size_t i = 0; i < count; ++i) {
+                if (branch_ref != heads[i]->name) continue;
+                const git_oid *tip = &heads[i]->oid;
+                prepared->diverged = !git_oid_equal(tip, &head) && git_graph_descendant_of(prepared->repo_, &head, tip) != 1;
+            }
+        }
+        return prepared;
+    });
+}
+
+void GitUtils::push(PreparedPush* prepared) {
+    TraceSpan span("push");
     git_repository* repo = repo_.get_repo();
+    bool connected = prepared && prepared->remote_;
     // Find remote "origin"
     git_remote *remote = nullptr;
-    int error = git_remote_lookup(&remote, repo, "origin");
-    if (error != 0) {
-        const git_error *err = git_error_last();
-        std::string msg = "No 'origin' remote found";
-        if (err) msg += ": " + std::string(err->message);
-        msg += "\nSuggestion: Add a remote with 'git remote add origin <url>'";
-        throw std::runtime_error(msg);
+    if (!connected) {
+        int error = git_remote_lookup(&remote, repo, "origin");
+        if (error != 0) {
+            const git_error *err = git_error_last();
+            std::string msg = "No 'origin' remote found";
+            if (err) msg += ": " + std::string(err->message);
+            msg += "\nSuggestion: Add a remote with 'git remote add origin <url>'";
+            throw std::runtime_error(msg);
+        }
     }
+    git_remote *target = connected ? prepared->remote_ : remote;
 
     // Get remote URL for diagnostics
-    const char *remote_url = git_remote_url(remote);
+    const char *url = git_remote_url(target);
+    std::string remote_url = url ? url : "unknown";
 
     // Get current branch
     git_reference *head_ref = nullptr;
     git_repository_head(&head_ref, repo);
-    const char *branch_name = git_reference_shorthand(head_ref);
+    std::string branch_name = git_reference_shorthand(head_ref);
 
     // Check if branch has upstream
     git_reference *upstream_ref = nullptr;
-    error = git_branch_upstream(&upstream_ref, head_ref);
+    int error = git_branch_upstream(&upstream_ref, head_ref);
+    git_reference_free(head_ref);
     if (error != 0) {
-        git_reference_free(head_ref);
         git_remote_free(remote);
-        std::string msg = "Current branch '" + std::string(branch_name) + "' has no upstream tracking branch";
-        msg += "\nSuggestion: Set upstream with 'git branch --set-upstream-to=origin/" + std::string(branch_name) + "'";
+        std::string msg = "Current branch '" + branch_name + "' has no upstream tracking branch";
+        msg += "\nSuggestion: Set upstream with 'git branch --set-upstream-to=origin/" + branch_name + "'";
         throw std::runtime_error(msg);
     }
     git_reference_free(upstream_ref);
@@ -390,15 +472,23 @@ void GitUtils::push() {
 
     // Refspecs
     git_strarray refspecs = {0};
-    std::string refspec = std::string("refs/heads/") + branch_name + ":refs/heads/" + branch_name;
+    std::string refspec = "refs/heads/" + branch_name + ":refs/heads/" + branch_name;
     char *refspec_ptr = strdup(refspec.c_str());
     refspecs.strings = &refspec_ptr;
     refspecs.count = 1;
 
-    error = git_remote_push(remote, &refspecs, &push_opts);
+    if (connected) {
+        // What git_remote_push() does after connecting; the advertisement was read up front
+        error = git_remote_upload(target, &refspecs, &push_opts);
+        if (error == 0) {
+            error = git_remote_update_tips(target, &push_opts.callbacks, 0, GIT_REMOTE_DOWNLOAD_TAGS_UNSPECIFIED, nullptr);
+        }
+        git_remote_disconnect(target);
+    } else {
+        error = git_remote_push(target, &refspecs, &push_opts);
+    }
 
     free(refspec_ptr);
-    git_reference_free(head_ref);
     git_remote_free(remote);
 
     std::cout << std::endl;
@@ -409,8 +499,8 @@ void GitUtils::push() {
         if (err) {
             msg += ": " + std::string(err->message);
         }
-        msg += "\nRemote: " + std::string(remote_url ? remote_url : "unknown");
-        msg += "\nBranch: " + std::string(branch_name);
+        msg += "\nRemote: " + remote_url;
+        msg += "\nBranch: " + branch_name;
         // Add suggestions based on common errors
         if (err && std::string(err->message).find("authentication") != std::string::npos) {
             msg += "\nSuggestion: Check your credentials or SSH key configuration";
@@ -421,4 +511,186 @@ void GitUtils::push() {
         }
         throw std::runtime_error(msg);
     }
-}
\ No newline at end of file
+}
+
+namespace {
+
+std::string oid_to_string(const git_oid& oid, size_t length = GIT_OID_HEXSZ) {
+    char hash_str[GIT_OID_HEXSZ + 1];
+    git_oid_tostr(hash_str, length + 1, &oid);
+    return hash_str;
+}
+
+std::string last_git_error(const std::string& context) {
+    const git_error* e = git_error_last();
+    return context + (e && e->message ? ": " + std::string(e->message) : "");
+}
+
+} // namespace
+
+CommitRange GitUtils::get_commit_range(const std::string& range) {
+    git_repository* repo = repo_.get_repo();
+    git_revspec spec;
+    std::string spec_str = range.find("..") == std::string::npos ? range + "..HEAD" : range;
+    if (git_revparse(&spec, repo, spec_str.c_str()) != 0) {
+        throw std::runtime_error(last_git_error("Invalid range '" + range + "'"));
+    }
+    if (spec.flags & GIT_REVSPEC_MERGE_BASE) {
+        git_object_free(spec.from);
+        git_object_free(spec.to);
+        throw std::runtime_error("Symmetric ranges (A...B) are not supported; use A..B");
+    }
+
+    // The branch is resolved now, so the rewrite can refuse to move it if it changed meanwhile
+    CommitRange result;
+    git_reference* head = nullptr;
+    bool ends_at_head = false;
+    if (git_repository_head(&head, repo) == 0) {
+        const git_oid* head_oid = git_reference_target(head);
+        ends_at_head = head_oid && git_oid_equal(git_object_id(spec.to), head_oid);
+        if (git_reference_is_branch(head)) {
+            result.head_ref = git_reference_name(head);
+        }
+        git_reference_free(head);
+    }
+
+    git_revwalk* walk = nullptr;
+    git_revwalk_new(&walk, repo);
+    git_revwalk_sorting(walk, GIT_SORT_TOPOLOGICAL | GIT_SORT_REVERSE);
+    git_revwalk_push(walk, git_object_id(spec.to));
+    if (spec.from) {
+        git_revwalk_hide(walk, git_object_id(spec.from));
+    }
+    git_object_free(spec.from);
+    git_object_free(spec.to);
+    if (!ends_at_head) {
+        git_revwalk_free(walk);
+        throw std::runtime_error("Range '" + range + "' must end at HEAD");
+    }
+
+    std::vector<RangeCommit>& commits = result.commits;
+    git_oid oid;
+    while (git_revwalk_next(&oid, walk) == 0) {
+        git_commit* commit = nullptr;
+        git_commit_lookup(&commit, repo, &oid);
+        unsigned int parents = git_commit_parentcount(commit);
+        const char* summary = git_commit_summary(commit);
+        const char* message = git_commit_message(commit);
+        RangeCommit entry{oid, oid_to_string(oid, 7), summary ? summary : "", message ? message : ""};
+        git_commit_free(commit);
+        if (parents > 1) {
+            git_revwalk_free(walk);
+            throw std::runtime_error("Range contains merge commit " + entry.short_id + "; rewording merges is not supported");
+        }
+        commits.push_back(std::move(entry));
+    }
+    git_revwalk_free(walk);
+    return result;
+}
+
+std::string GitUtils::get_commit_diff(git_repository* repo, const git_oid& commit_id) {
+    TraceSpan span("commit diff");
+    git_commit* commit = nullptr;
+    if (git_commit_lookup(&commit, repo, &commit_id) != 0) {
+        throw std::runtime_error(last_git_error("Failed to look up commit"));
+    }
+    git_tree* tree = nullptr;
+    git_commit_tree(&tree, commit);
+    git_tree* parent_tree = nullptr;
+    if (git_commit_parentcount(commit) > 0) {
+        git_commit* parent = nullptr;
+        git_commit_parent(&parent, commit, 0);
+        git_commit_tree(&parent_tree, parent);
+        git_commit_free(parent);
+    }
+
+    git_diff* diff = nullptr;
+    int error = git_diff_tree_to_tree(&diff, repo, parent_tree, tree, nullptr);
+    git_tree_free(parent_tree);
+    git_tree_free(tree);
+    git_commit_free(commit);
+    if (error != 0) {
+        throw std::runtime_error("Failed to create diff");
+    }
+
+    git_buf buf = {0};
+    git_diff_to_buf(&buf, diff, GIT_DIFF_FORMAT_PATCH);
+    std::string result = buf.ptr ? buf.ptr : "";
+    git_buf_dispose(&buf);
+    git_diff_free(diff);
+    return result;
+}
+
+std::string GitUtils::rewrite_messages(const CommitRange& range, const std::vector<std::string>& messages) {
+    git_repository* repo = repo_.get_repo();
+    const std::vector<RangeCommit>& commits = range.commits;
+    // Commits before the first changed message are kept as they are, hashes included
+    size_t first = 0;
+    while (first < commits.size() && messages[first] == commits[first].message) {
+        ++first;
+    }
+    if (first == commits.size()) {
+        return "";
+    }
+
+    git_signature* committer = nullptr;
+    if (git_signature_default(&committer, repo) != 0) {
+        throw std::runtime_error(last_git_error("Failed to determine committer identity"));
+    }
+
+    // Each rewritten commit becomes the parent of the next; the first keeps its original parent
+    git_commit* new_parent = nullptr;
+    git_oid new_oid;
+    for (size_t i = first; i < commits.size(); ++i) {
+        git_commit* original = nullptr;
+        git_commit_lookup(&original, repo, &commits[i].id);
+        git_tree* tree = nullptr;
+        git_commit_tree(&tree, original);
+
+        git_commit* parent = new_parent;
+        if (!parent && git_commit_parentcount(original) > 0) {
+            git_commit_parent(&parent, original, 0);
+        }
+        const git_commit* parents[] = {parent};
+        int error = git_commit_create(&new_oid, repo, nullptr, git_commit_author(original), committer,
+                                      "UTF-8", messages[i].c_str(), tree, parent ? 1 : 0, parents);
+        git_tree_free(tree);
+        git_commit_free(original);
+        git_commit_free(parent);
+        new_parent = nullptr;
+        if (error != 0) {
+            git_signature_free(committer);
+            throw std::runtime_error(last_git_error("Failed to rewrite commit " + commits[i].short_id));
+        }
+        git_commit_lookup(&new_parent, repo, &new_oid);
+    }
+    git_commit_free(new_parent);
+    git_signature_free(committer);
+
+    // Generating the messages can take minutes; a commit or checkout made meanwhile must not be
+    // overwritten, so the update only applies while the ref still points at the old tip
+    const git_oid* old_tip = &commits.back().id;
+    const std::string moved = "HEAD moved during reword; the new commits were not applied (new tip " + oid_to_string(new_oid) + ")";
+    std::string log_message = "commit: reword " + std::to_string(commits.size() - first) + " commits";
+    if (!range.head_ref.empty()) {
+        git_reference* updated = nullptr;
+        int error = git_reference_create_matching(&updated, repo, range.head_ref.c_str(), &new_oid, 1, old_tip, log_message.c_str());
+        git_reference_free(updated);
+        if (error == GIT_EMODIFIED) {
+            throw std::runtime_error(moved);
+        }
+        if (error != 0) {
+            throw std::runtime_error(last_git_error("Failed to update " + range.head_ref));
+        }
+    } else {
+        git_oid head_oid;
+        if (git_repository_head_detached(repo) != 1 || git_reference_name_to_id(&head_oid, repo, "HEAD") != 0 ||
+            !git_oid_equal(&head_oid, old_tip)) {
+            throw std::runtime_error(moved);
+        }
+        if (git_repository_set_head_detached(repo, &new_oid) != 0) {
+            throw std::runtime_error(last_git_error("Failed to update HEAD"));
+        }
+    }
+    return oid_to_string(new_oid);
+}
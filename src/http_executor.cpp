@@ -0,0 +1,279 @@
+#include "http_executor.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <fcntl.h>
+#include <unistd.h>
+#include "tracer.hpp"
+
+namespace {
+
+size_t collect_body(void* contents, size_t size, size_t nmemb, void* userp) {
+    static_cast<std::string*>(userp)->append(static_cast<char*>(contents), size * nmemb);
+    return size * nmemb;
+}
+
+// "http /chat/completions" for https://host/api/v1/chat/completions?x=y; the API version
+// prefix is dropped so spans from different backends line up
+std::string span_name(CURL* handle) {
+    char* url = nullptr;
+    curl_easy_getinfo(handle, CURLINFO_EFFECTIVE_URL, &url);
+    std::string path = url ? url : "";
+    size_t scheme = path.find("://");
+    size_t start = path.find('/', scheme == std::string::npos ? 0 : scheme + 3);
+    path = start == std::string::npos ? "/" : path.substr(start, path.find('?', start) - start);
+    size_t version = path.find("/v1/");
+    if (version != std::string::npos) {
+        path = path.substr(version + 3);
+    }
+    return "http " + path;
+}
+
+#if LIBCURL_VERSION_NUM >= 0x080c00
+// Session tickets are secrets, so the file is private to the user. It holds a magic line, then
+// one record per session: the expiry as a 64-bit Unix time, then the session key, its salted
+// hash and the ticket, each as a 32-bit length followed by the bytes.
+constexpr char SESSION_FILE_MAGIC[] = "commit-tls-sessions 1\n";
+
+std::string tls_session_path() {
+    const char* cache = std::getenv("XDG_CACHE_HOME");
+    if (cache && std::strlen(cache) > 0) {
+        return std::string(cache) + "/commit/tls_sessions";
+    }
+    const char* home = std::getenv("HOME");
+    if (!home || std::strlen(home) == 0) {
+        return "";
+    }
+    return std::string(home) + "/.cache/commit/tls_sessions";
+}
+
+void put_bytes(std::string& out, const void* data, size_t size) {
+    uint32_t length = static_cast<uint32_t>(size);
+    out.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    out.append(static_cast<const char*>(data), size);
+}
+
+bool get_bytes(const std::string& in, size_t& pos, std::string& value) {
+    uint32_t length = 0;
+    if (in.size() - pos < sizeof(length)) return false;
+    std::memcpy(&length, in.data() + pos, sizeof(length));
+    pos += sizeof(length);
+    if (in.size() - pos < length) return false;
+    value.assign(in, pos, length);
+    pos += length;
+    return true;
+}
+
+CURLcode export_session(CURL*, void* userptr, const char* session_key, const unsigned char* shmac, size_t shmac_len,
+                        const unsigned char* sdata, size_t sdata_len, curl_off_t valid_until, int, const char*, size_t) {
+    std::string& out = *static_cast<std::string*>(userptr);
+    int64_t expiry = valid_until;
+    out.append(reinterpret_cast<const char*>(&expiry), sizeof(expiry));
+    put_bytes(out, session_key ? session_key : "", session_key ? std::strlen(session_key) : 0);
+    put_bytes(out, shmac, shmac_len);
+    put_bytes(out, sdata, sdata_len);
+    return CURLE_OK;
+}
+
+// Loads the sessions saved by earlier runs; a missing or damaged file just means full handshakes
+void import_tls_sessions(CURLSH* share) {
+    std::string path = tls_session_path();
+    std::ifstream file(path, std::ios::binary);
+    if (path.empty() || !file) return;
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    size_t pos = sizeof(SESSION_FILE_MAGIC) - 1;
+    if (data.compare(0, pos, SESSION_FILE_MAGIC) != 0) return;
+    CURL* handle = curl_easy_init();
+    if (!handle) return;
+    curl_easy_setopt(handle, CURLOPT_SHARE, share);
+    int64_t now = static_cast<int64_t>(std::time(nullptr));
+    while (data.size() - pos >= sizeof(int64_t)) {
+        int64_t expiry = 0;
+        std::memcpy(&expiry, data.data() + pos, sizeof(expiry));
+        pos += sizeof(expiry);
+        std::string key, shmac, ticket;
+        if (!get_bytes(data, pos, key) || !get_bytes(data, pos, shmac) || !get_bytes(data, pos, ticket)) break;
+        if (expiry > 0 && expiry <= now) continue;
+        curl_easy_ssls_import(handle, key.empty() ? nullptr : key.c_str(),
+                              reinterpret_cast<const unsigned char*>(shmac.data()), shmac.size(),
+                              reinterpret_cast<const unsigned char*>(ticket.data()), ticket.size());
+    }
+    curl_easy_cleanup(handle);
+}
+
+// Replaces the file with the sessions now in the cache; left alone when there are none
+void export_tls_sessions(CURLSH* share) {
+    std::string path = tls_session_path();
+    CURL* handle = path.empty() ? nullptr : curl_easy_init();
+    if (!handle) return;
+    curl_easy_setopt(handle, CURLOPT_SHARE, share);
+    std::string records;
+    // CURLE_NOT_BUILT_IN when libcurl was built without SSLS-EXPORT
+    CURLcode rc = curl_easy_ssls_export(handle, export_session, &records);
+    curl_easy_cleanup(handle);
+    if (rc != CURLE_OK || records.empty()) return;
+
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+    std::string tmp = path + ".tmp." + std::to_string(::getpid());
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) return;
+    std::string data = SESSION_FILE_MAGIC + records;
+    bool written = ::write(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size());
+    ::close(fd);
+    if (!written || ::rename(tmp.c_str(), path.c_str()) != 0) {
+        ::unlink(tmp.c_str());
+    }
+}
+#endif
+
+} // namespace
+
+HttpExecutor& HttpExecutor::instance() {
+    static HttpExecutor executor;
+    return executor;
+}
+
+HttpExecutor::HttpExecutor() {
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    multi_ = curl_multi_init();
+    if (!multi_) {
+        throw std::runtime_error("Failed to initialize CURL multi handle");
+    }
+    // Let requests to the same host share one connection instead of opening several
+    curl_multi_setopt(multi_, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    share_ = curl_share_init();
+    if (share_) {
+        curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x080c00
+        import_tls_sessions(share_);
+#endif
+    }
+    thread_ = std::thread(&HttpExecutor::run, this);
+}
+
+HttpExecutor::~HttpExecutor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    curl_multi_wakeup(multi_);
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    // Outstanding transfers are dropped; their promises report broken_promise
+    for (auto& [handle, transfer] : active_) {
+        curl_multi_remove_handle(multi_, handle);
+    }
+    active_.clear();
+    delayed_.clear();
+    submitted_.clear();
+    curl_multi_cleanup(multi_);
+    if (share_) {
+#if LIBCURL_VERSION_NUM >= 0x080c00
+        export_tls_sessions(share_);
+#endif
+        curl_share_cleanup(share_);
+    }
+}
+
+void HttpExecutor::submit(std::unique_ptr<CurlRequest> request, Completion done, std::chrono::milliseconds delay) {
+    auto transfer = std::make_unique<Transfer>();
+    transfer->request = std::move(request);
+    transfer->done = std::move(done);
+    transfer->start_at = std::chrono::steady_clock::now() + delay;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        submitted_.push_back(std::move(transfer));
+    }
+    curl_multi_wakeup(multi_);
+}
+
+void HttpExecutor::preconnect(const std::string& url) {
+    auto request = std::make_unique<CurlRequest>();
+    request->set_url(url);
+    request->set_head_method();
+    submit(std::move(request), [](CURLcode, std::string&&, const HttpTiming&) {});
+}
+
+void HttpExecutor::start_transfer(std::unique_ptr<Transfer> transfer) {
+    CurlRequest& request = *transfer->request;
+    request.set_write_callback(collect_body, &transfer->response);
+    request.prepare();
+    CURL* handle = request.native_handle();
+    if (share_) {
+        curl_easy_setopt(handle, CURLOPT_SHARE, share_);
+    }
+    // Wait for a connection still being set up (e.g. by preconnect()) rather than opening a second one
+    curl_easy_setopt(handle, CURLOPT_PIPEWAIT, 1L);
+    transfer->started = std::chrono::steady_clock::now();
+    CURLMcode rc = curl_multi_add_handle(multi_, handle);
+    if (rc != CURLM_OK) {
+        transfer->done(CURLE_FAILED_INIT, std::move(transfer->response), HttpTiming());
+        return;
+    }
+    active_.emplace(handle, std::move(transfer));
+}
+
+void HttpExecutor::run() {
+    std::vector<std::unique_ptr<Transfer>> incoming;
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_) return;
+            incoming.swap(submitted_);
+        }
+        auto now = std::chrono::steady_clock::now();
+        for (auto& transfer : incoming) {
+            if (transfer->start_at > now) {
+                auto start_at = transfer->start_at;
+                delayed_.emplace(start_at, std::move(transfer));
+            } else {
+                start_transfer(std::move(transfer));
+            }
+        }
+        incoming.clear();
+        while (!delayed_.empty() && delayed_.begin()->first <= now) {
+            start_transfer(std::move(delayed_.begin()->second));
+            delayed_.erase(delayed_.begin());
+        }
+
+        int running = 0;
+        curl_multi_perform(multi_, &running);
+
+        int queued = 0;
+        while (CURLMsg* msg = curl_multi_info_read(multi_, &queued)) {
+            if (msg->msg != CURLMSG_DONE) continue;
+            CURL* handle = msg->easy_handle;
+            CURLcode result = msg->data.result;
+            curl_multi_remove_handle(multi_, handle);
+            auto it = active_.find(handle);
+            if (it == active_.end()) continue;
+            std::unique_ptr<Transfer> transfer = std::move(it->second);
+            active_.erase(it);
+            transfer->request->capture_timing();
+            if (Tracer::instance().enabled()) {
+                Tracer::instance().record(span_name(handle), transfer->started, std::chrono::steady_clock::now(),
+                                          result == CURLE_OK ? "" : curl_easy_strerror(result));
+            }
+            try {
+                transfer->done(result, std::move(transfer->response), transfer->request->timing());
+            } catch (...) {
+                // Completions report errors through their own futures; never let one stop the loop
+            }
+        }
+
+        // Sleep until there is socket activity, a submission, or the next delayed request is due
+        int timeout_ms = 1000;
+        if (!delayed_.empty()) {
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(delayed_.begin()->first - std::chrono::steady_clock::now()).count();
+            timeout_ms = static_cast<int>(std::clamp<long long>(wait, 0, timeout_ms));
+        }
+        curl_multi_poll(multi_, nullptr, 0, timeout_ms, nullptr);
+    }
+}
@@ -0,0 +1,272 @@
+#include "json_writer.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include "tracer.hpp"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define COMMIT_HAVE_X86_KERNELS 1
+#endif
+
+namespace {
+
+constexpr size_t CHUNK_SIZE = 16 * 1024;
+constexpr char HEX_DIGITS[] = "0123456789abcdef";
+
+using EscapeKernel = const unsigned char* (*)(const unsigned char* in, const unsigned char* chunk_end, const unsigned char* end, char*& out);
+
+// Length of the well-formed UTF-8 sequence at `in`, or 0 if it is malformed. `consumed`
+// is set to the sequence length or, for malformed input, the maximal invalid subpart.
+__attribute__((always_inline)) inline size_t decode_utf8(const unsigned char* in, const unsigned char* end, size_t& consumed) {
+    unsigned char c = in[0];
+    size_t need;
+    unsigned char lo = 0x80, hi = 0xBF;
+    if (c >= 0xC2 && c <= 0xDF) {
+        need = 1;
+    } else if (c == 0xE0) {
+        need = 2; lo = 0xA0;
+    } else if ((c >= 0xE1 && c <= 0xEC) || c == 0xEE || c == 0xEF) {
+        need = 2;
+    } else if (c == 0xED) {
+        need = 2; hi = 0x9F;  // Excludes UTF-16 surrogates
+    } else if (c == 0xF0) {
+        need = 3; lo = 0x90;
+    } else if (c >= 0xF1 && c <= 0xF3) {
+        need = 3;
+    } else if (c == 0xF4) {
+        need = 3; hi = 0x8F;  // Nothing above U+10FFFF
+    } else {
+        consumed = 1;
+        return 0;
+    }
+    size_t i = 1;
+    for (; i <= need && in + i < end; ++i) {
+        unsigned char b = in[i];
+        if (i == 1 ? (b < lo || b > hi) : (b < 0x80 || b > 0xBF)) break;
+    }
+    consumed = i;
+    return i == need + 1 ? i : 0;
+}
+
+// Second character of the two-character escape for each ASCII byte, 'u' for bytes that
+// need the \u00XX form and 0 for bytes that are written as-is.
+constexpr auto ESCAPES = [] {
+    std::array<char, 128> table{};
+    for (int c = 0; c < 0x20; ++c) table[c] = 'u';
+    table['"'] = '"';
+    table['\\'] = '\\';
+    table['\n'] = 'n';
+    table['\r'] = 'r';
+    table['\t'] = 't';
+    table['\b'] = 'b';
+    table['\f'] = 'f';
+    return table;
+}();
+
+// Writes the escaped form of the character (or U+FFFD for a malformed sequence) at `in`.
+__attribute__((always_inline)) inline const unsigned char* escape_one(const unsigned char* in, const unsigned char* end, char*& out) {
+    unsigned char c = *in;
+    if (c < 0x80) {
+        char escape = ESCAPES[c];
+        if (escape == 0) {
+            *out++ = static_cast<char>(c);
+        } else if (escape != 'u') {
+            out[0] = '\\';
+            out[1] = escape;
+            out += 2;
+        } else {
+            std::memcpy(out, "\\u00", 4);
+            out[4] = HEX_DIGITS[c >> 4];
+            out[5] = HEX_DIGITS[c & 0xF];
+            out += 6;
+        }
+        return in + 1;
+    }
+    size_t consumed;
+    if (decode_utf8(in, end, consumed)) {
+        std::memcpy(out, in, consumed);
+        out += consumed;
+    } else {
+        std::memcpy(out, "\xEF\xBF\xBD", 3);
+        out += 3;
+    }
+    return in + consumed;
+}
+
+const unsigned char* escape_chunk_scalar(const unsigned char* in, const unsigned char* chunk_end, const unsigned char* end, char*& out) {
+    while (in < chunk_end) {
+        in = escape_one(in, end, out);
+    }
+    return in;
+}
+
+#ifdef COMMIT_HAVE_X86_KERNELS
+// A single signed compare against 0x20 flags both control characters and every byte
+// >= 0x80, so a block with an empty mask is plain ASCII that can be copied verbatim.
+// Blocks are stored before the mask is checked; the caller leaves 6 bytes of output
+// room per input byte, which always covers the speculative store.
+__attribute__((target("avx2")))
+const unsigned char* escape_chunk_avx2(const unsigned char* in, const unsigned char* chunk_end, const unsigned char* end, char*& out) {
+    const __m256i space = _mm256_set1_epi8(0x20);
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    while (in < chunk_end) {
+        if (chunk_end - in >= 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+            __m256i special = _mm256_or_si256(_mm256_cmpgt_epi8(space, v),
+                                              _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash)));
+            uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(special));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), v);
+            if (mask == 0) {
+                in += 32;
+                out += 32;
+                continue;
+            }
+            unsigned skip = __builtin_ctz(mask);
+            in += skip;
+            out += skip;
+        }
+        in = escape_one(in, end, out);
+    }
+    return in;
+}
+
+__attribute__((target("sse4.2")))
+const unsigned char* escape_chunk_sse42(const unsigned char* in, const unsigned char* chunk_end, const unsigned char* end, char*& out) {
+    const __m128i space = _mm_set1_epi8(0x20);
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    while (in < chunk_end) {
+        if (chunk_end - in >= 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+            __m128i special = _mm_or_si128(_mm_cmpgt_epi8(space, v),
+                                           _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)));
+            uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(special));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), v);
+            if (mask == 0) {
+                in += 16;
+                out += 16;
+                continue;
+            }
+            unsigned skip = __builtin_ctz(mask);
+            in += skip;
+            out += skip;
+        }
+        in = escape_one(in, end, out);
+    }
+    return in;
+}
+
+__attribute__((target("avx2")))
+const unsigned char* skip_ascii_avx2(const unsigned char* in, const unsigned char* end) {
+    while (end - in >= 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+        if (_mm256_movemask_epi8(v) != 0) break;
+        in += 32;
+    }
+    return in;
+}
+
+__attribute__((target("sse4.2")))
+const unsigned char* skip_ascii_sse42(const unsigned char* in, const unsigned char* end) {
+    while (end - in >= 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+        if (_mm_movemask_epi8(v) != 0) break;
+        in += 16;
+    }
+    return in;
+}
+#endif
+
+const unsigned char* skip_ascii_scalar(const unsigned char* in, const unsigned char* end) {
+    while (in < end && *in < 0x80) ++in;
+    return in;
+}
+
+struct KernelSet {
+    const char* name;
+    EscapeKernel escape;
+    const unsigned char* (*skip_ascii)(const unsigned char*, const unsigned char*);
+};
+
+const KernelSet& active_kernels() {
+    static const KernelSet kernels = [] {
+#ifdef COMMIT_HAVE_X86_KERNELS
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return KernelSet{"avx2", escape_chunk_avx2, skip_ascii_avx2};
+        if (__builtin_cpu_supports("sse4.2")) return KernelSet{"sse4.2", escape_chunk_sse42, skip_ascii_sse42};
+#endif
+        return KernelSet{"scalar", escape_chunk_scalar, skip_ascii_scalar};
+    }();
+    return kernels;
+}
+
+void append_escaped(std::string& out, std::string_view input, EscapeKernel kernel) {
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(input.data());
+    const unsigned char* end = in + input.size();
+    while (in < end) {
+        const unsigned char* chunk_end = in + std::min<size_t>(CHUNK_SIZE, end - in);
+        size_t used = out.size();
+        // Worst case is a control character expanding to \u00XX; 8 extra bytes cover a
+        // multi-byte sequence that starts just before the chunk boundary.
+        out.resize_and_overwrite(used + 6 * static_cast<size_t>(chunk_end - in) + 8, [&](char* buf, size_t) {
+            char* p = buf + used;
+            in = kernel(in, chunk_end, end, p);
+            return static_cast<size_t>(p - buf);
+        });
+    }
+}
+
+void append_quoted(std::string& out, std::string_view input, EscapeKernel kernel) {
+    out.reserve(out.size() + input.size() + input.size() / 8 + 6 * CHUNK_SIZE + 16);
+    out.push_back('"');
+    append_escaped(out, input, kernel);
+    out.push_back('"');
+}
+
+} // namespace
+
+const char* json_escape_kernel_name() {
+    return active_kernels().name;
+}
+
+bool is_valid_utf8(std::string_view input) {
+    const auto& kernels = active_kernels();
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(input.data());
+    const unsigned char* end = in + input.size();
+    while (in < end) {
+        in = kernels.skip_ascii(in, end);
+        while (in < end && *in < 0x80) ++in;
+        if (in == end) break;
+        size_t consumed;
+        if (!decode_utf8(in, end, consumed)) return false;
+        in += consumed;
+    }
+    return true;
+}
+
+void append_json_string(std::string& out, std::string_view input) {
+    append_quoted(out, input, active_kernels().escape);
+}
+
+void append_json_string_scalar(std::string& out, std::string_view input) {
+    append_quoted(out, input, escape_chunk_scalar);
+}
+
+std::string build_chat_payload(const nlohmann::json& fields, std::string_view instructions, std::string_view diff) {
+    TraceSpan span("payload build");
+    const auto& kernels = active_kernels();
+    std::string payload = fields.dump();
+    payload.pop_back();  // Reopen the object to append the message
+    if (payload.size() > 1) {
+        payload += ',';
+    }
+    payload.reserve(payload.size() + instructions.size() + diff.size() + diff.size() / 8 + 6 * CHUNK_SIZE + 64);
+    payload += R"("messages":[{"role":"user","content":")";
+    append_escaped(payload, instructions, kernels.escape);
+    append_escaped(payload, "\n\nDiff:\n", kernels.escape);
+    append_escaped(payload, diff, kernels.escape);
+    payload += "\"}]}";
+    return payload;
+}
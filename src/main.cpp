@@ -12,14 +12,27 @@
 #include <thread>
 #include <vector>
 #include <optional>
+#include <future>
 #include <map>
 #include <algorithm>
 #include "git_utils.hpp"
 #include "config.hpp"
 #include "llm_backend.hpp"
+#include "backend_registry.hpp"
 #include "spinner.hpp"
 #include "colors.hpp"
 #include "statistics.hpp"
+#include "fleet_stats.hpp"
+#include "metrics_exporter.hpp"
+#include "tokenizer.hpp"
+#include "model_router.hpp"
+#include "commit_message.hpp"
+#include "reword.hpp"
+#include "candidates.hpp"
+#include "tracer.hpp"
+#include "daemon_protocol.hpp"
+#include "pregenerate.hpp"
+#include "stage_graph.hpp"
 
 
 
@@ -70,22 +83,6 @@ void check_and_add_commit_to_gitignore(const std::string& repo_root) {
 
 
 
-std::string clean_commit_message(const std::string& msg) {
-    std::string cleaned = msg;
-    // Remove surrounding ```
-    if (cleaned.size() >= 6 && cleaned.substr(0, 3) == "```" && cleaned.substr(cleaned.size() - 3) == "```") {
-        cleaned = cleaned.substr(3, cleaned.size() - 6);
-    }
-    // Remove "diff" at start and end if present
-    if (cleaned.size() >= 8 && cleaned.substr(0, 4) == "diff" && cleaned.substr(cleaned.size() - 4) == "diff") {
-        cleaned = cleaned.substr(4, cleaned.size() - 8);
-    }
-    // Trim whitespace
-    cleaned.erase(cleaned.begin(), std::find_if(cleaned.begin(), cleaned.end(), [](unsigned char ch) { return !std::isspace(ch); }));
-    cleaned.erase(std::find_if(cleaned.rbegin(), cleaned.rend(), [](unsigned char ch) { return !std::isspace(ch); }).base(), cleaned.end());
-    return cleaned;
-}
-
 std::string get_config_path() {
     const char* xdg_config = std::getenv("XDG_CONFIG_HOME");
     std::string config_dir;
@@ -132,6 +129,99 @@ std::vector<std::string> get_config_files(const std::string& config_path) {
     return config_files;
 }
 
+// Falls back to a byte-based estimate when no vocabulary file is installed
+BpeTokenizer load_tokenizer(const Config& config, std::string& vocab_path) {
+    vocab_path = config.tokenizer_vocab.empty() ? get_xdg_data_path() + "/cl100k_base.tiktoken" : config.tokenizer_vocab;
+    try {
+        return BpeTokenizer::load_from_file(vocab_path);
+    } catch (const std::runtime_error&) {
+        return BpeTokenizer();
+    }
+}
+
+// Environment variables take precedence over the API keys in config files
+void apply_api_key_env(Config& config) {
+    for (const auto& name : BackendRegistry::instance().names()) {
+        const BackendInfo& info = BackendRegistry::instance().get(name);
+        if (info.api_key_env.empty()) continue;
+        char* env_key = getenv(info.api_key_env.c_str());
+        if (env_key && strlen(env_key) > 0) {
+            config.*info.api_key_field = env_key;
+        }
+    }
+}
+
+// Applies max_input_tokens and model=auto to a request about to be sent. Returns false, after
+// printing why, when the diff is over budget and oversize_action does not allow trimming.
+bool fit_request(Config& config, std::string& diff) {
+    bool auto_model = config.model == "auto";
+    if (config.max_input_tokens <= 0 && !auto_model) {
+        return true;
+    }
+    TraceSpan token_span("token count");
+    std::string vocab_path;
+    BpeTokenizer tokenizer = load_tokenizer(config, vocab_path);
+    size_t total_tokens = tokenizer.count(config.llm_instructions) + tokenizer.count("\n\nDiff:\n") + tokenizer.count(diff);
+    token_span.end();
+    if (config.max_input_tokens > 0 && total_tokens > static_cast<size_t>(config.max_input_tokens)) {
+        if (config.oversize_action == "trim") {
+            try {
+                diff = trim_diff_to_budget(tokenizer, config.llm_instructions, diff, static_cast<size_t>(config.max_input_tokens));
+            } catch (const std::runtime_error& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+                return false;
+            }
+            size_t trimmed_tokens = tokenizer.count(config.llm_instructions) + tokenizer.count("\n\nDiff:\n") + tokenizer.count(diff);
+            std::cout << Colors::YELLOW << "Diff trimmed from " << total_tokens << " to " << trimmed_tokens << " tokens to fit max_input_tokens="
+                      << config.max_input_tokens << Colors::RESET << std::endl;
+            total_tokens = trimmed_tokens;
+        } else {
+            std::cerr << "Error: Request is " << total_tokens << " input tokens, over max_input_tokens=" << config.max_input_tokens
+                      << ". Stage fewer changes or set oversize_action=trim." << std::endl;
+            return false;
+        }
+    }
+    if (auto_model) {
+        RoutingPolicy policy;
+        policy.latency_slo_ms = config.auto_latency_slo * 1000.0;
+        policy.percentile = config.auto_latency_percentile;
+        RouteDecision decision = route_model(read_stats_summary(get_xdg_data_path() + "/generation_stats.log").series,
+                                             config.backend, config.provider, total_tokens, policy);
+        config.model = decision.model;
+        config.provider = decision.provider;
+        if (config.time_run) {
+            print_route_decision(decision, policy, total_tokens);
+        }
+    }
+    return true;
+}
+
+// Uses a running commitd when `use_daemon` is set, else the backend in-process
+std::unique_ptr<LLMBackend> create_backend(const BackendInfo& info, const Config& config, std::string base_url,
+                                           const std::string& record_dir, const std::string& replay_dir, const std::string& replay_latency,
+                                           bool replay_any, bool use_daemon) {
+    std::unique_ptr<LLMBackend> llm;
+    if (!replay_dir.empty()) {
+        llm = std::make_unique<ReplayBackend>(replay_dir, replay_latency, replay_any);
+    } else if (use_daemon && record_dir.empty()) {
+        llm = DaemonClientBackend::connect(info.name, daemon_socket_path());
+    }
+    if (!llm) {
+        llm = info.create();
+    }
+    if (!record_dir.empty() && replay_dir.empty()) {
+        llm = std::make_unique<ReplayBackend>(std::move(llm), record_dir);
+    }
+    llm->set_api_key(config.*info.api_key_field);
+    if (base_url.empty()) {
+        base_url = config.*info.base_url_field;
+    }
+    if (!base_url.empty()) {
+        llm->set_base_url(base_url);
+    }
+    return llm;
+}
+
 int main(int argc, char** argv) {
     CLI::App app{"commit - Generate commit messages using LLM"};
 
@@ -148,12 +238,28 @@ int main(int argc, char** argv) {
     bool push_flag = false;
     bool list_configs = false;
     bool print_repo_root = false;
+    bool count_tokens = false;
+    bool no_daemon = false;
+    bool watch = false;
+    std::string reword_range = "";
+    size_t concurrency = 0;
+    size_t candidates = 1;
+    StatsQuery stats_query;
+    std::vector<std::string> stats_roots;
+    double requests_per_minute = -1.0;
     std::string backend = "openrouter";
     std::string config_path = get_config_path();
     std::string model = "";
     std::string user_commit_message = "";
     std::string provider = "";
     double temperature = 0.35;
+    std::string record_dir = "";
+    std::string replay_dir = "";
+    std::string replay_latency = "none";
+    bool replay_any = false;
+    std::string base_url = "";
+    std::string trace_path = "";
+    std::string metrics_export_path = "";
 
     app.set_help_flag("--help", "Print help message");
     app.footer("Configuration file location: " + config_path);
@@ -164,21 +270,49 @@ int main(int argc, char** argv) {
     app.add_flag("-q,--query-balance", query_balance, "Query available balance from the backend");
     app.add_flag("--configure", configure, "Configure the application interactively");
     app.add_flag("--time-run", time_run, "Time program execution and LLM query");
+    app.add_option("--export-metrics", metrics_export_path, "Write generation metrics from the global log in Prometheus text format to a file");
+    app.add_option("--trace", trace_path, "Write a Chrome trace of the run's phases to a file (chrome://tracing or ui.perfetto.dev)");
     app.add_flag("-s,--summary", preview_mode, "Generate commit message without committing (auto-includes all untracked files)");
     app.add_flag("--summarize-logs", summarize_logs, "Show summary of generation costs from the local git repository");
     app.add_flag("--summarize-global-logs", summarize_global_logs, "Show summary of generation costs from the global log");
+    app.add_option("--roots", stats_roots, "With --summarize-logs, summarize the logs of every repository under these directories");
+    app.add_option("--since", stats_query.since, "Only summarize log entries from this date on (YYYY-MM-DD)");
+    app.add_option("--until", stats_query.until, "Only summarize log entries up to this date (YYYY-MM-DD, inclusive)");
+    app.add_option("--group-by", stats_query.group_by, "Split log summaries by day or week (default: none)");
     app.add_flag("--push", push_flag, "Automatically push commits upstream after successful commit");
     app.add_flag("--list-configs", list_configs, "List all config files being read");
     app.add_flag("--repo-root", print_repo_root, "Print the git repository root directory");
-    app.add_option("-b,--backend", backend, "LLM backend: openrouter or zen");
+    app.add_flag("--count-tokens", count_tokens, "Count the input tokens for the current changes without sending them");
+    app.add_flag("--watch", watch, "Watch the worktree and pre-generate a message whenever it has been quiet for watch_quiet_seconds");
+    app.add_option("--reword", reword_range, "Regenerate the messages of a commit range ending at HEAD (e.g. main..HEAD)");
+    app.add_option("--candidates", candidates, "Generate N candidate messages and choose one (one request where the backend supports it)");
+    app.add_option("--concurrency", concurrency, "Maximum concurrent LLM requests for --reword");
+    app.add_option("--rpm", requests_per_minute, "Maximum LLM requests per minute for --reword (0 for no limit)");
+    std::string backend_names;
+    for (const auto& name : BackendRegistry::instance().names()) {
+        backend_names += (backend_names.empty() ? "" : ", ") + name;
+    }
+    app.add_option("-b,--backend", backend, "LLM backend: " + backend_names + " (default: from config)");
     app.add_option("--config", config_path, "Path to config file");
-    app.add_option("--model", model, "LLM model to use");
+    app.add_option("--model", model, "LLM model to use, or auto to pick from past latency and cost");
     app.add_option("-m,--message", user_commit_message, "Commit message (skips LLM generation)");
     app.add_option("--provider", provider, "Model provider to use");
     app.add_option("--temperature", temperature, "Temperature for chat generation (0.0-2.0)");
+    app.add_option("--base-url", base_url, "Override the backend API base URL (e.g. a local test server)");
+    app.add_flag("--no-daemon", no_daemon, "Run the backend in-process even when commitd is running");
+    app.add_option("--record", record_dir, "Save backend requests and responses to a fixture directory");
+    app.add_option("--replay", replay_dir, "Serve backend responses from a fixture directory instead of the network");
+    app.add_option("--replay-latency", replay_latency, "Simulated latency when replaying: none, recorded, fixed:MS, uniform:MIN:MAX or normal:MEAN:STDDEV");
+    app.add_flag("--replay-any", replay_any, "When replaying, serve the first recorded generation for requests that were not recorded");
 
     CLI11_PARSE(app, argc, argv);
 
+    if (time_run || !trace_path.empty()) {
+        Tracer::instance().enable();
+    }
+    // Declared before everything it traces, so it writes the file after their last span
+    TraceFile trace_file(trace_path);
+
     bool llm_generated = user_commit_message.empty();
 
     if (!user_commit_message.empty() && (query_balance || list_models)) {
@@ -186,6 +320,16 @@ int main(int argc, char** argv) {
         return 1;
     }
 
+    if (!user_commit_message.empty() && watch) {
+        std::cerr << "Error: -m (manual message) cannot be used with --watch" << std::endl;
+        return 1;
+    }
+
+    if (!user_commit_message.empty() && !reword_range.empty()) {
+        std::cerr << "Error: -m (manual message) cannot be used with --reword" << std::endl;
+        return 1;
+    }
+
     if (list_configs) {
         auto config_files = get_config_files(config_path);
         std::cout << "Config files being read:" << std::endl;
@@ -208,32 +352,22 @@ int main(int argc, char** argv) {
 
     if (llm_generated && (list_models || query_balance)) {
         Config config = Config::load_from_file(config_path);
-
-        char* env_openrouter = getenv("OPENROUTER_API_KEY");
-        if (env_openrouter && strlen(env_openrouter) > 0) {
-            config.openrouter_api_key = env_openrouter;
+        apply_api_key_env(config);
+        if (app.count("--backend") == 0) {
+            backend = config.backend;
         }
-        char* env_zen = getenv("ZEN_API_KEY");
-        if (env_zen && strlen(env_zen) > 0) {
-            config.zen_api_key = env_zen;
-        }
-
-        std::string api_key = (backend == "openrouter") ? config.openrouter_api_key : config.zen_api_key;
-        if (api_key.empty()) {
-            std::cerr << "Error: API key not found. Please configure with --configure or set OPENROUTER_API_KEY / ZEN_API_KEY environment variable." << std::endl;
+        const BackendInfo* info = BackendRegistry::instance().find(backend);
+        if (!info) {
+            std::cerr << "Unknown backend: " << backend << " (available: " << backend_names << ")" << std::endl;
             return 1;
         }
 
-        std::unique_ptr<LLMBackend> llm;
-        if (backend == "openrouter") {
-            llm = std::make_unique<OpenRouterBackend>();
-        } else if (backend == "zen") {
-            llm = std::make_unique<ZenBackend>();
-        } else {
-            std::cerr << "Unknown backend\n";
+        if (info->requires_api_key && (config.*info->api_key_field).empty() && replay_dir.empty()) {
+            std::cerr << "Error: API key not found. Please configure with --configure or set the " << info->api_key_env << " environment variable." << std::endl;
             return 1;
         }
-        llm->set_api_key(api_key);
+
+        std::unique_ptr<LLMBackend> llm = create_backend(*info, config, base_url, record_dir, replay_dir, replay_latency, replay_any, !no_daemon);
 
         auto start_total = std::chrono::high_resolution_clock::now();
         std::vector<GenerationResult> generations;
@@ -263,22 +397,41 @@ int main(int argc, char** argv) {
     }
 
     try {
+    if (!metrics_export_path.empty()) {
+        export_metrics(get_xdg_data_path() + "/generation_stats.log", metrics_export_path);
+        return 0;
+    }
+
+    if (!stats_roots.empty()) {
+        if (!summarize_logs) {
+            std::cerr << "--roots requires --summarize-logs" << std::endl;
+            return 1;
+        }
+        summarize_fleet_stats(stats_roots, stats_query);
+        if (summarize_global_logs) {
+            summarize_generation_stats(get_xdg_data_path() + "/generation_stats.log", stats_query);
+        }
+        return 0;
+    }
+
+    TraceSpan discovery_span("repo discovery");
     GitRepository repo;
     GitUtils git_utils(repo);
+    discovery_span.end();
 
     if (summarize_logs || summarize_global_logs) {
         if (summarize_logs) {
             std::string repo_root = repo.get_repo_root();
             if (!repo_root.empty()) {
                 std::string repo_log_path = repo.get_commit_dir() + "generation_stats.log";
-                summarize_generation_stats(repo_log_path);
+                summarize_generation_stats(repo_log_path, stats_query);
             } else {
                 std::cout << "Not in a git repository" << std::endl;
             }
         }
         if (summarize_global_logs) {
             std::string global_log_path = get_xdg_data_path() + "/generation_stats.log";
-            summarize_generation_stats(global_log_path);
+            summarize_generation_stats(global_log_path, stats_query);
         }
         return 0;
     }
@@ -290,14 +443,44 @@ int main(int argc, char** argv) {
         }
     }
 
+    std::string repo_root = repo.get_repo_root();
+    check_and_add_commit_to_gitignore(repo_root);
+
+    // The commit's git work does not depend on the config, so it runs on the stage pool while
+    // the config is loaded, the API key resolved and the backend connected. The stages
+    // capture these by reference, so they are declared before the graph that waits for them.
+    std::unique_ptr<LLMBackend> llm = nullptr;
+    StatusLists status;
+    std::string tracked_diff;
+    std::string untracked_diff;
+    ThreadPool stage_pool(4);  // Stages mostly wait on the disk and the network
+    StageGraph stages(stage_pool);
+    // Untracked files may be added with -s, or when the user is asked (neither -a nor -n)
+    bool consider_untracked = preview_mode || (!no_add && !add_files);
+    if (reword_range.empty() && !watch) {
+        stages.add("status", {}, [&] { status = git_utils.get_status(); });
+        stages.add("untracked read", {"status"}, [&] {
+            if (consider_untracked) {
+                untracked_diff = git_utils.get_untracked_diff(status.untracked);
+            }
+        });
+        // Own repository handle: libgit2 objects must not be used from two threads at once
+        stages.add("diff", {}, [&] {
+            GitRepository diff_repo;
+            tracked_diff = GitUtils(diff_repo).get_full_diff();
+        });
+    }
+
+    TraceSpan config_span("config load");
     Config config = Config::load_from_file(config_path);
+    config_span.end();
 
     if (time_run) {
         config.time_run = true;
     }
-
-    std::string repo_root = repo.get_repo_root();
-    check_and_add_commit_to_gitignore(repo_root);
+    if (config.time_run) {
+        Tracer::instance().enable();
+    }
 
     if (push_flag) {
         config.auto_push = true;
@@ -306,43 +489,48 @@ int main(int argc, char** argv) {
     auto start_total = std::chrono::high_resolution_clock::now();
 
     std::vector<GenerationResult> generations;
-    std::string api_key;
+    const BackendInfo* backend_info = nullptr;
 
     if (llm_generated) {
-        auto get_api_key = [&](const std::string& backend, Config& config, const std::string& config_path) {
-            std::string& config_key = (backend == "openrouter") ? config.openrouter_api_key : config.zen_api_key;
-            if (!config_key.empty()) {
+        auto get_api_key = [&](const BackendInfo& info, Config& config, const std::string& config_path) {
+            std::string& config_key = config.*info.api_key_field;
+            if (!config_key.empty() || !info.requires_api_key) {
                 return;
             }
-            std::cout << Colors::YELLOW << "Enter API key for " << backend << ": " << Colors::RESET;
+            std::cout << Colors::YELLOW << "Enter API key for " << info.name << ": " << Colors::RESET;
             std::cin >> config_key;
-            config.backend = backend;
+            config.backend = info.name;
             std::filesystem::create_directories(std::filesystem::path(config_path).parent_path());
             std::ofstream file(config_path);
             file << "backend=" << config.backend << "\n";
             file << "model=" << config.model << "\n";
             file << "instructions=" << config.llm_instructions << "\n";
             file << "auto_push=" << (config.auto_push ? "true" : "false") << "\n";
-            if (!config.openrouter_api_key.empty()) file << "openrouter_api_key=" << config.openrouter_api_key << "\n";
-            if (!config.zen_api_key.empty()) file << "zen_api_key=" << config.zen_api_key << "\n";
+            for (const auto& name : BackendRegistry::instance().names()) {
+                const std::string& key = config.*BackendRegistry::instance().get(name).api_key_field;
+                if (!key.empty()) file << name << "_api_key=" << key << "\n";
+            }
         };
 
         try {
-            char* env_openrouter = getenv("OPENROUTER_API_KEY");
-            if (env_openrouter && strlen(env_openrouter) > 0) {
-                config.openrouter_api_key = env_openrouter;
-            }
-            char* env_zen = getenv("ZEN_API_KEY");
-            if (env_zen && strlen(env_zen) > 0) {
-                config.zen_api_key = env_zen;
-            }
+            apply_api_key_env(config);
 
+            if (app.count("--backend") == 0) {
+                backend = config.backend;
+            }
             if (backend == "openrouter" && config.openrouter_api_key.empty() && !config.zen_api_key.empty()) {
                 backend = "zen";
             }
+            backend_info = &BackendRegistry::instance().get(backend);
+            // Log the backend actually used, which may differ from the config file
+            config.backend = backend;
 
-            get_api_key(backend, config, config_path);
-            api_key = (backend == "openrouter") ? config.openrouter_api_key : config.zen_api_key;
+            if (replay_dir.empty() && !count_tokens) {
+                get_api_key(*backend_info, config, config_path);
+            } else {
+                // Replayed runs are logged separately from real spending
+                config.backend = "replay";
+            }
 
             if (!model.empty()) {
                 config.model = model;
@@ -366,91 +554,155 @@ int main(int argc, char** argv) {
         }
     }
 
-    auto tracked_modified = git_utils.get_tracked_modified_files();
-    auto unstaged_modified = git_utils.get_unstaged_files();
+    // Connects while the git stages run; the config is copied since model=auto may still change it
+    bool backend_staged = llm_generated && !count_tokens;
+    if (backend_staged) {
+        stages.add("backend", {}, [&, info = backend_info, backend_config = config] {
+            llm = create_backend(*info, backend_config, base_url, record_dir, replay_dir, replay_latency, replay_any, !no_daemon);
+            llm->warm_up();
+        });
+    }
+
+    auto wait_for_backend = [&] {
+        if (backend_staged) stages.wait("backend");
+    };
+
+    if (!reword_range.empty()) {
+        wait_for_backend();
+        TimingGuard guard(config.time_run, config, generations, llm, repo.get_repo_root(), dry_run, llm_generated);
+        RewordOptions options;
+        options.range = reword_range;
+        options.concurrency = concurrency > 0 ? concurrency : config.concurrency;
+        options.requests_per_minute = requests_per_minute >= 0 ? requests_per_minute : config.requests_per_minute;
+        options.dry_run = dry_run || preview_mode;
+        auto start_llm = std::chrono::high_resolution_clock::now();
+        int rc = reword_commits(repo, *llm, config, options, generations);
+        auto end_llm = std::chrono::high_resolution_clock::now();
+        guard.set_llm_time(std::chrono::duration_cast<std::chrono::milliseconds>(end_llm - start_llm).count());
+        return rc;
+    }
+
+    if (watch) {
+        wait_for_backend();
+        return watch_worktree(repo, git_utils, config, llm, fit_request);
+    }
+
+    stages.wait("status");
     std::vector<std::string> untracked;
     bool should_add_untracked = add_files || preview_mode;
-    if (!no_add && !add_files && !preview_mode) {
-        untracked = git_utils.get_untracked_files();
-        if (!untracked.empty()) {
-            std::cout << Colors::GREEN << "Untracked files:" << Colors::RESET << "\n";
-            for (const auto& f : untracked) {
-                std::cout << "  " << f << "\n";
-            }
-            std::cout << Colors::YELLOW << "Add all to staging? [Y/n]: " << Colors::RESET;
-            std::string response;
-            std::getline(std::cin, response);
-            should_add_untracked = response.empty() || (response.size() > 0 && (response[0] == 'y' || response[0] == 'Y'));
+    if (consider_untracked) {
+        untracked = status.untracked;
+    }
+    if (!no_add && !add_files && !preview_mode && !untracked.empty()) {
+        std::cout << Colors::GREEN << "Untracked files:" << Colors::RESET << "\n";
+        for (const auto& f : untracked) {
+            std::cout << "  " << f << "\n";
         }
-    } else if (preview_mode) {
-        untracked = git_utils.get_untracked_files();
+        std::cout << Colors::YELLOW << "Add all to staging? [Y/n]: " << Colors::RESET;
+        std::string response;
+        std::getline(std::cin, response);
+        should_add_untracked = response.empty() || (response.size() > 0 && (response[0] == 'y' || response[0] == 'Y'));
     }
 
-    std::vector<std::string> files_to_add = tracked_modified;
-    files_to_add.insert(files_to_add.end(), unstaged_modified.begin(), unstaged_modified.end());
+    std::vector<std::string> files_to_add = status.staged;
+    files_to_add.insert(files_to_add.end(), status.unstaged.begin(), status.unstaged.end());
     if (should_add_untracked) {
         files_to_add.insert(files_to_add.end(), untracked.begin(), untracked.end());
     }
 
-    std::string diff = git_utils.get_full_diff();
-    // Append diffs for untracked files to be added
-    for (const auto& file : files_to_add) {
-        if (std::find(untracked.begin(), untracked.end(), file) != untracked.end()) {
-            std::ifstream file_stream(file);
-            if (!file_stream) continue;
-            std::stringstream content;
-            content << file_stream.rdbuf();
-            std::string file_content = content.str();
-            size_t line_count = std::count(file_content.begin(), file_content.end(), '\n') + (file_content.empty() ? 0 : 1);
-            diff += "diff --git a/" + file + " b/" + file + "\n";
-            diff += "new file mode 100644\n";
-            diff += "index 0000000..e69de29\n";
-            diff += "--- /dev/null\n";
-            diff += "+++ b/" + file + "\n";
-            diff += "@@ -0,0 +1," + std::to_string(line_count) + " @@\n";
-            std::istringstream iss(file_content);
-            std::string line;
-            while (std::getline(iss, line)) {
-                diff += "+" + line + "\n";
-            }
-            if (!file_content.empty() && file_content.back() != '\n') {
-                diff += "\n\\ No newline at end of file\n";
-            }
-        }
+    stages.wait("diff");
+    stages.wait("untracked read");
+    std::string diff = tracked_diff;
+    if (should_add_untracked) {
+        diff += untracked_diff;
     }
     if (diff.empty() && files_to_add.empty()) {
         std::cout << "No changes to commit\n";
         return 0;
     }
 
-    std::unique_ptr<LLMBackend> llm = nullptr;
-    if (llm_generated) {
-        if (backend == "openrouter") {
-            llm = std::make_unique<OpenRouterBackend>();
-        } else if (backend == "zen") {
-            llm = std::make_unique<ZenBackend>();
+    if (count_tokens) {
+        std::string vocab_path;
+        BpeTokenizer tokenizer = load_tokenizer(config, vocab_path);
+        size_t instruction_tokens = tokenizer.count(config.llm_instructions) + tokenizer.count("\n\nDiff:\n");
+        size_t diff_tokens = tokenizer.count(diff);
+        std::cout << Colors::GREEN << "Input tokens: " << Colors::RESET << instruction_tokens + diff_tokens;
+        if (tokenizer.has_vocab()) {
+            std::cout << " (" << tokenizer.name() << ")\n";
         } else {
-            std::cerr << "Unknown backend\n";
-            return 1;
+            std::cout << " (estimated, no tokenizer vocabulary at " << vocab_path << ")\n";
         }
-        llm->set_api_key(api_key);
+        std::cout << "  Instructions: " << instruction_tokens << "\n";
+        std::cout << "  Diff: " << diff_tokens << "\n";
+        if (config.max_input_tokens > 0) {
+            std::cout << "  Budget: " << config.max_input_tokens << "\n";
+        }
+        return 0;
+    }
+
+    // A message pre-generated by `commit --watch` for exactly this request is used as is
+    std::string pregenerated_key;
+    std::optional<GenerationResult> pregenerated;
+    if (llm_generated && candidates <= 1 && record_dir.empty() && replay_dir.empty()) {
+        pregenerated_key = pregeneration_key(diff, config);
+        pregenerated = load_pregenerated(repo.get_commit_dir(), pregenerated_key);
+    }
+
+    if (llm_generated && !pregenerated && !fit_request(config, diff)) {
+        return 1;
+    }
+
+    wait_for_backend();
+    if (auto* daemon = dynamic_cast<DaemonClientBackend*>(llm.get())) {
+        daemon->set_preview(preview_mode || dry_run);
+    }
+
+    // With --push, origin is connected to while the message is generated, so a diverged
+    // upstream is known before committing and the push itself only sends the pack
+    std::future<std::unique_ptr<PreparedPush>> push_preparation;
+    std::unique_ptr<PreparedPush> prepared_push;
+    if (!preview_mode && !dry_run && config.auto_push) {
+        push_preparation = git_utils.prepare_push();
     }
 
     TimingGuard guard(config.time_run, config, generations, llm, repo.get_repo_root(), dry_run, llm_generated);
 
     std::string commit_msg;
-    if (llm_generated) {
-        GenerationResult generation_result;
-        {
-            Spinner spinner("Generating commit message...");
-            auto start_llm = std::chrono::high_resolution_clock::now();
-            generation_result = llm->generate_commit_message(diff, config.llm_instructions, config.model, config.provider, config.temperature);
-            auto end_llm = std::chrono::high_resolution_clock::now();
-            auto llm_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end_llm - start_llm).count();
-            guard.set_llm_time(llm_ms);
-            generations.push_back(generation_result);
+    if (pregenerated) {
+        std::cout << Colors::GREEN << "Using the message pre-generated by --watch" << Colors::RESET << std::endl;
+        commit_msg = pregenerated->content;
+    } else if (llm_generated) {
+        if (candidates > 1) {
+            std::vector<GenerationResult> results;
+            {
+                Spinner spinner("Generating " + std::to_string(candidates) + " candidate messages...");
+                TraceSpan span("generate");
+                auto start_llm = std::chrono::high_resolution_clock::now();
+                results = generate_candidates(*llm, diff, config.llm_instructions, config.model, config.provider, config.temperature, candidates);
+                auto end_llm = std::chrono::high_resolution_clock::now();
+                guard.set_llm_time(std::chrono::duration_cast<std::chrono::milliseconds>(end_llm - start_llm).count());
+            }
+            generations.insert(generations.end(), results.begin(), results.end());
+            std::optional<size_t> choice = select_candidate(results);
+            if (!choice) {
+                std::cout << "Aborted; nothing committed" << std::endl;
+                return 1;
+            }
+            commit_msg = results[*choice].content;
+        } else {
+            GenerationResult generation_result;
+            {
+                Spinner spinner("Generating commit message...");
+                TraceSpan span("generate");
+                auto start_llm = std::chrono::high_resolution_clock::now();
+                generation_result = llm->generate_commit_message(diff, config.llm_instructions, config.model, config.provider, config.temperature);
+                auto end_llm = std::chrono::high_resolution_clock::now();
+                auto llm_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end_llm - start_llm).count();
+                guard.set_llm_time(llm_ms);
+                generations.push_back(generation_result);
+            }
+            commit_msg = generation_result.content;
         }
-        commit_msg = generation_result.content;
     } else {
         commit_msg = user_commit_message;
     }
@@ -476,9 +728,21 @@ int main(int argc, char** argv) {
         std::cout << Colors::GREEN << "[DRY RUN] Would commit with message:" << Colors::RESET << std::endl;
         std::cout << commit_msg << std::endl;
     } else {
+        if (push_preparation.valid()) {
+            prepared_push = push_preparation.get();
+            if (prepared_push->diverged) {
+                std::cout << Colors::YELLOW << "Warning: origin has commits this branch does not contain; committing without pushing." << Colors::RESET << std::endl;
+                std::cout << Colors::YELLOW << "Suggestion: Pull upstream changes with 'git pull' before pushing." << Colors::RESET << std::endl;
+            }
+        }
         try {
             git_utils.add_files(files_to_add);
+            auto start_commit = std::chrono::steady_clock::now();
             auto [hash, output] = git_utils.commit_with_output(commit_msg);
+            guard.set_commit_time(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_commit).count());
+            if (pregenerated) {
+                remove_pregenerated(repo.get_commit_dir(), pregenerated_key);
+            }
             std::cout << std::endl;
             if (!hash.empty()) {
                 std::cout << Colors::BLUE << hash << Colors::RESET << " ";
@@ -491,9 +755,11 @@ int main(int argc, char** argv) {
         }
     }
 
-    if (!preview_mode && !dry_run && config.auto_push) {
+    if (!preview_mode && !dry_run && config.auto_push && !(prepared_push && prepared_push->diverged)) {
         try {
-            git_utils.push();
+            auto start_push = std::chrono::steady_clock::now();
+            git_utils.push(prepared_push.get());
+            guard.set_push_time(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_push).count());
             std::cout << Colors::GREEN << "Changes pushed upstream successfully." << Colors::RESET << std::endl;
         } catch (const std::runtime_error& e) {
             std::string error_msg = e.what();
@@ -0,0 +1,118 @@
+#include "metrics_exporter.hpp"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace {
+
+std::string escape_label(const std::string& value) {
+    std::string escaped;
+    escaped.reserve(value.size());
+    for (char c : value) {
+        switch (c) {
+            case '\\': escaped += "\\\\"; break;
+            case '"': escaped += "\\\""; break;
+            case '\n': escaped += "\\n"; break;
+            default: escaped += c;
+        }
+    }
+    return escaped;
+}
+
+std::string labels_of(const SeriesKey& key) {
+    const auto& [backend, model, provider] = key;
+    return "backend=\"" + escape_label(backend) + "\",model=\"" + escape_label(model) + "\",provider=\"" + escape_label(provider) + "\"";
+}
+
+void family(std::ostringstream& out, const char* name, const char* type, const char* help) {
+    out << "# HELP " << name << " " << help << "\n";
+    out << "# TYPE " << name << " " << type << "\n";
+}
+
+// Cumulative `_bucket` samples plus `_sum` and `_count`; `labels` may be empty
+void histogram(std::ostringstream& out, const char* name, const std::string& labels, const Buckets& buckets, std::span<const double> bounds) {
+    std::string prefix = labels.empty() ? "{" : "{" + labels + ",";
+    long long cumulative = 0;
+    for (size_t i = 0; i < bounds.size(); ++i) {
+        cumulative += i < buckets.counts.size() ? buckets.counts[i] : 0;
+        out << name << "_bucket" << prefix << "le=\"" << bounds[i] << "\"} " << cumulative << "\n";
+    }
+    out << name << "_bucket" << prefix << "le=\"+Inf\"} " << buckets.count << "\n";
+    std::string suffix = labels.empty() ? "" : "{" + labels + "}";
+    out << name << "_sum" << suffix << " " << buckets.sum << "\n";
+    out << name << "_count" << suffix << " " << buckets.count << "\n";
+}
+
+} // namespace
+
+std::string format_metrics(const StatsSummary& summary) {
+    std::ostringstream out;
+    out.precision(15);
+
+    struct Counter {
+        const char* name;
+        const char* help;
+        double SeriesTotals::* value;
+        long long SeriesTotals::* count;
+    };
+    const Counter counters[] = {
+        {"commit_generations_total", "LLM generations logged, including dry runs", nullptr, &SeriesTotals::count},
+        {"commit_dry_run_generations_total", "LLM generations logged by dry runs", nullptr, &SeriesTotals::dry_run_count},
+        {"commit_input_tokens_total", "Input tokens sent", &SeriesTotals::input_tokens, nullptr},
+        {"commit_output_tokens_total", "Output tokens generated", &SeriesTotals::output_tokens, nullptr},
+        {"commit_cost_dollars_total", "Cost reported by the backend, in US dollars", &SeriesTotals::cost, nullptr},
+        {"commit_prompt_cache_hits_total", "Generations that read part of the prompt from the provider's cache", nullptr, &SeriesTotals::cache_hits},
+        {"commit_prompt_cached_tokens_total", "Input tokens read from the provider's prompt cache", &SeriesTotals::cached_tokens, nullptr},
+    };
+    for (const auto& counter : counters) {
+        family(out, counter.name, "counter", counter.help);
+        for (const auto& [key, totals] : summary.series) {
+            out << counter.name << "{" << labels_of(key) << "} ";
+            if (counter.value) {
+                out << totals.*counter.value;
+            } else {
+                out << totals.*counter.count;
+            }
+            out << "\n";
+        }
+    }
+
+    family(out, "commit_generation_latency_seconds", "histogram", "Generation latency reported by the backend, or the client's request time");
+    for (const auto& [key, totals] : summary.series) {
+        histogram(out, "commit_generation_latency_seconds", labels_of(key), totals.latency, LATENCY_BUCKETS);
+    }
+    family(out, "commit_git_commit_duration_seconds", "histogram", "Time to write the commit, per run");
+    histogram(out, "commit_git_commit_duration_seconds", "", summary.commit_time, GIT_BUCKETS);
+    family(out, "commit_git_push_duration_seconds", "histogram", "Time to push upstream, per run");
+    histogram(out, "commit_git_push_duration_seconds", "", summary.push_time, GIT_BUCKETS);
+    return out.str();
+}
+
+void export_metrics(const std::string& log_path, const std::string& output_path) {
+    StatsSummary summary;
+    if (std::filesystem::exists(log_path)) {
+        summary = StatsStore(log_path, StatsStore::Access::ReadOnly).summary();
+    }
+    std::string content = format_metrics(summary);
+
+    // The textfile collector only reads `*.prom`, so the temporary name is never picked up
+    std::string tmp = output_path + ".tmp." + std::to_string(::getpid());
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        out << content;
+        out.flush();
+        if (!out) {
+            std::remove(tmp.c_str());
+            throw std::runtime_error("Failed to write metrics to " + tmp);
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, output_path, ec);
+    if (ec) {
+        std::remove(tmp.c_str());
+        throw std::runtime_error("Failed to replace " + output_path + ": " + ec.message());
+    }
+}
@@ -0,0 +1,111 @@
+#include "model_router.hpp"
+#include "colors.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+std::string format_ms(double ms) {
+    if (ms < 0) return "n/a";
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(2) << ms / 1000.0 << "s";
+    return ss.str();
+}
+
+std::string format_cost(double cost) {
+    if (cost < 0) return "n/a";
+    std::stringstream ss;
+    ss << "$" << std::fixed << std::setprecision(5) << cost;
+    return ss.str();
+}
+
+std::string pair_name(const std::string& model, const std::string& provider) {
+    return provider.empty() ? model : model + " (provider: " + provider + ")";
+}
+
+} // namespace
+
+RouteDecision route_model(const std::map<SeriesKey, SeriesTotals>& series, const std::string& backend, const std::string& provider, size_t input_tokens, const RoutingPolicy& policy) {
+    struct PairHistory {
+        HdrHistogram request_ms{3600000, 2};
+        CostFit cost_fit;
+        long long samples = 0;
+    };
+    std::map<std::pair<std::string, std::string>, PairHistory> pairs;
+    for (const auto& [key, totals] : series) {
+        const auto& [series_backend, model, series_provider] = key;
+        if (series_backend != backend || model.empty() || model == "auto" || model == "unknown") continue;
+        if (!provider.empty() && series_provider != provider) continue;
+        PairHistory& h = pairs[{model, series_provider}];
+        h.samples += totals.count;
+        h.request_ms.add(totals.request_ms);
+        h.cost_fit.add(totals.cost_fit);
+    }
+    if (pairs.empty()) {
+        throw std::runtime_error("model=auto needs generation history for backend '" + backend + "'; run with an explicit --model first");
+    }
+
+    RouteDecision decision;
+    for (const auto& [key, h] : pairs) {
+        RouteCandidate c;
+        c.model = key.first;
+        c.provider = key.second;
+        c.samples = static_cast<size_t>(h.samples);
+        c.latency_ms = h.request_ms.count() > 0 ? static_cast<double>(h.request_ms.value_at_percentile(policy.percentile)) : -1.0;
+        c.expected_cost = h.cost_fit.expected(static_cast<double>(input_tokens));
+        c.meets_slo = h.request_ms.count() >= policy.min_samples && c.latency_ms >= 0 && c.latency_ms <= policy.latency_slo_ms;
+        decision.candidates.push_back(c);
+    }
+
+    // Within the SLO: known cost ascending, then latency. Outside it: enough history, then
+    // latency, so the fallback is the fastest whatever its cost data.
+    std::sort(decision.candidates.begin(), decision.candidates.end(), [&policy](const RouteCandidate& a, const RouteCandidate& b) {
+        if (a.meets_slo != b.meets_slo) return a.meets_slo;
+        if (a.meets_slo) {
+            bool a_costed = a.expected_cost >= 0;
+            bool b_costed = b.expected_cost >= 0;
+            if (a_costed != b_costed) return a_costed;
+            if (a_costed && a.expected_cost != b.expected_cost) return a.expected_cost < b.expected_cost;
+        } else {
+            bool a_proven = a.samples >= policy.min_samples;
+            bool b_proven = b.samples >= policy.min_samples;
+            if (a_proven != b_proven) return a_proven;
+        }
+        double a_latency = a.latency_ms < 0 ? INFINITY : a.latency_ms;
+        double b_latency = b.latency_ms < 0 ? INFINITY : b.latency_ms;
+        if (a_latency != b_latency) return a_latency < b_latency;
+        return a.samples > b.samples;
+    });
+
+    const RouteCandidate& best = decision.candidates.front();
+    decision.model = best.model;
+    decision.provider = best.provider;
+    std::stringstream reason;
+    reason << std::fixed << std::setprecision(0);
+    if (best.meets_slo) {
+        size_t eligible = std::count_if(decision.candidates.begin(), decision.candidates.end(), [](const RouteCandidate& c) { return c.meets_slo; });
+        reason << "lowest expected cost (" << format_cost(best.expected_cost) << ") of " << eligible << " candidate"
+               << (eligible == 1 ? "" : "s") << " with p" << policy.percentile << " latency under " << format_ms(policy.latency_slo_ms);
+    } else {
+        reason << "no candidate has p" << policy.percentile << " latency under " << format_ms(policy.latency_slo_ms) << " over "
+               << policy.min_samples << "+ samples; using the fastest";
+    }
+    decision.reason = reason.str();
+    return decision;
+}
+
+void print_route_decision(const RouteDecision& decision, const RoutingPolicy& policy, size_t input_tokens) {
+    std::cout << Colors::BLUE << "Auto model: " << pair_name(decision.model, decision.provider) << Colors::RESET << std::endl;
+    std::cout << Colors::BLUE << "  Reason: " << decision.reason << " for " << input_tokens << " input tokens" << Colors::RESET << std::endl;
+    for (const auto& c : decision.candidates) {
+        std::cout << "  " << (c.meets_slo ? "+ " : "- ") << pair_name(c.model, c.provider)
+                  << ": p" << std::fixed << std::setprecision(0) << policy.percentile << " " << format_ms(c.latency_ms)
+                  << ", expected " << format_cost(c.expected_cost)
+                  << ", " << c.samples << " sample" << (c.samples == 1 ? "" : "s") << std::endl;
+    }
+}
@@ -0,0 +1,344 @@
+#include "pregenerate.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <vector>
+#include <git2.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include "colors.hpp"
+#include "commit_message.hpp"
+#include "daemon_protocol.hpp"
+#include "statistics.hpp"
+#include "tokenizer.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr size_t MAX_PREGENERATED = 32;
+constexpr uint32_t WORKTREE_EVENTS = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | IN_ONLYDIR;
+// Staging, committing and checkouts rewrite these by renaming a lock file over them
+constexpr uint32_t GIT_DIR_EVENTS = IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR;
+
+std::atomic<bool> stopping{false};
+
+fs::path pregenerated_path(const std::string& commit_dir, const std::string& key) {
+    return fs::path(commit_dir) / "pregenerated" / (key + ".json");
+}
+
+// Keeps the MAX_PREGENERATED most recently written messages
+void prune_pregenerated(const fs::path& dir) {
+    std::error_code ec;
+    std::vector<std::pair<fs::file_time_type, fs::path>> files;
+    for (const auto& entry : fs::directory_iterator(dir, ec)) {
+        if (entry.path().extension() == ".json") {
+            files.emplace_back(entry.last_write_time(ec), entry.path());
+        }
+    }
+    if (files.size() <= MAX_PREGENERATED) return;
+    std::sort(files.begin(), files.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+    for (size_t i = MAX_PREGENERATED; i < files.size(); ++i) {
+        fs::remove(files[i].second, ec);
+    }
+}
+
+// Turns inotify events below the repository root into "something a commit would see changed".
+// Directories are watched individually; .git, .commit and ignored directories are skipped, and
+// new directories are picked up as they appear.
+class WorktreeWatcher {
+public:
+    explicit WorktreeWatcher(GitRepository& repo) : repo_(repo.get_repo()), root_(repo.get_repo_root()) {
+        fd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd_ < 0) {
+            throw std::runtime_error(std::string("inotify_init1 failed: ") + std::strerror(errno));
+        }
+        git_wd_ = ::inotify_add_watch(fd_, git_repository_path(repo_), GIT_DIR_EVENTS);
+        if (git_wd_ < 0) {
+            ::close(fd_);
+            throw std::runtime_error(std::string("Cannot watch the git directory: ") + std::strerror(errno));
+        }
+        add_tree("");
+    }
+
+    ~WorktreeWatcher() { ::close(fd_); }
+
+    int fd() const { return fd_; }
+    size_t directories() const { return dirs_.size(); }
+
+    // Drains the pending events; true when any of them can change the diff
+    bool read_events() {
+        bool changed = false;
+        alignas(inotify_event) char buffer[65536];
+        while (true) {
+            ssize_t n = ::read(fd_, buffer, sizeof(buffer));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            for (char* p = buffer; p < buffer + n;) {
+                const auto* event = reinterpret_cast<const inotify_event*>(p);
+                p += sizeof(inotify_event) + event->len;
+                changed = handle(*event) || changed;
+            }
+        }
+        return changed;
+    }
+
+private:
+    git_repository* repo_;
+    fs::path root_;
+    int fd_;
+    int git_wd_;
+    std::map<int, std::string> dirs_;  // Watch descriptor to directory, relative to the root
+    bool warned_limit_ = false;
+
+    static bool skipped(const std::string& name) {
+        return name == ".git" || name == ".commit";
+    }
+
+    bool ignored(const std::string& relative, bool is_dir) const {
+        int ignored = 0;
+        std::string path = is_dir ? relative + "/" : relative;
+        return git_ignore_path_is_ignored(&ignored, repo_, path.c_str()) == 0 && ignored;
+    }
+
+    void add_tree(const std::string& relative) {
+        add_directory(relative);
+        std::error_code ec;
+        for (fs::recursive_directory_iterator it(root_ / relative, fs::directory_options::skip_permission_denied, ec), end; !ec && it != end; it.increment(ec)) {
+            if (!it->is_directory(ec) || it->is_symlink(ec)) continue;
+            std::string path = it->path().lexically_relative(root_).string();
+            if (skipped(it->path().filename().string()) || ignored(path, true)) {
+                it.disable_recursion_pending();
+                continue;
+            }
+            add_directory(path);
+        }
+    }
+
+    void add_directory(const std::string& relative) {
+        int wd = ::inotify_add_watch(fd_, (root_ / relative).c_str(), WORKTREE_EVENTS);
+        if (wd >= 0) {
+            dirs_[wd] = relative;
+        } else if (errno == ENOSPC && !warned_limit_) {
+            warned_limit_ = true;
+            std::cout << Colors::YELLOW << "Warning: inotify watch limit reached; changes in some directories will go unnoticed"
+                      << " (raise fs.inotify.max_user_watches)" << Colors::RESET << std::endl;
+        }
+    }
+
+    bool handle(const inotify_event& event) {
+        if (event.mask & IN_Q_OVERFLOW) {
+            return true;
+        }
+        std::string name = event.len > 0 ? event.name : "";
+        if (event.wd == git_wd_) {
+            return name == "index" || name == "HEAD";
+        }
+        auto it = dirs_.find(event.wd);
+        if (it == dirs_.end()) return false;
+        if (event.mask & IN_IGNORED) {
+            dirs_.erase(it);
+            return false;
+        }
+        if (name.empty() || skipped(name)) return false;
+        std::string path = it->second.empty() ? name : it->second + "/" + name;
+        bool is_dir = event.mask & IN_ISDIR;
+        if (ignored(path, is_dir)) return false;
+        if (is_dir && (event.mask & (IN_CREATE | IN_MOVED_TO))) {
+            add_tree(path);
+        }
+        return true;
+    }
+};
+
+std::string first_line(const std::string& message) {
+    std::string cleaned = clean_commit_message(message);
+    return cleaned.substr(0, cleaned.find('\n'));
+}
+
+} // namespace
+
+std::string pregeneration_key(const std::string& diff, const Config& config) {
+    std::ostringstream request;
+    request << config.backend << '\n' << config.model << '\n' << config.provider << '\n' << config.temperature << '\n'
+            << config.max_input_tokens << '\n' << config.oversize_action << '\n' << config.llm_instructions << '\n' << diff;
+    std::string data = request.str();
+    git_oid oid;
+    if (git_odb_hash(&oid, data.data(), data.size(), GIT_OBJECT_BLOB) != 0) {
+        throw std::runtime_error("Failed to hash the request");
+    }
+    char hex[GIT_OID_HEXSZ + 1];
+    git_oid_tostr(hex, sizeof(hex), &oid);
+    return hex;
+}
+
+std::optional<GenerationResult> load_pregenerated(const std::string& commit_dir, const std::string& key) {
+    std::ifstream file(pregenerated_path(commit_dir, key));
+    if (!file) {
+        return std::nullopt;
+    }
+    try {
+        GenerationResult result = result_from_json(nlohmann::json::parse(file));
+        if (result.content.empty()) {
+            return std::nullopt;
+        }
+        result.shared_request = true;
+        result.http = HttpTiming();
+        return result;
+    } catch (const nlohmann::json::exception&) {
+        return std::nullopt;
+    }
+}
+
+void store_pregenerated(const std::string& commit_dir, const std::string& key, const GenerationResult& result) {
+    fs::path path = pregenerated_path(commit_dir, key);
+    fs::create_directories(path.parent_path());
+    fs::path tmp = path;
+    tmp += ".tmp." + std::to_string(::getpid());
+    {
+        std::ofstream file(tmp);
+        file << result_to_json(result).dump() << "\n";
+        if (!file) {
+            throw std::runtime_error("Failed to write " + tmp.string());
+        }
+    }
+    fs::rename(tmp, path);
+    prune_pregenerated(path.parent_path());
+}
+
+void remove_pregenerated(const std::string& commit_dir, const std::string& key) {
+    std::error_code ec;
+    fs::remove(pregenerated_path(commit_dir, key), ec);
+}
+
+int watch_worktree(GitRepository& repo, GitUtils& git_utils, const Config& config, std::unique_ptr<LLMBackend>& llm, const FitRequest& fit_request) {
+    std::signal(SIGINT, [](int) { stopping = true; });
+    std::signal(SIGTERM, [](int) { stopping = true; });
+
+    WorktreeWatcher watcher(repo);
+    auto quiet = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(std::max(0.0, config.watch_quiet_seconds)));
+    std::cout << Colors::GREEN << "Watching " << watcher.directories() << " directories in " << repo.get_repo_root() << Colors::RESET << std::endl;
+    std::cout << "Messages are pre-generated after " << config.watch_quiet_seconds << " s without changes";
+    if (config.watch_budget > 0) {
+        std::cout << ", up to $" << std::fixed << std::setprecision(2) << config.watch_budget << std::defaultfloat;
+    }
+    std::cout << " (Ctrl-C to stop)" << std::endl;
+
+    // Per-model cost history from the global stats log, to price generations whose backend
+    // reports no cost and to check the budget before starting one
+    std::map<std::pair<std::string, std::string>, CostFit> prices;
+    if (config.watch_budget > 0) {
+        for (const auto& [key, totals] : read_stats_summary(get_xdg_data_path() + "/generation_stats.log").series) {
+            if (std::get<0>(key) == config.backend) {
+                prices[{std::get<1>(key), std::get<2>(key)}].add(totals.cost_fit);
+            }
+        }
+    }
+    auto price = [&prices](const std::string& model, const std::string& provider) {
+        auto it = prices.find({model, provider});
+        return it == prices.end() ? CostFit() : it->second;
+    };
+
+    // The state at startup counts as a change, so it gets a message once the tree is quiet
+    bool dirty = true;
+    auto last_change = std::chrono::steady_clock::now();
+    std::string last_key;
+    std::future<double> pending;
+    double spent = 0.0;
+
+    while (!stopping) {
+        int timeout_ms = 500;  // Recheck `stopping` at least this often
+        if (dirty) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(last_change + quiet - std::chrono::steady_clock::now()).count();
+            timeout_ms = static_cast<int>(std::clamp<long long>(remaining, 0, timeout_ms));
+        }
+        pollfd pfd{watcher.fd(), POLLIN, 0};
+        if (::poll(&pfd, 1, timeout_ms) > 0 && watcher.read_events()) {
+            dirty = true;
+            last_change = std::chrono::steady_clock::now();
+        }
+        if (pending.valid() && pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            double cost = pending.get();
+            if (cost < 0) {
+                std::cout << Colors::YELLOW << "The backend reported no cost and there is no cost history for the model to estimate it;"
+                          << " stopping, as watch_budget cannot be enforced" << Colors::RESET << std::endl;
+                return 0;
+            }
+            spent += cost;
+            if (config.watch_budget > 0 && spent >= config.watch_budget) {
+                std::cout << Colors::YELLOW << "Spent $" << std::fixed << std::setprecision(4) << spent << std::defaultfloat
+                          << " of watch_budget; stopping" << Colors::RESET << std::endl;
+                return 0;
+            }
+        }
+        // One generation at a time; changes made meanwhile are picked up when it finishes
+        if (!dirty || pending.valid() || std::chrono::steady_clock::now() - last_change < quiet) {
+            continue;
+        }
+        dirty = false;
+
+        // Untracked files are included, as when the commit's "Add all to staging?" is answered yes
+        std::string diff = git_utils.get_full_diff() + git_utils.get_untracked_diff(git_utils.get_untracked_files());
+        if (diff.empty()) continue;
+        std::string key = pregeneration_key(diff, config);
+        if (key == last_key || fs::exists(pregenerated_path(repo.get_commit_dir(), key))) continue;
+        if (config.watch_budget > 0 && config.model != "auto") {
+            double next = price(config.model, config.provider).expected(static_cast<double>(estimate_tokens(config.llm_instructions) + estimate_tokens(diff)));
+            if (next >= 0 && spent + next > config.watch_budget) {
+                std::cout << Colors::YELLOW << "The next message would cost about $" << std::fixed << std::setprecision(4) << next << ", over the $"
+                          << config.watch_budget - spent << std::defaultfloat << " left of watch_budget; stopping" << Colors::RESET << std::endl;
+                return 0;
+            }
+        }
+        last_key = key;
+
+        pending = std::async(std::launch::async, [&, key, diff]() mutable -> double {
+            Config request = config;
+            try {
+                if (!fit_request(request, diff)) return 0.0;
+                std::vector<GenerationResult> generations;
+                TimingGuard guard(false, request, generations, llm, repo.get_repo_root());
+                auto start_llm = std::chrono::high_resolution_clock::now();
+                GenerationResult result = llm->generate_commit_message(diff, request.llm_instructions, request.model, request.provider, request.temperature);
+                auto end_llm = std::chrono::high_resolution_clock::now();
+                guard.set_llm_time(std::chrono::duration_cast<std::chrono::milliseconds>(end_llm - start_llm).count());
+                generations.push_back(result);
+                store_pregenerated(repo.get_commit_dir(), key, result);
+                double cost = result.total_cost;
+                if (cost < 0 && config.watch_budget > 0) {
+                    // Priced from this model's history; -1 stops the watch when there is none
+                    double input = result.input_tokens >= 0 ? result.input_tokens
+                                                             : static_cast<double>(estimate_tokens(request.llm_instructions) + estimate_tokens(diff));
+                    double output = result.output_tokens >= 0 ? result.output_tokens : static_cast<double>(estimate_tokens(result.content));
+                    cost = price(request.model, request.provider).expected(input, output);
+                }
+                std::cout << Colors::BLUE << key.substr(0, 10) << Colors::RESET << " " << first_line(result.content);
+                if (result.total_cost >= 0) {
+                    std::cout << " ($" << std::fixed << std::setprecision(4) << result.total_cost << std::defaultfloat << ")";
+                } else if (cost >= 0) {
+                    std::cout << " (about $" << std::fixed << std::setprecision(4) << cost << std::defaultfloat << ")";
+                }
+                std::cout << std::endl;
+                return config.watch_budget > 0 ? cost : 0.0;
+            } catch (const std::exception& e) {
+                std::cout << Colors::YELLOW << "Warning: Pre-generation failed: " << e.what() << Colors::RESET << std::endl;
+                return 0.0;
+            }
+        });
+    }
+    if (pending.valid()) {
+        pending.wait();
+    }
+    return 0;
+}
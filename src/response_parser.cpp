@@ -0,0 +1,221 @@
+#include "response_parser.hpp"
+
+void PathSax::value_done() {
+    if (depth_ > 0 && frames_[depth_ - 1].array) {
+        frames_[depth_ - 1].index++;
+    }
+}
+
+void PathSax::push_frame(bool array) {
+    if (frames_.size() == depth_) {
+        frames_.emplace_back();
+    }
+    Frame& frame = frames_[depth_++];
+    frame.array = array;
+    frame.index = 0;
+    frame.key.clear();
+}
+
+bool PathSax::at(std::initializer_list<Segment> path) const {
+    if (path.size() != depth_) return false;
+    size_t d = 0;
+    for (const auto& segment : path) {
+        const Frame& frame = frames_[d++];
+        if (frame.array != segment.is_index) return false;
+        if (frame.array) {
+            if (segment.index != ANY_INDEX && segment.index != frame.index) return false;
+        } else if (frame.key != segment.key) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PathSax::null() {
+    value_done();
+    return true;
+}
+
+bool PathSax::boolean(bool val) {
+    on_boolean(val);
+    value_done();
+    return true;
+}
+
+bool PathSax::number_integer(number_integer_t val) {
+    on_number(static_cast<double>(val));
+    value_done();
+    return true;
+}
+
+bool PathSax::number_unsigned(number_unsigned_t val) {
+    on_number(static_cast<double>(val));
+    value_done();
+    return true;
+}
+
+bool PathSax::number_float(number_float_t val, const string_t& s) {
+    on_float(val, s);
+    value_done();
+    return true;
+}
+
+bool PathSax::string(string_t& val) {
+    on_string(val);
+    value_done();
+    return true;
+}
+
+bool PathSax::binary(binary_t&) {
+    value_done();
+    return true;
+}
+
+bool PathSax::start_object(std::size_t) {
+    on_object_start();
+    push_frame(false);
+    return true;
+}
+
+bool PathSax::key(string_t& val) {
+    frames_[depth_ - 1].key = val;
+    return true;
+}
+
+bool PathSax::end_object() {
+    depth_--;
+    value_done();
+    return true;
+}
+
+bool PathSax::start_array(std::size_t) {
+    on_array_start();
+    push_frame(true);
+    return true;
+}
+
+bool PathSax::end_array() {
+    depth_--;
+    value_done();
+    return true;
+}
+
+bool PathSax::parse_error(std::size_t, const std::string&, const nlohmann::json::exception& ex) {
+    // Surface malformed responses the same way nlohmann::json::parse() does
+    if (auto* pe = dynamic_cast<const nlohmann::json::parse_error*>(&ex)) {
+        throw *pe;
+    }
+    return false;
+}
+
+namespace {
+
+class ChatResponseSax : public PathSax {
+public:
+    ChatResponseFields fields;
+
+protected:
+    void on_object_start() override {
+        if (at({"error"})) {
+            fields.has_error = true;
+        } else if (at({"choices", PathSax::ANY_INDEX}) && !at({"choices", 0})) {
+            // One slot per extra choice, so a choice without content keeps the rest aligned
+            fields.alternatives.emplace_back();
+        }
+    }
+
+    void on_string(string_t& value) override {
+        if (at({"choices", 0, "message", "content"}) || at({"content", 0, "text"})) {
+            fields.has_content = true;
+            fields.content = std::move(value);
+        } else if (at({"choices", PathSax::ANY_INDEX, "message", "content"})) {
+            fields.alternatives.back() = std::move(value);
+        } else if (at({"id"})) {
+            fields.id = std::move(value);
+        } else if (at({"error", "message"})) {
+            fields.error_message = std::move(value);
+        } else if (at({"error"})) {
+            fields.has_error = true;
+            fields.error_message = std::move(value);
+        }
+    }
+
+    void on_number(double value) override {
+        if (at({"usage", "prompt_tokens"}) || at({"usage", "input_tokens"})) {
+            fields.prompt_tokens = value;
+        } else if (at({"usage", "completion_tokens"}) || at({"usage", "output_tokens"})) {
+            fields.completion_tokens = value;
+        } else if (at({"usage", "prompt_tokens_details", "cached_tokens"}) || at({"usage", "cache_read_input_tokens"})) {
+            fields.cached_tokens = value;
+        }
+    }
+};
+
+class CatalogSax : public PathSax {
+public:
+    ModelCatalog catalog;
+
+protected:
+    void on_object_start() override {
+        if (at({"data", PathSax::ANY_INDEX})) {
+            catalog.models.emplace_back();
+        } else if (at({"error"})) {
+            catalog.has_error = true;
+        }
+    }
+
+    void on_array_start() override {
+        if (at({"data"})) catalog.has_data = true;
+    }
+
+    void on_string(string_t& value) override {
+        if (std::string* field = entry_field()) {
+            *field = std::move(value);
+        } else if (at({"error", "message"})) {
+            catalog.error_message = std::move(value);
+        } else if (at({"error"})) {
+            catalog.has_error = true;
+            catalog.error_message = std::move(value);
+        }
+    }
+
+    // Only integers reach on_number here; floats keep the catalog's own spelling (e.g. 1.5e-7)
+    void on_number(double value) override {
+        if (std::string* field = entry_field()) {
+            *field = std::to_string(static_cast<long long>(value));
+        }
+    }
+
+    void on_float(double, const string_t& text) override {
+        if (std::string* field = entry_field()) {
+            *field = text;
+        }
+    }
+
+private:
+    std::string* entry_field() {
+        if (catalog.models.empty()) return nullptr;
+        CatalogEntry& entry = catalog.models.back();
+        if (at({"data", PathSax::ANY_INDEX, "id"})) return &entry.id;
+        if (at({"data", PathSax::ANY_INDEX, "name"})) return &entry.name;
+        if (at({"data", PathSax::ANY_INDEX, "description"})) return &entry.description;
+        if (at({"data", PathSax::ANY_INDEX, "pricing"})) return &entry.pricing;
+        if (at({"data", PathSax::ANY_INDEX, "pricing", "prompt"})) return &entry.prompt_price;
+        if (at({"data", PathSax::ANY_INDEX, "pricing", "completion"})) return &entry.completion_price;
+        return nullptr;
+    }
+};
+
+} // namespace
+
+ChatResponseFields parse_chat_response(std::string_view response) {
+    ChatResponseSax sax;
+    nlohmann::json::sax_parse(response.begin(), response.end(), &sax);
+    return std::move(sax.fields);
+}
+
+ModelCatalog parse_model_catalog(std::string_view response) {
+    CatalogSax sax;
+    nlohmann::json::sax_parse(response.begin(), response.end(), &sax);
+    return std::move(sax.catalog);
+}
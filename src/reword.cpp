@@ -0,0 +1,200 @@
+#include "reword.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include "colors.hpp"
+#include "commit_message.hpp"
+#include "model_router.hpp"
+#include "statistics.hpp"
+#include "thread_pool.hpp"
+#include "tokenizer.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Requests-per-minute limiter; starts full so the first `burst` requests go out at once
+class TokenBucket {
+public:
+    TokenBucket(double per_minute, double burst)
+        : rate_per_ms_(per_minute / 60000.0), capacity_(std::max(1.0, burst)), tokens_(capacity_), last_(Clock::now()) {}
+
+    // Takes a token and returns zero, or returns how long until one is available
+    std::chrono::milliseconds try_take() {
+        if (rate_per_ms_ <= 0.0) return std::chrono::milliseconds(0);
+        auto now = Clock::now();
+        tokens_ = std::min(capacity_, tokens_ + std::chrono::duration<double, std::milli>(now - last_).count() * rate_per_ms_);
+        last_ = now;
+        if (tokens_ >= 1.0) {
+            tokens_ -= 1.0;
+            return std::chrono::milliseconds(0);
+        }
+        return std::chrono::milliseconds(static_cast<long long>(std::ceil((1.0 - tokens_) / rate_per_ms_)));
+    }
+
+private:
+    double rate_per_ms_;
+    double capacity_;
+    double tokens_;
+    Clock::time_point last_;
+};
+
+std::vector<std::string> compute_diffs(git_repository* repo, const std::vector<RangeCommit>& commits) {
+    std::vector<std::string> diffs(commits.size());
+    std::string git_dir = git_repository_path(repo);
+    size_t workers = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), commits.size());
+    size_t chunk = (commits.size() + workers - 1) / workers;
+    ThreadPool pool(workers);
+    std::vector<std::future<void>> done;
+    for (size_t begin = 0; begin < commits.size(); begin += chunk) {
+        size_t end = std::min(begin + chunk, commits.size());
+        done.push_back(pool.submit([&, begin, end] {
+            // libgit2 handles must not be shared between threads, so each worker opens its own
+            git_repository* local = nullptr;
+            if (git_repository_open(&local, git_dir.c_str()) != 0) {
+                throw std::runtime_error("Failed to open git repository");
+            }
+            try {
+                for (size_t i = begin; i < end; ++i) {
+                    diffs[i] = GitUtils::get_commit_diff(local, commits[i].id);
+                }
+            } catch (...) {
+                git_repository_free(local);
+                throw;
+            }
+            git_repository_free(local);
+        }));
+    }
+    for (auto& f : done) {
+        f.get();
+    }
+    return diffs;
+}
+
+std::string first_line(const std::string& text) {
+    return text.substr(0, text.find('\n'));
+}
+
+} // namespace
+
+int reword_commits(GitRepository& repo, LLMBackend& llm, Config& config, const RewordOptions& options, std::vector<GenerationResult>& generations) {
+    GitUtils git_utils(repo);
+    CommitRange range = git_utils.get_commit_range(options.range);
+    const std::vector<RangeCommit>& commits = range.commits;
+    if (commits.empty()) {
+        std::cout << "No commits in range " << options.range << std::endl;
+        return 0;
+    }
+
+    std::vector<std::string> diffs = compute_diffs(repo.get_repo(), commits);
+    std::vector<size_t> pending;
+    for (size_t i = 0; i < commits.size(); ++i) {
+        if (!diffs[i].empty()) {
+            pending.push_back(i);
+        }
+    }
+
+    if (config.model == "auto" && !pending.empty()) {
+        RoutingPolicy policy;
+        policy.latency_slo_ms = config.auto_latency_slo * 1000.0;
+        policy.percentile = config.auto_latency_percentile;
+        // Route for the median commit; one model serves the whole range
+        std::vector<size_t> by_size = pending;
+        std::nth_element(by_size.begin(), by_size.begin() + by_size.size() / 2, by_size.end(),
+                         [&](size_t a, size_t b) { return diffs[a].size() < diffs[b].size(); });
+        size_t input_tokens = estimate_tokens(config.llm_instructions) + estimate_tokens(diffs[by_size[by_size.size() / 2]]);
+        RouteDecision decision = route_model(read_stats_summary(get_xdg_data_path() + "/generation_stats.log").series,
+                                             config.backend, config.provider, input_tokens, policy);
+        config.model = decision.model;
+        config.provider = decision.provider;
+        if (config.time_run) {
+            print_route_decision(decision, policy, input_tokens);
+        }
+    }
+
+    std::cout << Colors::GREEN << "Rewording " << commits.size() << " commits in " << options.range << Colors::RESET << std::endl;
+
+    std::vector<std::string> messages(commits.size());
+    for (size_t i = 0; i < commits.size(); ++i) {
+        messages[i] = commits[i].message;
+    }
+
+    struct InFlight {
+        size_t index;
+        std::future<GenerationResult> future;
+        Clock::time_point start;
+    };
+    std::vector<InFlight> in_flight;
+    size_t concurrency = std::max<size_t>(1, options.concurrency);
+    TokenBucket bucket(options.requests_per_minute, static_cast<double>(concurrency));
+    size_t next = 0;
+    size_t completed = 0;
+    size_t failed = 0;
+    while (completed < pending.size()) {
+        auto wait = std::chrono::milliseconds(10);
+        while (next < pending.size() && in_flight.size() < concurrency) {
+            auto throttle = bucket.try_take();
+            if (throttle.count() > 0) {
+                wait = std::min(wait, throttle);
+                break;
+            }
+            size_t index = pending[next++];
+            in_flight.push_back({index, llm.generate_commit_message_async(diffs[index], config.llm_instructions, config.model, config.provider, config.temperature), Clock::now()});
+        }
+
+        for (auto it = in_flight.begin(); it != in_flight.end();) {
+            if (it->future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                ++it;
+                continue;
+            }
+            const RangeCommit& commit = commits[it->index];
+            ++completed;
+            std::cout << "[" << completed << "/" << pending.size() << "] " << Colors::BLUE << commit.short_id << Colors::RESET << " ";
+            try {
+                GenerationResult result = it->future.get();
+                result.request_time = std::chrono::duration<double, std::milli>(Clock::now() - it->start).count();
+                std::string message = clean_commit_message(result.content);
+                generations.push_back(std::move(result));
+                if (message.empty()) {
+                    throw std::runtime_error("empty message");
+                }
+                messages[it->index] = message;
+                std::cout << first_line(message) << std::endl;
+            } catch (const std::exception& e) {
+                ++failed;
+                std::cout << Colors::YELLOW << "kept original message (" << e.what() << ")" << Colors::RESET << std::endl;
+            }
+            it = in_flight.erase(it);
+        }
+        if (completed < pending.size()) {
+            std::this_thread::sleep_for(wait);
+        }
+    }
+
+    if (options.dry_run) {
+        std::cout << std::endl << Colors::GREEN << "[DRY RUN] Would reword:" << Colors::RESET << std::endl;
+        for (size_t i = 0; i < commits.size(); ++i) {
+            std::cout << Colors::BLUE << commits[i].short_id << Colors::RESET << " " << commits[i].summary << std::endl;
+            std::cout << "     -> " << first_line(messages[i]) << std::endl;
+        }
+        return failed > 0 ? 1 : 0;
+    }
+
+    // Rewriting creates new hashes from the first changed commit on; skip it when nothing changed
+    if (!pending.empty() && failed == pending.size()) {
+        std::cout << Colors::YELLOW << "No message was generated; the commits were left unchanged" << Colors::RESET << std::endl;
+        return 1;
+    }
+    std::string new_head = git_utils.rewrite_messages(range, messages);
+    if (new_head.empty()) {
+        std::cout << Colors::GREEN << "No message changed; the commits were left unchanged" << Colors::RESET << std::endl;
+        return failed > 0 ? 1 : 0;
+    }
+    std::cout << Colors::GREEN << "Reworded " << (pending.size() - failed) << " of " << commits.size()
+              << " commits; HEAD is now " << Colors::RESET << Colors::BLUE << new_head.substr(0, 7) << Colors::RESET << std::endl;
+    return failed > 0 ? 1 : 0;
+}
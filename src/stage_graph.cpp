@@ -0,0 +1,96 @@
+#include "stage_graph.hpp"
+#include <stdexcept>
+#include "tracer.hpp"
+
+StageGraph::~StageGraph() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    finished_.wait(lock, [this] { return in_flight_ == 0; });
+}
+
+void StageGraph::add(const std::string& name, const std::vector<std::string>& dependencies, std::function<void()> run) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stages_.count(name)) {
+        throw std::runtime_error("Duplicate stage: " + name);
+    }
+    for (const auto& dependency : dependencies) {
+        if (!stages_.count(dependency)) {
+            throw std::runtime_error("Stage " + name + " depends on unknown stage " + dependency);
+        }
+    }
+    Stage& stage = stages_[name];
+    stage.run = std::move(run);
+    for (const auto& dependency : dependencies) {
+        Stage& before = stages_.at(dependency);
+        if (!before.done) {
+            before.dependents.push_back(name);
+            stage.pending++;
+        } else if (before.error && !stage.error) {
+            stage.error = before.error;
+        }
+    }
+    if (stage.error) {
+        stage.done = true;
+    } else if (stage.pending == 0) {
+        start(name);
+    }
+}
+
+void StageGraph::start(const std::string& name) {
+    in_flight_++;
+    pool_.submit([this, name, run = std::move(stages_.at(name).run)] {
+        std::exception_ptr error;
+        try {
+            TraceSpan span(name);
+            run();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        finish(name, error);
+    });
+}
+
+void StageGraph::finish(const std::string& name, std::exception_ptr error) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // A failure is passed down the whole chain of dependents without running them
+    std::vector<std::pair<std::string, std::exception_ptr>> finished{{name, error}};
+    while (!finished.empty()) {
+        auto [current, current_error] = std::move(finished.back());
+        finished.pop_back();
+        Stage& stage = stages_.at(current);
+        stage.done = true;
+        stage.error = current_error;
+        for (const auto& dependent : stage.dependents) {
+            Stage& next = stages_.at(dependent);
+            if (next.done) continue;
+            if (current_error) {
+                finished.emplace_back(dependent, current_error);
+            } else if (--next.pending == 0) {
+                start(dependent);
+            }
+        }
+    }
+    in_flight_--;
+    finished_.notify_all();
+}
+
+void StageGraph::wait(const std::string& name) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = stages_.find(name);
+    if (it == stages_.end()) {
+        throw std::runtime_error("Unknown stage: " + name);
+    }
+    finished_.wait(lock, [&] { return it->second.done; });
+    if (it->second.error) {
+        std::rethrow_exception(it->second.error);
+    }
+}
+
+void StageGraph::wait_all() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    finished_.wait(lock, [this] { return in_flight_ == 0; });
+    for (const auto& [name, stage] : stages_) {
+        if (stage.error) {
+            std::rethrow_exception(stage.error);
+        }
+    }
+}
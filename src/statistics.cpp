@@ -9,8 +9,15 @@
 #include <chrono>
 #include <cstdlib>
 #include <cstring>
+#include <ctime>
+#include <cmath>
+#include <regex>
+#include <limits>
 #include "statistics.hpp"
 #include "git_utils.hpp"
+#include "stats_store.hpp"
+#include "metrics_exporter.hpp"
+#include "tracer.hpp"
 
 std::string get_xdg_data_path() {
     const char* xdg_data = std::getenv("XDG_DATA_HOME");
@@ -35,114 +42,207 @@ std::string get_current_timestamp() {
     return ss.str();
 }
 
-void log_generation_stats(const std::vector<GenerationStats>& stats_list, const std::string& log_path) {
+void log_generation_stats(const std::vector<GenerationStats>& stats_list, const std::string& log_path, bool fsync) {
     std::filesystem::create_directories(std::filesystem::path(log_path).parent_path());
-    std::ofstream file(log_path, std::ios::app);
-    for (const auto& stats : stats_list) {
-        nlohmann::json j = {
-            {"date", stats.date},
-            {"backend", stats.backend},
-            {"model", stats.model},
-            {"input_tokens", stats.input_tokens},
-            {"output_tokens", stats.output_tokens},
-            {"total_cost", stats.total_cost},
-            {"latency", stats.latency},
-            {"generation_time", stats.generation_time},
-            {"dry_run", stats.dry_run}
-        };
-        if (!stats.provider.empty()) {
-            j["provider"] = stats.provider;
+    StatsStore(log_path).append(stats_list, fsync);
+}
+
+StatsSummary read_stats_summary(const std::string& log_path) {
+    if (!std::filesystem::exists(log_path)) {
+        return {};
+    }
+    return StatsStore(log_path, StatsStore::Access::ReadOnly).summary();
+}
+
+namespace {
+
+bool valid_date_prefix(const std::string& date) {
+    static const std::regex pattern(R"(\d{4}-\d{2}-\d{2}(T[\d:]*Z?)?)");
+    return std::regex_match(date, pattern);
+}
+
+// The first or the last second, since the epoch, whose UTC timestamp starts with `prefix`
+int64_t window_bound(const std::string& prefix, bool last) {
+    static const std::string fill = "0000-01-01T00:00:00Z";
+    // Seconds spanned by a prefix of each length from a whole day ("2024-01-02") down to one
+    // second; "2024-01-02T1" spans 10:00:00 to 19:59:59
+    static constexpr int64_t SPAN[] = {86400, 86400, 36000, 3600, 3600, 600, 60, 60, 10, 1};
+    auto parse = [&](const std::string& date) {
+        std::tm tm = {};
+        std::istringstream ss(date + fill.substr(std::min(date.size(), fill.size())));
+        ss >> std::get_time(&tm, "%Y-%m-%dT%H:%M:%SZ");
+        if (ss.fail()) {
+            throw std::runtime_error("Invalid date '" + prefix + "', expected YYYY-MM-DD");
+        }
+        return static_cast<int64_t>(timegm(&tm));
+    };
+    int64_t first = parse(prefix);
+    if (!last) return first;
+    int64_t span = SPAN[std::min<size_t>(prefix.size(), 19) - 10];
+    return std::min(first + span, parse(prefix.substr(0, 10)) + 86400) - 1;
+}
+
+// The day, or the Monday starting the week, that an entry falls in
+std::string period_of(const std::string& date, const std::string& group_by) {
+    if (group_by == "day") return date.substr(0, 10);
+    std::tm tm = {};
+    std::istringstream ss(date.substr(0, 10));
+    ss >> std::get_time(&tm, "%Y-%m-%d");
+    if (ss.fail()) return "unknown";
+    std::time_t time = timegm(&tm);
+    std::tm* day = std::gmtime(&time);
+    time -= static_cast<std::time_t>((day->tm_wday + 6) % 7) * 86400;
+    std::stringstream out;
+    out << "week of " << std::put_time(std::gmtime(&time), "%Y-%m-%d");
+    return out.str();
+}
+
+void print_network_table(const std::map<std::string, NetworkStats>& groups) {
+    std::cout << "Network phases of the chat request (median ms) by backend/provider:" << std::endl;
+    std::cout << "  " << std::left << std::setw(40) << "" << std::right << std::setw(7) << "count" << std::setw(8) << "dns" << std::setw(9) << "connect"
+              << std::setw(8) << "tls" << std::setw(9) << "wait" << std::setw(10) << "download" << std::setw(9) << "total" << std::setw(9) << "p90"
+              << std::setw(9) << "up KB" << std::setw(7) << "http" << std::endl;
+    auto ms = [](const HdrHistogram& h, double percentile) { return h.value_at_percentile(percentile) / 1000.0; };
+    for (const auto& [name, stats] : groups) {
+        if (stats.total.count() == 0) continue;
+        auto version = std::max_element(stats.versions.begin(), stats.versions.end(),
+                                        [](const auto& a, const auto& b) { return a.second < b.second; });
+        std::cout << "  " << std::left << std::setw(40) << name << std::right << std::setw(7) << stats.total.count() << std::fixed << std::setprecision(1)
+                  << std::setw(8) << ms(stats.dns, 50) << std::setw(9) << ms(stats.connect, 50) << std::setw(8) << ms(stats.tls, 50)
+                  << std::setw(9) << ms(stats.wait, 50) << std::setw(10) << ms(stats.download, 50) << std::setw(9) << ms(stats.total, 50)
+                  << std::setw(9) << ms(stats.total, 90) << std::setw(9) << stats.bytes_up.value_at_percentile(50) / 1024.0
+                  << std::setw(7) << version->first << std::endl;
+    }
+}
+
+void print_latency_table(const std::string& title, const std::map<std::string, LatencyStats>& groups) {
+    std::cout << title << std::endl;
+    std::cout << "  " << std::left << std::setw(40) << "" << std::right << std::setw(7) << "count" << std::setw(9) << "p50" << std::setw(9) << "p90"
+              << std::setw(9) << "p99" << std::setw(9) << "max" << std::setw(12) << "tok/s p50" << std::setw(12) << "tok/s p10" << std::endl;
+    for (const auto& [name, stats] : groups) {
+        std::cout << "  " << std::left << std::setw(40) << name << std::right << std::setw(7) << stats.latency.count();
+        if (stats.latency.count() > 0) {
+            std::cout << std::setw(9) << stats.latency.value_at_percentile(50) << std::setw(9) << stats.latency.value_at_percentile(90)
+                      << std::setw(9) << stats.latency.value_at_percentile(99) << std::setw(9) << stats.latency.max();
+        } else {
+            std::cout << std::setw(9) << "-" << std::setw(9) << "-" << std::setw(9) << "-" << std::setw(9) << "-";
         }
-        file << j.dump() << std::endl;
+        if (stats.throughput.count() > 0) {
+            std::cout << std::fixed << std::setprecision(1) << std::setw(12) << stats.throughput.value_at_percentile(50) / 10.0
+                      << std::setw(12) << stats.throughput.value_at_percentile(10) / 10.0;
+        } else {
+            std::cout << std::setw(12) << "-" << std::setw(12) << "-";
+        }
+        std::cout << std::endl;
     }
 }
 
-void summarize_generation_stats(const std::string& log_path) {
+} // namespace
+
+void validate_stats_query(const StatsQuery& query) {
+    if (!query.since.empty() && !valid_date_prefix(query.since)) {
+        throw std::runtime_error("Invalid --since date '" + query.since + "', expected YYYY-MM-DD");
+    }
+    if (!query.until.empty() && !valid_date_prefix(query.until)) {
+        throw std::runtime_error("Invalid --until date '" + query.until + "', expected YYYY-MM-DD");
+    }
+    if (query.group_by != "none" && query.group_by != "day" && query.group_by != "week") {
+        throw std::runtime_error("Invalid --group-by '" + query.group_by + "', expected none, day or week");
+    }
+}
+
+void summarize_generation_stats(const std::string& log_path, const StatsQuery& query) {
+    validate_stats_query(query);
     if (!std::filesystem::exists(log_path)) {
         std::cout << "No generation stats found at " << log_path << std::endl;
         return;
     }
 
-    std::ifstream file(log_path);
-    std::string line;
-    double total_cost = 0.0;
-    double actual_cost = 0.0;
-    double dry_run_cost = 0.0;
-    int total_input_tokens = 0;
-    int total_output_tokens = 0;
-    int count = 0;
-    int actual_count = 0;
-    int dry_run_count = 0;
-    std::map<std::string, int> model_counts;
-    std::map<std::string, double> model_costs;
-
-    while (std::getline(file, line)) {
-        try {
-            nlohmann::json j = nlohmann::json::parse(line);
-            double cost = j.value("total_cost", -1.0);
-            int input_tokens = j.value("input_tokens", -1);
-            int output_tokens = j.value("output_tokens", -1);
-            bool is_dry_run = j.value("dry_run", false);
-
-            // Only count valid (non-negative) values
-            if (cost >= 0) {
-                total_cost += cost;
-                if (is_dry_run) {
-                    dry_run_cost += cost;
-                } else {
-                    actual_cost += cost;
-                }
-            }
-            if (input_tokens >= 0) {
-                total_input_tokens += input_tokens;
-            }
-            if (output_tokens >= 0) {
-                total_output_tokens += output_tokens;
-            }
-
-            count++;
-            if (is_dry_run) {
-                dry_run_count++;
-            } else {
-                actual_count++;
-            }
-
-            std::string model = j.value("model", "unknown");
-            model_counts[model]++;
-            if (cost >= 0) {
-                model_costs[model] += cost;
-            }
-        } catch (const nlohmann::json::exception&) {
-            // Skip invalid lines
+    StatsStore store(log_path, StatsStore::Access::ReadOnly);
+    bool windowed = !query.since.empty() || !query.until.empty();
+    // Summaries per period. The whole log needs only the checkpointed totals and histograms
+    // and the rows after them; a window reads just the rows inside it.
+    std::map<std::string, StatsSummary> periods;
+    StatsSummary summary;
+    if (!windowed && query.group_by == "none") {
+        summary = store.summary();
+        periods[""] = summary;
+    } else {
+        int64_t since = query.since.empty() ? std::numeric_limits<int64_t>::min() : window_bound(query.since, false);
+        int64_t until = query.until.empty() ? std::numeric_limits<int64_t>::max() : window_bound(query.until, true);
+        std::vector<GenerationStats> entries = store.read_between(since, until);
+        summary = summarize_stats(entries);
+        std::map<std::string, std::vector<GenerationStats>> grouped;
+        for (auto& stats : entries) {
+            grouped[query.group_by == "none" ? "" : period_of(stats.date, query.group_by)].push_back(std::move(stats));
+        }
+        for (const auto& [period, period_entries] : grouped) {
+            periods[period] = summarize_stats(period_entries);
         }
     }
 
-    if (count == 0) {
+    if (summary.count == 0) {
         std::cout << "No valid generation stats found" << std::endl;
         return;
     }
 
-    std::cout << "Generation Statistics Summary:" << std::endl;
-    std::cout << "Total generations: " << count;
-    if (dry_run_count > 0) {
-        std::cout << " (" << actual_count << " actual, " << dry_run_count << " dry runs)";
+    std::cout << "Generation Statistics Summary";
+    if (windowed) {
+        std::cout << " (" << (query.since.empty() ? "start" : query.since) << " to " << (query.until.empty() ? "now" : query.until) << ")";
+    }
+    std::cout << ":" << std::endl;
+    std::cout << "Total generations: " << summary.count;
+    if (summary.dry_run_count > 0) {
+        std::cout << " (" << summary.actual_count << " actual, " << summary.dry_run_count << " dry runs)";
     }
     std::cout << std::endl;
-    std::cout << "Total cost: $" << std::fixed << std::setprecision(4) << total_cost;
-    if (dry_run_cost > 0) {
-        std::cout << " ($" << std::fixed << std::setprecision(4) << actual_cost << " actual, $" << std::fixed << std::setprecision(4) << dry_run_cost << " dry runs)";
+    std::cout << "Total cost: $" << std::fixed << std::setprecision(4) << summary.total_cost;
+    if (summary.dry_run_cost > 0) {
+        std::cout << " ($" << std::fixed << std::setprecision(4) << summary.actual_cost << " actual, $" << std::fixed << std::setprecision(4) << summary.dry_run_cost << " dry runs)";
     }
     std::cout << std::endl;
-    std::cout << "Total input tokens: " << total_input_tokens << std::endl;
-    std::cout << "Total output tokens: " << total_output_tokens << std::endl;
-    std::cout << "Average cost per generation: $" << std::fixed << std::setprecision(4) << (total_cost / count) << std::endl;
-    if (actual_count > 0) {
-        std::cout << "Average cost per actual generation: $" << std::fixed << std::setprecision(4) << (actual_cost / actual_count) << std::endl;
+    std::cout << "Total input tokens: " << static_cast<long long>(summary.input_tokens) << std::endl;
+    std::cout << "Total output tokens: " << static_cast<long long>(summary.output_tokens) << std::endl;
+    std::cout << "Average cost per generation: $" << std::fixed << std::setprecision(4) << (summary.total_cost / summary.count) << std::endl;
+    if (summary.actual_count > 0) {
+        std::cout << "Average cost per actual generation: $" << std::fixed << std::setprecision(4) << (summary.actual_cost / summary.actual_count) << std::endl;
     }
     std::cout << std::endl;
     std::cout << "Cost by model:" << std::endl;
-    for (const auto& [model, cost] : model_costs) {
-        std::cout << "  " << model << ": $" << std::fixed << std::setprecision(4) << cost << " (" << model_counts[model] << " generations)" << std::endl;
+    for (const auto& [model, totals] : summary.models) {
+        std::cout << "  " << model << ": $" << std::fixed << std::setprecision(4) << totals.cost << " (" << totals.count << " generations)" << std::endl;
+    }
+
+    struct PeriodTables {
+        std::map<std::string, LatencyStats> by_model;
+        std::map<std::string, LatencyStats> by_provider;
+        std::map<std::string, NetworkStats> network;
+        bool has_network = false;
+    };
+    std::map<std::string, PeriodTables> tables_by_period;
+    for (const auto& [period, period_summary] : periods) {
+        PeriodTables& tables = tables_by_period[period];
+        for (const auto& [key, totals] : period_summary.series) {
+            const auto& [backend, model, provider] = key;
+            std::string name = backend + "/" + (provider.empty() ? "default" : provider);
+            tables.by_model[model.empty() ? "unknown" : model].add(totals.percentiles);
+            tables.by_provider[name].add(totals.percentiles);
+            if (totals.network.total.count() > 0) {
+                tables.network[name].add(totals.network);
+                tables.has_network = true;
+            }
+        }
+    }
+    for (const auto& [period, tables] : tables_by_period) {
+        std::cout << std::endl;
+        if (!period.empty()) {
+            std::cout << Colors::GREEN << period << Colors::RESET << std::endl;
+        }
+        print_latency_table("Latency (ms) and output throughput by model:", tables.by_model);
+        print_latency_table("Latency (ms) and output throughput by backend/provider:", tables.by_provider);
+        if (tables.has_network) {
+            print_network_table(tables.network);
+        }
     }
 }
 
@@ -156,6 +256,8 @@ TimingGuard::~TimingGuard() {
     if (llm_generated_ && !generations_.empty()) {
         std::vector<GenerationStats> stats_list;
         for (const auto& gen : generations_) {
+            // Extra choices of one request are billed with the first
+            if (gen.shared_request) continue;
             GenerationStats stats;
             stats.date = get_current_timestamp();
             stats.backend = config_.backend;
@@ -172,17 +274,34 @@ TimingGuard::~TimingGuard() {
                 stats.total_cost = gen.total_cost;
                 stats.latency = gen.latency;
                 stats.generation_time = gen.generation_time;
+                stats.request_time = gen.request_time >= 0 ? gen.request_time : static_cast<double>(llm_ms_);
+                stats.cached_tokens = gen.cached_tokens;
+                stats.http = gen.http;
 
             stats_list.push_back(stats);
         }
+        // Git timings are per run, so only the first entry carries them
+        if (!stats_list.empty()) {
+            stats_list.front().commit_time = commit_ms_;
+            stats_list.front().push_time = push_ms_;
+        }
 
         // Always log basic info, enhanced when available
-        std::string xdg_data_path = get_xdg_data_path() + "/generation_stats.log";
-        log_generation_stats(stats_list, xdg_data_path);
+        TraceSpan span("log write");
+        try {
+            std::string xdg_data_path = get_xdg_data_path() + "/generation_stats.log";
+            log_generation_stats(stats_list, xdg_data_path, config_.fsync_stats_log);
 
-        if (!repo_root_.empty()) {
-            std::string repo_log_path = repo_root_ + "/.commit/generation_stats.log";
-            log_generation_stats(stats_list, repo_log_path);
+            if (!repo_root_.empty()) {
+                std::string repo_log_path = repo_root_ + "/.commit/generation_stats.log";
+                log_generation_stats(stats_list, repo_log_path, config_.fsync_stats_log);
+            }
+            if (!config_.metrics_path.empty()) {
+                export_metrics(xdg_data_path, config_.metrics_path);
+            }
+        } catch (const std::exception& e) {
+            // Runs in a destructor, so it must not throw
+            std::cerr << "Warning: Failed to write generation stats: " << e.what() << std::endl;
         }
     }
 
@@ -212,5 +331,6 @@ TimingGuard::~TimingGuard() {
             std::cout << " LLM query time: " << "\033[37;44m" << format_time(llm_ms_) << "\033[34;49m";
         }
         std::cout << "\033[0m" << std::endl;
+        Tracer::instance().print_table();
     }
 }
\ No newline at end of file
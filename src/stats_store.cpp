@@ -0,0 +1,887 @@
+#include "stats_store.hpp"
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <nlohmann/json.hpp>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Column {
+    const char* file;
+    size_t width;
+};
+
+// One file per GenerationStats field, in native byte order
+constexpr Column COLUMNS[] = {
+    {"date.i64", sizeof(int64_t)},
+    {"backend.u32", sizeof(uint32_t)},
+    {"model.u32", sizeof(uint32_t)},
+    {"provider.u32", sizeof(uint32_t)},
+    {"input_tokens.f64", sizeof(double)},
+    {"output_tokens.f64", sizeof(double)},
+    {"total_cost.f64", sizeof(double)},
+    {"latency.f64", sizeof(double)},
+    {"generation_time.f64", sizeof(double)},
+    {"request_time.f64", sizeof(double)},
+    {"dry_run.u8", sizeof(uint8_t)},
+    {"http_namelookup.f64", sizeof(double)},
+    {"http_connect.f64", sizeof(double)},
+    {"http_appconnect.f64", sizeof(double)},
+    {"http_pretransfer.f64", sizeof(double)},
+    {"http_starttransfer.f64", sizeof(double)},
+    {"http_total.f64", sizeof(double)},
+    {"http_bytes_up.f64", sizeof(double)},
+    {"http_bytes_down.f64", sizeof(double)},
+    {"http_version.u32", sizeof(uint32_t)},
+    {"cached_tokens.f64", sizeof(double)},
+    {"commit_time.f64", sizeof(double)},
+    {"push_time.f64", sizeof(double)},
+};
+
+constexpr size_t IMPORT_BATCH = 65536;
+
+int64_t parse_timestamp(const std::string& date) {
+    std::tm tm = {};
+    std::istringstream ss(date);
+    ss >> std::get_time(&tm, "%Y-%m-%dT%H:%M:%SZ");
+    if (ss.fail()) return -1;
+    return static_cast<int64_t>(timegm(&tm));
+}
+
+std::string format_timestamp(int64_t seconds) {
+    if (seconds < 0) return "";
+    std::time_t time = static_cast<std::time_t>(seconds);
+    std::stringstream ss;
+    ss << std::put_time(std::gmtime(&time), "%Y-%m-%dT%H:%M:%SZ");
+    return ss.str();
+}
+
+std::string to_jsonl(const GenerationStats& stats) {
+    nlohmann::json j = {
+        {"date", stats.date},
+        {"backend", stats.backend},
+        {"model", stats.model},
+        {"input_tokens", stats.input_tokens},
+        {"output_tokens", stats.output_tokens},
+        {"total_cost", stats.total_cost},
+        {"latency", stats.latency},
+        {"generation_time", stats.generation_time},
+        {"dry_run", stats.dry_run}
+    };
+    if (stats.request_time >= 0) {
+        j["request_time"] = stats.request_time;
+    }
+    if (!stats.provider.empty()) {
+        j["provider"] = stats.provider;
+    }
+    if (stats.cached_tokens >= 0) {
+        j["cached_tokens"] = stats.cached_tokens;
+    }
+    if (stats.commit_time >= 0) {
+        j["commit_time"] = stats.commit_time;
+    }
+    if (stats.push_time >= 0) {
+        j["push_time"] = stats.push_time;
+    }
+    if (stats.http.total >= 0) {
+        nlohmann::json http = {{"version", stats.http.http_version}};
+        for (size_t i = 0; i < std::size(HTTP_TIMING_FIELDS); ++i) {
+            http[HTTP_TIMING_KEYS[i]] = stats.http.*HTTP_TIMING_FIELDS[i];
+        }
+        j["http"] = std::move(http);
+    }
+    return j.dump();
+}
+
+GenerationStats from_jsonl(const std::string& line) {
+    nlohmann::json j = nlohmann::json::parse(line);
+    GenerationStats stats;
+    stats.date = j.value("date", "");
+    stats.backend = j.value("backend", "");
+    stats.model = j.value("model", "unknown");
+    stats.provider = j.value("provider", "");
+    stats.input_tokens = j.value("input_tokens", -1.0);
+    stats.output_tokens = j.value("output_tokens", -1.0);
+    stats.total_cost = j.value("total_cost", -1.0);
+    stats.latency = j.value("latency", -1.0);
+    stats.generation_time = j.value("generation_time", -1.0);
+    stats.request_time = j.value("request_time", -1.0);
+    stats.dry_run = j.value("dry_run", false);
+    stats.cached_tokens = j.value("cached_tokens", -1.0);
+    stats.commit_time = j.value("commit_time", -1.0);
+    stats.push_time = j.value("push_time", -1.0);
+    if (j.contains("http") && j["http"].is_object()) {
+        const auto& http = j["http"];
+        for (size_t i = 0; i < std::size(HTTP_TIMING_FIELDS); ++i) {
+            stats.http.*HTTP_TIMING_FIELDS[i] = http.value(HTTP_TIMING_KEYS[i], -1.0);
+        }
+        stats.http.http_version = http.value("version", "");
+    }
+    return stats;
+}
+
+template <class T>
+std::vector<T> read_column(const fs::path& file, size_t from, size_t to) {
+    std::vector<T> values(to > from ? to - from : 0);
+    if (values.empty()) return values;
+    std::ifstream in(file, std::ios::binary);
+    in.seekg(static_cast<std::streamoff>(from * sizeof(T)));
+    in.read(reinterpret_cast<char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(T)));
+    if (!in) {
+        throw std::runtime_error("Failed to read stats column " + file.string());
+    }
+    return values;
+}
+
+template <class T>
+void append_column(const fs::path& file, const std::vector<T>& values) {
+    std::ofstream out(file, std::ios::binary | std::ios::app);
+    out.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(T)));
+    if (!out) {
+        throw std::runtime_error("Failed to write stats column " + file.string());
+    }
+}
+
+// Replaces `file` in one step so readers never see a partial write
+void write_atomically(const fs::path& file, const std::string& content) {
+    fs::path tmp = file;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        out << content;
+        if (!out) {
+            throw std::runtime_error("Failed to write " + tmp.string());
+        }
+    }
+    fs::rename(tmp, file);
+}
+
+// Opens the JSONL log for appending and holds an exclusive advisory lock on it. Every
+// process that writes the log or its columns takes this lock first; `shared` opens it
+// read-only and takes a shared lock, for readers that write nothing.
+class LogLock {
+public:
+    explicit LogLock(const std::string& path, bool shared = false) {
+        fd_ = shared ? ::open(path.c_str(), O_RDONLY | O_CLOEXEC)
+                     : ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            throw std::runtime_error("Failed to open " + path + ": " + std::strerror(errno));
+        }
+        while (::flock(fd_, shared ? LOCK_SH : LOCK_EX) != 0) {
+            if (errno != EINTR) {
+                int error = errno;
+                ::close(fd_);
+                throw std::runtime_error("Failed to lock " + path + ": " + std::strerror(error));
+            }
+        }
+    }
+    ~LogLock() { ::close(fd_); }  // Releases the lock
+
+    LogLock(const LogLock&) = delete;
+    LogLock& operator=(const LogLock&) = delete;
+
+    int fd() const { return fd_; }
+
+private:
+    int fd_;
+};
+
+void write_all(int fd, const std::string& data, const std::string& path) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("Failed to write " + path + ": " + std::strerror(errno));
+        }
+        written += static_cast<size_t>(n);
+    }
+}
+
+// One entry's contribution to a summary; times in ms
+struct Row {
+    double cost;
+    double input_tokens;
+    double output_tokens;
+    double cached_tokens;
+    double latency;
+    double generation_time;
+    double request_time;
+    double request_ms;  // As routed on by model=auto
+    double commit_time;
+    double push_time;
+    bool dry_run;
+    HttpTiming http;
+};
+
+// Wall-clock request time when logged, else the provider's own timings; -1 when neither is
+double request_ms_of(double latency, double generation_time, double request_time) {
+    if (request_time >= 0) return request_time;
+    if (latency >= 0 && generation_time >= 0) return latency + generation_time;
+    return -1.0;
+}
+
+Row row_of(const GenerationStats& stats) {
+    // Backends that report no server-side latency fall back to the client's wall clock
+    return {stats.total_cost, stats.input_tokens, stats.output_tokens, stats.cached_tokens,
+            stats.latency >= 0 ? stats.latency : stats.request_time, stats.generation_time, stats.request_time,
+            request_ms_of(stats.latency, stats.generation_time, stats.request_time),
+            stats.commit_time, stats.push_time, stats.dry_run, stats.http};
+}
+
+void add_latency(LatencyStats& target, const Row& row) {
+    if (row.latency >= 0) {
+        target.latency.record(std::llround(row.latency));
+    }
+    double seconds = (row.generation_time > 0 ? row.generation_time : row.request_time) / 1000.0;
+    if (row.output_tokens > 0 && seconds > 0) {
+        target.throughput.record(std::llround(row.output_tokens / seconds * 10.0));
+    }
+}
+
+void add_network(NetworkStats& target, const HttpTiming& http) {
+    if (http.total < 0) return;
+    auto us = [](double ms) { return std::llround(std::max(0.0, ms) * 1000.0); };
+    target.dns.record(us(http.namelookup));
+    target.connect.record(us(http.connect - http.namelookup));
+    target.tls.record(us(http.appconnect > 0 ? http.appconnect - http.connect : 0.0));
+    target.wait.record(us(http.starttransfer - http.pretransfer));
+    target.download.record(us(http.total - http.starttransfer));
+    target.total.record(us(http.total));
+    if (http.bytes_up >= 0) {
+        target.bytes_up.record(std::llround(http.bytes_up));
+    }
+    target.versions[http.http_version.empty() ? "?" : http.http_version]++;
+}
+
+void add_row(StatsSummary& summary, ModelTotals& model, SeriesTotals& series, const Row& row) {
+    if (row.cost >= 0) {
+        summary.total_cost += row.cost;
+        (row.dry_run ? summary.dry_run_cost : summary.actual_cost) += row.cost;
+        model.cost += row.cost;
+        series.cost += row.cost;
+    }
+    if (row.input_tokens >= 0) {
+        summary.input_tokens += row.input_tokens;
+        series.input_tokens += row.input_tokens;
+    }
+    if (row.output_tokens >= 0) {
+        summary.output_tokens += row.output_tokens;
+        series.output_tokens += row.output_tokens;
+    }
+    if (row.cached_tokens > 0) {
+        series.cache_hits++;
+        series.cached_tokens += row.cached_tokens;
+    }
+    if (row.latency >= 0) {
+        series.latency.record(row.latency / 1000.0, LATENCY_BUCKETS);
+    }
+    add_latency(series.percentiles, row);
+    add_network(series.network, row.http);
+    if (row.request_ms >= 0) {
+        series.request_ms.record(std::llround(row.request_ms));
+    }
+    if (row.cost >= 0 && row.input_tokens >= 0 && row.output_tokens >= 0) {
+        series.cost_fit.record(row.input_tokens, row.output_tokens, row.cost);
+    }
+    if (row.commit_time >= 0) {
+        summary.commit_time.record(row.commit_time / 1000.0, GIT_BUCKETS);
+    }
+    if (row.push_time >= 0) {
+        summary.push_time.record(row.push_time / 1000.0, GIT_BUCKETS);
+    }
+    summary.count++;
+    (row.dry_run ? summary.dry_run_count : summary.actual_count)++;
+    model.count++;
+    series.count++;
+    if (row.dry_run) series.dry_run_count++;
+}
+
+nlohmann::json buckets_to_json(const Buckets& buckets) {
+    return {{"counts", buckets.counts}, {"count", buckets.count}, {"sum", buckets.sum}};
+}
+
+Buckets buckets_from_json(const nlohmann::json& j) {
+    Buckets buckets;
+    buckets.counts = j.at("counts").get<std::vector<long long>>();
+    buckets.count = j.at("count");
+    buckets.sum = j.at("sum");
+    return buckets;
+}
+
+nlohmann::json histogram_to_json(const HdrHistogram& histogram) {
+    return {{"counts", histogram.nonzero_counts()}, {"min", histogram.min()}, {"max", histogram.max()}};
+}
+
+// Throws std::invalid_argument for counts saved with another range or precision
+void histogram_from_json(HdrHistogram& histogram, const nlohmann::json& j) {
+    histogram.restore(j.at("counts").get<std::vector<std::pair<size_t, uint64_t>>>(), j.at("min"), j.at("max"));
+}
+
+nlohmann::json cost_fit_to_json(const CostFit& fit) {
+    return {fit.s_ii, fit.s_io, fit.s_oo, fit.s_ic, fit.s_oc, fit.total_output, fit.total_tokens, fit.total_cost, fit.count};
+}
+
+CostFit cost_fit_from_json(const nlohmann::json& j) {
+    CostFit fit;
+    fit.s_ii = j.at(0);
+    fit.s_io = j.at(1);
+    fit.s_oo = j.at(2);
+    fit.s_ic = j.at(3);
+    fit.s_oc = j.at(4);
+    fit.total_output = j.at(5);
+    fit.total_tokens = j.at(6);
+    fit.total_cost = j.at(7);
+    fit.count = j.at(8);
+    return fit;
+}
+
+nlohmann::json percentiles_to_json(const LatencyStats& stats) {
+    return {{"latency", histogram_to_json(stats.latency)}, {"throughput", histogram_to_json(stats.throughput)}};
+}
+
+void percentiles_from_json(LatencyStats& stats, const nlohmann::json& j) {
+    histogram_from_json(stats.latency, j.at("latency"));
+    histogram_from_json(stats.throughput, j.at("throughput"));
+}
+
+// Histogram fields of NetworkStats, by checkpoint key
+constexpr std::pair<const char*, HdrHistogram NetworkStats::*> NETWORK_HISTOGRAMS[] = {
+    {"dns", &NetworkStats::dns},
+    {"connect", &NetworkStats::connect},
+    {"tls", &NetworkStats::tls},
+    {"wait", &NetworkStats::wait},
+    {"download", &NetworkStats::download},
+    {"total", &NetworkStats::total},
+    {"bytes_up", &NetworkStats::bytes_up},
+};
+
+nlohmann::json network_to_json(const NetworkStats& stats) {
+    nlohmann::json j = {{"versions", stats.versions}};
+    for (const auto& [key, field] : NETWORK_HISTOGRAMS) {
+        j[key] = histogram_to_json(stats.*field);
+    }
+    return j;
+}
+
+void network_from_json(NetworkStats& stats, const nlohmann::json& j) {
+    for (const auto& [key, field] : NETWORK_HISTOGRAMS) {
+        histogram_from_json(stats.*field, j.at(key));
+    }
+    stats.versions = j.at("versions").get<std::map<std::string, long long>>();
+}
+
+} // namespace
+
+StatsSummary summarize_stats(const std::vector<GenerationStats>& stats_list) {
+    StatsSummary summary;
+    for (const auto& stats : stats_list) {
+        add_row(summary, summary.models[stats.model], summary.series[{stats.backend, stats.model, stats.provider}], row_of(stats));
+    }
+    return summary;
+}
+
+StatsStore::StatsStore(const std::string& log_path, Access access) : log_path_(log_path), dir_(log_path + ".cols") {
+    if (access == Access::ReadOnly) {
+        if (!fs::exists(log_path_)) return;
+        {
+            LogLock lock(log_path_, true);
+            if (load_current()) return;
+        }
+        try {
+            fs::create_directories(dir_);
+            LogLock lock(log_path_);
+            sync();
+        } catch (const std::exception&) {
+            // A log we may read but not write next to, e.g. another user's
+            LogLock lock(log_path_, true);
+            load_jsonl();
+        }
+        return;
+    }
+    fs::create_directories(dir_);
+    LogLock lock(log_path_);
+    sync();
+}
+
+// Loads the columns without touching them when they cover the whole log; the caller holds
+// at least a shared lock
+bool StatsStore::load_current() {
+    std::ifstream source(dir_ / "source.json");
+    if (!source) return false;
+    size_t source_rows = 0;
+    uintmax_t source_bytes = 0;
+    try {
+        nlohmann::json j = nlohmann::json::parse(source);
+        source_rows = j.at("rows").get<size_t>();
+        source_bytes = j.at("jsonl_bytes").get<uintmax_t>();
+    } catch (const nlohmann::json::exception&) {
+        return false;
+    }
+    std::error_code ec;
+    if (fs::file_size(log_path_, ec) != source_bytes || ec) return false;
+    for (const auto& column : COLUMNS) {
+        // Longer is fine: a writer that died after appending, whose rows are not counted yet
+        uintmax_t size = fs::file_size(dir_ / column.file, ec);
+        if (ec || size < source_rows * column.width) return false;
+    }
+    rows_ = source_rows;
+    jsonl_bytes_ = source_bytes;
+    strings_.clear();
+    string_ids_.clear();
+    load_strings();
+    return true;
+}
+
+void StatsStore::load_jsonl() {
+    in_memory_ = true;
+    memory_.clear();
+    std::ifstream in(log_path_);
+    if (!in) {
+        throw std::runtime_error("Failed to read " + log_path_);
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        if (in.eof()) break;  // Possibly still being written
+        try {
+            memory_.push_back(from_jsonl(line));
+        } catch (const nlohmann::json::exception&) {
+            // Skip invalid lines
+        }
+    }
+    rows_ = memory_.size();
+}
+
+// Reloads the on-disk state, which other processes may have changed; the caller holds the lock
+void StatsStore::sync() {
+    rows_ = 0;
+    jsonl_bytes_ = 0;
+    strings_.clear();
+    string_ids_.clear();
+    repair();
+    load_strings();
+    import_jsonl();
+}
+
+void StatsStore::repair() {
+    size_t source_rows = 0;
+    std::ifstream source(dir_ / "source.json");
+    if (source) {
+        try {
+            nlohmann::json j = nlohmann::json::parse(source);
+            source_rows = j.value("rows", size_t{0});
+            jsonl_bytes_ = j.value("jsonl_bytes", uintmax_t{0});
+        } catch (const nlohmann::json::exception&) {
+            source_rows = 0;
+            jsonl_bytes_ = 0;
+        }
+    }
+
+    size_t rows = SIZE_MAX;
+    for (const auto& column : COLUMNS) {
+        fs::path file = dir_ / column.file;
+        rows = std::min<size_t>(rows, fs::exists(file) ? fs::file_size(file) / column.width : 0);
+    }
+
+    std::error_code ec;
+    uintmax_t log_size = fs::file_size(log_path_, ec);
+    // Rows written after the last sync point are dropped and imported again from the log.
+    // Missing rows, a column added by a newer version, or a log that was truncated or
+    // replaced, mean starting over.
+    if (rows < source_rows || ec || log_size < jsonl_bytes_) {
+        source_rows = 0;
+        jsonl_bytes_ = 0;
+        fs::remove(dir_ / "strings.txt");
+        fs::remove(dir_ / "checkpoint.json");
+    }
+    rows_ = source_rows;
+    for (const auto& column : COLUMNS) {
+        fs::path file = dir_ / column.file;
+        if (!fs::exists(file)) {
+            std::ofstream create(file, std::ios::binary);
+        }
+        if (fs::file_size(file) != rows_ * column.width) {
+            fs::resize_file(file, rows_ * column.width);
+        }
+    }
+}
+
+void StatsStore::load_strings() {
+    std::ifstream in(dir_ / "strings.txt");
+    std::string line;
+    while (std::getline(in, line)) {
+        string_ids_.emplace(line, static_cast<uint32_t>(strings_.size()));
+        strings_.push_back(std::move(line));
+    }
+}
+
+uint32_t StatsStore::intern(const std::string& value) {
+    std::string key = value;
+    std::replace(key.begin(), key.end(), '\n', ' ');
+    auto it = string_ids_.find(key);
+    if (it != string_ids_.end()) return it->second;
+    uint32_t id = static_cast<uint32_t>(strings_.size());
+    std::ofstream out(dir_ / "strings.txt", std::ios::app);
+    out << key << '\n';
+    if (!out) {
+        throw std::runtime_error("Failed to write stats dictionary in " + dir_.string());
+    }
+    string_ids_.emplace(key, id);
+    strings_.push_back(std::move(key));
+    return id;
+}
+
+void StatsStore::import_jsonl() {
+    std::ifstream in(log_path_, std::ios::binary);
+    if (!in) return;
+    in.seekg(static_cast<std::streamoff>(jsonl_bytes_));
+    std::vector<GenerationStats> batch;
+    uintmax_t offset = jsonl_bytes_;
+    std::string line;
+    bool imported = false;
+    while (std::getline(in, line)) {
+        // A last line without a newline may still be being written
+        if (in.eof()) break;
+        offset += line.size() + 1;
+        try {
+            batch.push_back(from_jsonl(line));
+        } catch (const nlohmann::json::exception&) {
+            // Skip invalid lines
+        }
+        if (batch.size() >= IMPORT_BATCH) {
+            append_columns(batch);
+            batch.clear();
+        }
+        imported = true;
+    }
+    if (!imported) return;
+    append_columns(batch);
+    jsonl_bytes_ = offset;
+    save_source();
+    maybe_checkpoint();
+}
+
+void StatsStore::append(const std::vector<GenerationStats>& stats_list, bool fsync) {
+    if (stats_list.empty()) return;
+    std::string buffer;
+    for (const auto& stats : stats_list) {
+        buffer += to_jsonl(stats);
+        buffer += '\n';
+    }
+
+    LogLock lock(log_path_);
+    sync();
+    struct stat st;
+    if (::fstat(lock.fd(), &st) != 0) {
+        throw std::runtime_error("Failed to stat " + log_path_ + ": " + std::strerror(errno));
+    }
+    // False only when the log ends in a partial line from a writer that does not lock
+    bool in_sync = static_cast<uintmax_t>(st.st_size) == jsonl_bytes_;
+    write_all(lock.fd(), buffer, log_path_);
+    if (fsync && ::fsync(lock.fd()) != 0) {
+        throw std::runtime_error("Failed to sync " + log_path_ + ": " + std::strerror(errno));
+    }
+    if (!in_sync) return;  // The next open imports the batch from the log
+
+    jsonl_bytes_ += buffer.size();
+    append_columns(stats_list);
+    save_source();
+    maybe_checkpoint();
+}
+
+void StatsStore::append_columns(const std::vector<GenerationStats>& stats_list) {
+    if (stats_list.empty()) return;
+    std::vector<int64_t> dates;
+    std::vector<uint32_t> backends, models, providers;
+    std::vector<double> input_tokens, output_tokens, costs, latencies, generation_times, request_times, cached_tokens, commit_times, push_times;
+    std::vector<uint8_t> dry_runs;
+    std::vector<std::vector<double>> http(std::size(HTTP_TIMING_FIELDS));
+    std::vector<uint32_t> http_versions;
+    for (const auto& stats : stats_list) {
+        dates.push_back(parse_timestamp(stats.date));
+        backends.push_back(intern(stats.backend));
+        models.push_back(intern(stats.model));
+        providers.push_back(intern(stats.provider));
+        input_tokens.push_back(stats.input_tokens);
+        output_tokens.push_back(stats.output_tokens);
+        costs.push_back(stats.total_cost);
+        latencies.push_back(stats.latency);
+        generation_times.push_back(stats.generation_time);
+        request_times.push_back(stats.request_time);
+        dry_runs.push_back(stats.dry_run ? 1 : 0);
+        for (size_t i = 0; i < std::size(HTTP_TIMING_FIELDS); ++i) {
+            http[i].push_back(stats.http.*HTTP_TIMING_FIELDS[i]);
+        }
+        http_versions.push_back(intern(stats.http.http_version));
+        cached_tokens.push_back(stats.cached_tokens);
+        commit_times.push_back(stats.commit_time);
+        push_times.push_back(stats.push_time);
+    }
+    append_column(dir_ / "date.i64", dates);
+    append_column(dir_ / "backend.u32", backends);
+    append_column(dir_ / "model.u32", models);
+    append_column(dir_ / "provider.u32", providers);
+    append_column(dir_ / "input_tokens.f64", input_tokens);
+    append_column(dir_ / "output_tokens.f64", output_tokens);
+    append_column(dir_ / "total_cost.f64", costs);
+    append_column(dir_ / "latency.f64", latencies);
+    append_column(dir_ / "generation_time.f64", generation_times);
+    append_column(dir_ / "request_time.f64", request_times);
+    append_column(dir_ / "dry_run.u8", dry_runs);
+    for (size_t i = 0; i < std::size(HTTP_TIMING_FIELDS); ++i) {
+        append_column(dir_ / (std::string("http_") + HTTP_TIMING_KEYS[i] + ".f64"), http[i]);
+    }
+    append_column(dir_ / "http_version.u32", http_versions);
+    append_column(dir_ / "cached_tokens.f64", cached_tokens);
+    append_column(dir_ / "commit_time.f64", commit_times);
+    append_column(dir_ / "push_time.f64", push_times);
+    rows_ += stats_list.size();
+}
+
+void StatsStore::save_source() const {
+    nlohmann::json j = {{"rows", rows_}, {"jsonl_bytes", jsonl_bytes_}};
+    write_atomically(dir_ / "source.json", j.dump());
+}
+
+bool StatsStore::load_checkpoint(StatsSummary& summary, size_t& rows) const {
+    std::ifstream in(dir_ / "checkpoint.json");
+    if (!in) return false;
+    try {
+        nlohmann::json j = nlohmann::json::parse(in);
+        rows = j.at("rows").get<size_t>();
+        if (rows > rows_) return false;
+        summary.count = j.at("count");
+        summary.actual_count = j.at("actual_count");
+        summary.dry_run_count = j.at("dry_run_count");
+        summary.total_cost = j.at("total_cost");
+        summary.actual_cost = j.at("actual_cost");
+        summary.dry_run_cost = j.at("dry_run_cost");
+        summary.input_tokens = j.at("input_tokens");
+        summary.output_tokens = j.at("output_tokens");
+        for (const auto& [model, totals] : j.at("models").items()) {
+            summary.models[model] = {totals.at(0).get<long long>(), totals.at(1).get<double>()};
+        }
+        for (const auto& s : j.at("series")) {
+            SeriesTotals& series = summary.series[{s.at("backend"), s.at("model"), s.at("provider")}];
+            series.count = s.at("count");
+            series.dry_run_count = s.at("dry_run_count");
+            series.cost = s.at("cost");
+            series.input_tokens = s.at("input_tokens");
+            series.output_tokens = s.at("output_tokens");
+            series.cache_hits = s.at("cache_hits");
+            series.cached_tokens = s.at("cached_tokens");
+            series.latency = buckets_from_json(s.at("latency"));
+            percentiles_from_json(series.percentiles, s.at("percentiles"));
+            network_from_json(series.network, s.at("network"));
+            histogram_from_json(series.request_ms, s.at("request_ms"));
+            series.cost_fit = cost_fit_from_json(s.at("cost_fit"));
+        }
+        summary.commit_time = buckets_from_json(j.at("commit_time"));
+        summary.push_time = buckets_from_json(j.at("push_time"));
+        return true;
+    } catch (const std::exception&) {
+        // Unreadable, or written by a version with other fields or histogram shapes
+        summary = StatsSummary();
+        return false;
+    }
+}
+
+void StatsStore::maybe_checkpoint() const {
+    StatsSummary summary;
+    size_t from = 0;
+    if (!load_checkpoint(summary, from)) {
+        summary = StatsSummary();
+        from = 0;
+    }
+    if (rows_ - from < CHECKPOINT_INTERVAL) return;
+    scan(summary, from);
+
+    nlohmann::json models = nlohmann::json::object();
+    for (const auto& [model, totals] : summary.models) {
+        models[model] = {totals.count, totals.cost};
+    }
+    nlohmann::json series = nlohmann::json::array();
+    for (const auto& [key, totals] : summary.series) {
+        series.push_back({
+            {"backend", std::get<0>(key)},
+            {"model", std::get<1>(key)},
+            {"provider", std::get<2>(key)},
+            {"count", totals.count},
+            {"dry_run_count", totals.dry_run_count},
+            {"cost", totals.cost},
+            {"input_tokens", totals.input_tokens},
+            {"output_tokens", totals.output_tokens},
+            {"cache_hits", totals.cache_hits},
+            {"cached_tokens", totals.cached_tokens},
+            {"latency", buckets_to_json(totals.latency)},
+            {"percentiles", percentiles_to_json(totals.percentiles)},
+            {"network", network_to_json(totals.network)},
+            {"request_ms", histogram_to_json(totals.request_ms)},
+            {"cost_fit", cost_fit_to_json(totals.cost_fit)}
+        });
+    }
+    nlohmann::json j = {
+        {"rows", rows_},
+        {"count", summary.count},
+        {"actual_count", summary.actual_count},
+        {"dry_run_count", summary.dry_run_count},
+        {"total_cost", summary.total_cost},
+        {"actual_cost", summary.actual_cost},
+        {"dry_run_cost", summary.dry_run_cost},
+        {"input_tokens", summary.input_tokens},
+        {"output_tokens", summary.output_tokens},
+        {"models", models},
+        {"series", series},
+        {"commit_time", buckets_to_json(summary.commit_time)},
+        {"push_time", buckets_to_json(summary.push_time)}
+    };
+    write_atomically(dir_ / "checkpoint.json", j.dump());
+}
+
+void StatsStore::scan(StatsSummary& summary, size_t from) const {
+    auto backends = read_column<uint32_t>(dir_ / "backend.u32", from, rows_);
+    auto models = read_column<uint32_t>(dir_ / "model.u32", from, rows_);
+    auto providers = read_column<uint32_t>(dir_ / "provider.u32", from, rows_);
+    auto costs = read_column<double>(dir_ / "total_cost.f64", from, rows_);
+    auto input_tokens = read_column<double>(dir_ / "input_tokens.f64", from, rows_);
+    auto output_tokens = read_column<double>(dir_ / "output_tokens.f64", from, rows_);
+    auto cached_tokens = read_column<double>(dir_ / "cached_tokens.f64", from, rows_);
+    auto latencies = read_column<double>(dir_ / "latency.f64", from, rows_);
+    auto generation_times = read_column<double>(dir_ / "generation_time.f64", from, rows_);
+    auto request_times = read_column<double>(dir_ / "request_time.f64", from, rows_);
+    auto commit_times = read_column<double>(dir_ / "commit_time.f64", from, rows_);
+    auto push_times = read_column<double>(dir_ / "push_time.f64", from, rows_);
+    auto dry_runs = read_column<uint8_t>(dir_ / "dry_run.u8", from, rows_);
+    std::vector<std::vector<double>> http;
+    for (const char* key : HTTP_TIMING_KEYS) {
+        http.push_back(read_column<double>(dir_ / (std::string("http_") + key + ".f64"), from, rows_));
+    }
+    auto http_versions = read_column<uint32_t>(dir_ / "http_version.u32", from, rows_);
+    auto lookup = [this](uint32_t id) { return id < strings_.size() ? strings_[id] : std::string("unknown"); };
+    // Keyed by dictionary id while scanning; names are looked up once per group
+    std::vector<ModelTotals> by_model;
+    std::map<std::tuple<uint32_t, uint32_t, uint32_t>, SeriesTotals> by_series;
+    for (size_t i = 0; i < models.size(); ++i) {
+        if (models[i] >= by_model.size()) by_model.resize(models[i] + 1);
+        Row row{costs[i], input_tokens[i], output_tokens[i], cached_tokens[i], latencies[i] >= 0 ? latencies[i] : request_times[i],
+                generation_times[i], request_times[i], request_ms_of(latencies[i], generation_times[i], request_times[i]),
+                commit_times[i], push_times[i], dry_runs[i] != 0, {}};
+        for (size_t f = 0; f < std::size(HTTP_TIMING_FIELDS); ++f) {
+            row.http.*HTTP_TIMING_FIELDS[f] = http[f][i];
+        }
+        if (row.http.total >= 0) row.http.http_version = lookup(http_versions[i]);
+        add_row(summary, by_model[models[i]], by_series[{backends[i], models[i], providers[i]}], row);
+    }
+    for (uint32_t id = 0; id < by_model.size(); ++id) {
+        if (by_model[id].count == 0) continue;
+        ModelTotals& totals = summary.models[lookup(id)];
+        totals.count += by_model[id].count;
+        totals.cost += by_model[id].cost;
+    }
+    for (const auto& [ids, totals] : by_series) {
+        summary.series[{lookup(std::get<0>(ids)), lookup(std::get<1>(ids)), lookup(std::get<2>(ids))}].add(totals);
+    }
+}
+
+StatsSummary StatsStore::summary() const {
+    if (in_memory_) return summarize_stats(memory_);
+    StatsSummary summary;
+    size_t from = 0;
+    if (!load_checkpoint(summary, from)) {
+        summary = StatsSummary();
+        from = 0;
+    }
+    scan(summary, from);
+    return summary;
+}
+
+std::vector<GenerationStats> StatsStore::read_all() const {
+    if (in_memory_) return memory_;
+    return read_rows(0, rows_);
+}
+
+std::vector<GenerationStats> StatsStore::read_between(int64_t since, int64_t until) const {
+    if (in_memory_) {
+        std::vector<GenerationStats> matches;
+        for (const auto& stats : memory_) {
+            int64_t date = parse_timestamp(stats.date);
+            if (date >= since && date <= until) matches.push_back(stats);
+        }
+        return matches;
+    }
+    auto dates = read_column<int64_t>(dir_ / "date.i64", 0, rows_);
+    auto in_range = [&](int64_t date) { return date >= since && date <= until; };
+    auto first = std::find_if(dates.begin(), dates.end(), in_range);
+    if (first == dates.end()) return {};
+    auto last = std::find_if(dates.rbegin(), dates.rend(), in_range).base();
+    size_t from = static_cast<size_t>(first - dates.begin());
+    size_t to = static_cast<size_t>(last - dates.begin());
+    // Entries are appended roughly in date order, so few rows in the span fall outside it
+    std::vector<GenerationStats> rows = read_rows(from, to);
+    std::vector<GenerationStats> matches;
+    matches.reserve(rows.size());
+    for (size_t i = 0; i < rows.size(); ++i) {
+        if (in_range(dates[from + i])) matches.push_back(std::move(rows[i]));
+    }
+    return matches;
+}
+
+std::vector<GenerationStats> StatsStore::read_rows(size_t from, size_t to) const {
+    auto dates = read_column<int64_t>(dir_ / "date.i64", from, to);
+    auto backends = read_column<uint32_t>(dir_ / "backend.u32", from, to);
+    auto models = read_column<uint32_t>(dir_ / "model.u32", from, to);
+    auto providers = read_column<uint32_t>(dir_ / "provider.u32", from, to);
+    auto input_tokens = read_column<double>(dir_ / "input_tokens.f64", from, to);
+    auto output_tokens = read_column<double>(dir_ / "output_tokens.f64", from, to);
+    auto costs = read_column<double>(dir_ / "total_cost.f64", from, to);
+    auto latencies = read_column<double>(dir_ / "latency.f64", from, to);
+    auto generation_times = read_column<double>(dir_ / "generation_time.f64", from, to);
+    auto request_times = read_column<double>(dir_ / "request_time.f64", from, to);
+    auto dry_runs = read_column<uint8_t>(dir_ / "dry_run.u8", from, to);
+    std::vector<std::vector<double>> http;
+    for (const char* key : HTTP_TIMING_KEYS) {
+        http.push_back(read_column<double>(dir_ / (std::string("http_") + key + ".f64"), from, to));
+    }
+    auto http_versions = read_column<uint32_t>(dir_ / "http_version.u32", from, to);
+    auto cached_tokens = read_column<double>(dir_ / "cached_tokens.f64", from, to);
+    auto commit_times = read_column<double>(dir_ / "commit_time.f64", from, to);
+    auto push_times = read_column<double>(dir_ / "push_time.f64", from, to);
+    auto lookup = [this](uint32_t id) { return id < strings_.size() ? strings_[id] : std::string(); };
+
+    std::vector<GenerationStats> stats_list(to - from);
+    for (size_t i = 0; i < stats_list.size(); ++i) {
+        GenerationStats& stats = stats_list[i];
+        stats.date = format_timestamp(dates[i]);
+        stats.backend = lookup(backends[i]);
+        stats.model = lookup(models[i]);
+        stats.provider = lookup(providers[i]);
+        stats.input_tokens = input_tokens[i];
+        stats.output_tokens = output_tokens[i];
+        stats.total_cost = costs[i];
+        stats.latency = latencies[i];
+        stats.generation_time = generation_times[i];
+        stats.request_time = request_times[i];
+        stats.dry_run = dry_runs[i] != 0;
+        for (size_t f = 0; f < std::size(HTTP_TIMING_FIELDS); ++f) {
+            stats.http.*HTTP_TIMING_FIELDS[f] = http[f][i];
+        }
+        stats.http.http_version = lookup(http_versions[i]);
+        stats.cached_tokens = cached_tokens[i];
+        stats.commit_time = commit_times[i];
+        stats.push_time = push_times[i];
+    }
+    return stats_list;
+}
@@ -0,0 +1,261 @@
+#include "tokenizer.hpp"
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+constexpr uint32_t NO_RANK = std::numeric_limits<uint32_t>::max();
+constexpr size_t MAX_CACHED_PIECES = 1 << 20;
+
+bool is_letter(unsigned char c) {
+    // Non-ASCII bytes are treated as letters, which keeps UTF-8 words in one piece
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c >= 0x80;
+}
+
+bool is_digit(unsigned char c) {
+    return c >= '0' && c <= '9';
+}
+
+bool is_space(unsigned char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+bool is_newline(unsigned char c) {
+    return c == '\n' || c == '\r';
+}
+
+int base64_value(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+std::string base64_decode(std::string_view in) {
+    std::string out;
+    out.reserve(in.size() * 3 / 4);
+    uint32_t buffer = 0;
+    int bits = 0;
+    for (char c : in) {
+        int v = base64_value(c);
+        if (v < 0) break;  // Padding
+        buffer = (buffer << 6) | static_cast<uint32_t>(v);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out.push_back(static_cast<char>((buffer >> bits) & 0xFF));
+        }
+    }
+    return out;
+}
+
+// Length of the contraction ('s, 't, 're, 've, 'm, 'll, 'd) at `pos`, or 0
+size_t contraction_length(std::string_view text, size_t pos) {
+    if (text[pos] != '\'' || pos + 1 >= text.size()) return 0;
+    auto lower = [&](size_t i) { return i < text.size() ? static_cast<char>(std::tolower(static_cast<unsigned char>(text[i]))) : '\0'; };
+    char a = lower(pos + 1);
+    char b = lower(pos + 2);
+    if ((a == 'r' && b == 'e') || (a == 'v' && b == 'e') || (a == 'l' && b == 'l')) return 3;
+    if (a == 's' || a == 't' || a == 'm' || a == 'd') return 2;
+    return 0;
+}
+
+} // namespace
+
+std::vector<std::string_view> pretokenize(std::string_view text) {
+    std::vector<std::string_view> pieces;
+    pieces.reserve(text.size() / 4 + 1);
+    const size_t n = text.size();
+    auto at = [&](size_t i) { return static_cast<unsigned char>(text[i]); };
+    size_t i = 0;
+    while (i < n) {
+        size_t start = i;
+        unsigned char c = at(i);
+        if (size_t len = contraction_length(text, i)) {
+            i += len;
+        } else if (is_letter(c) || (!is_newline(c) && !is_digit(c) && i + 1 < n && is_letter(at(i + 1)))) {
+            // [^\r\n\p{L}\p{N}]?\p{L}+
+            i += is_letter(c) ? 0 : 1;
+            while (i < n && is_letter(at(i))) ++i;
+        } else if (is_digit(c)) {
+            // \p{N}{1,3}
+            while (i < n && i - start < 3 && is_digit(at(i))) ++i;
+        } else if (!is_space(c) || (c == ' ' && i + 1 < n && !is_space(at(i + 1)) && !is_letter(at(i + 1)) && !is_digit(at(i + 1)))) {
+            // " ?[^\s\p{L}\p{N}]+[\r\n]*"
+            if (c == ' ') ++i;
+            while (i < n && !is_space(at(i)) && !is_letter(at(i)) && !is_digit(at(i))) ++i;
+            while (i < n && is_newline(at(i))) ++i;
+        } else {
+            size_t end = i;
+            size_t last_newline = std::string_view::npos;
+            while (end < n && is_space(at(end))) {
+                if (is_newline(at(end))) last_newline = end;
+                ++end;
+            }
+            if (last_newline != std::string_view::npos) {
+                // \s*[\r\n]+
+                i = last_newline + 1;
+            } else if (end < n && end - i > 1) {
+                // \s+(?!\S): leave the last space to lead the next word
+                i = end - 1;
+            } else {
+                i = end;
+            }
+        }
+        pieces.push_back(text.substr(start, i - start));
+    }
+    return pieces;
+}
+
+size_t estimate_tokens(std::string_view text) {
+    return (text.size() + 3) / 4;
+}
+
+BpeTokenizer BpeTokenizer::load_from_file(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Tokenizer vocabulary not found: " + path);
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string content = buffer.str();
+
+    BpeTokenizer tokenizer;
+    tokenizer.name_ = std::filesystem::path(path).stem().string();
+    tokenizer.ranks_.reserve(content.size() / 16);
+    size_t pos = 0;
+    while (pos < content.size()) {
+        size_t eol = content.find('\n', pos);
+        if (eol == std::string::npos) eol = content.size();
+        std::string_view line(content.data() + pos, eol - pos);
+        pos = eol + 1;
+        size_t space = line.find(' ');
+        if (space == std::string_view::npos) continue;
+        uint32_t rank = static_cast<uint32_t>(std::stoul(std::string(line.substr(space + 1))));
+        tokenizer.ranks_.emplace(base64_decode(line.substr(0, space)), rank);
+    }
+    if (tokenizer.ranks_.empty()) {
+        throw std::runtime_error("Tokenizer vocabulary is empty: " + path);
+    }
+    return tokenizer;
+}
+
+// Standard rank-ordered BPE: repeatedly merge the adjacent pair whose concatenation
+// has the lowest rank. Returns the start offsets of the final tokens plus the end.
+std::vector<size_t> BpeTokenizer::merge_boundaries(std::string_view piece) const {
+    struct Part {
+        size_t start;
+        uint32_t rank;
+    };
+    std::vector<Part> parts;
+    parts.reserve(piece.size() + 1);
+    for (size_t i = 0; i <= piece.size(); ++i) {
+        parts.push_back({i, NO_RANK});
+    }
+    // Rank of the token that would span parts[i] and parts[i + skip + 1]
+    auto rank_of = [&](size_t i, size_t skip) -> uint32_t {
+        if (i + skip + 2 >= parts.size()) return NO_RANK;
+        auto it = ranks_.find(piece.substr(parts[i].start, parts[i + skip + 2].start - parts[i].start));
+        return it == ranks_.end() ? NO_RANK : it->second;
+    };
+    for (size_t i = 0; i + 2 < parts.size(); ++i) {
+        parts[i].rank = rank_of(i, 0);
+    }
+    while (parts.size() > 2) {
+        uint32_t min_rank = NO_RANK;
+        size_t min_index = 0;
+        for (size_t i = 0; i + 1 < parts.size(); ++i) {
+            if (parts[i].rank < min_rank) {
+                min_rank = parts[i].rank;
+                min_index = i;
+            }
+        }
+        if (min_rank == NO_RANK) break;
+        // parts[min_index + 1] is about to disappear, so look one further ahead
+        parts[min_index].rank = rank_of(min_index, 1);
+        if (min_index > 0) {
+            parts[min_index - 1].rank = rank_of(min_index - 1, 1);
+        }
+        parts.erase(parts.begin() + static_cast<std::ptrdiff_t>(min_index) + 1);
+    }
+    std::vector<size_t> boundaries;
+    boundaries.reserve(parts.size());
+    for (const auto& part : parts) {
+        boundaries.push_back(part.start);
+    }
+    return boundaries;
+}
+
+void BpeTokenizer::merge_piece(std::string_view piece, std::vector<uint32_t>& out) const {
+    auto whole = ranks_.find(piece);
+    if (whole != ranks_.end()) {
+        out.push_back(whole->second);
+        return;
+    }
+    std::vector<size_t> boundaries = merge_boundaries(piece);
+    for (size_t i = 0; i + 1 < boundaries.size(); ++i) {
+        auto it = ranks_.find(piece.substr(boundaries[i], boundaries[i + 1] - boundaries[i]));
+        out.push_back(it == ranks_.end() ? NO_RANK : it->second);
+    }
+}
+
+size_t BpeTokenizer::count_piece(std::string_view piece) {
+    if (ranks_.find(piece) != ranks_.end()) return 1;
+    auto cached = piece_counts_.find(piece);
+    if (cached != piece_counts_.end()) return cached->second;
+    size_t tokens = merge_boundaries(piece).size() - 1;
+    if (piece_counts_.size() >= MAX_CACHED_PIECES) {
+        piece_counts_.clear();
+    }
+    piece_counts_.emplace(std::string(piece), static_cast<uint32_t>(tokens));
+    return tokens;
+}
+
+size_t BpeTokenizer::count(std::string_view text) {
+    if (!has_vocab()) return estimate_tokens(text);
+    size_t total = 0;
+    for (std::string_view piece : pretokenize(text)) {
+        total += count_piece(piece);
+    }
+    return total;
+}
+
+std::vector<uint32_t> BpeTokenizer::encode(std::string_view text) const {
+    std::vector<uint32_t> tokens;
+    for (std::string_view piece : pretokenize(text)) {
+        merge_piece(piece, tokens);
+    }
+    return tokens;
+}
+
+std::string trim_diff_to_budget(BpeTokenizer& tokenizer, const std::string& instructions, const std::string& diff, size_t budget) {
+    static const std::string marker = "\n[diff truncated to fit the token budget]\n";
+    size_t fixed = tokenizer.count(instructions) + tokenizer.count("\n\nDiff:\n") + tokenizer.count(marker);
+    if (fixed >= budget) {
+        throw std::runtime_error("The instructions alone are " + std::to_string(fixed) + " tokens, leaving no room for the diff within " +
+                                 std::to_string(budget) + " tokens. Shorten the instructions or raise max_input_tokens.");
+    }
+    size_t available = budget - fixed;
+    if (tokenizer.count(diff) <= available) return diff;
+
+    // Binary search over line boundaries for the longest prefix that fits
+    std::vector<size_t> line_ends;
+    for (size_t pos = diff.find('\n'); pos != std::string::npos; pos = diff.find('\n', pos + 1)) {
+        line_ends.push_back(pos + 1);
+    }
+    size_t lo = 0, hi = line_ends.size();  // Number of whole lines kept
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo + 1) / 2;
+        if (tokenizer.count(std::string_view(diff).substr(0, line_ends[mid - 1])) <= available) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return diff.substr(0, lo == 0 ? 0 : line_ends[lo - 1]) + marker;
+}
@@ -0,0 +1,92 @@
+#include "tracer.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <nlohmann/json.hpp>
+#include "colors.hpp"
+
+Tracer& Tracer::instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+void Tracer::record(std::string name, Clock::time_point start, Clock::time_point end, std::string detail) {
+    if (!enabled_) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto [it, inserted] = threads_.emplace(std::this_thread::get_id(), static_cast<int>(threads_.size()) + 1);
+    spans_.push_back({std::move(name), std::move(detail), start, end, it->second});
+}
+
+void Tracer::write_chrome_trace(const std::string& path) const {
+    auto micros = [this](Clock::time_point t) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(t - origin_).count();
+    };
+    nlohmann::json events = nlohmann::json::array();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& span : spans_) {
+            nlohmann::json event = {
+                {"name", span.name},
+                {"cat", "commit"},
+                {"ph", "X"},
+                {"ts", micros(span.start)},
+                {"dur", micros(span.end) - micros(span.start)},
+                {"pid", 1},
+                {"tid", span.thread}
+            };
+            if (!span.detail.empty()) {
+                event["args"] = {{"detail", span.detail}};
+            }
+            events.push_back(std::move(event));
+        }
+    }
+    std::ofstream file(path);
+    file << nlohmann::json{{"traceEvents", events}, {"displayTimeUnit", "ms"}}.dump() << std::endl;
+    if (!file) {
+        throw std::runtime_error("Failed to write trace to " + path);
+    }
+}
+
+void Tracer::print_table() const {
+    struct Row {
+        std::string name;
+        size_t count = 0;
+        double total_ms = 0.0;
+        double max_ms = 0.0;
+    };
+    std::vector<Row> rows;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<const Span*> ordered;
+        for (const auto& span : spans_) ordered.push_back(&span);
+        std::stable_sort(ordered.begin(), ordered.end(), [](const Span* a, const Span* b) { return a->start < b->start; });
+        std::map<std::string, size_t> index;
+        for (const Span* span : ordered) {
+            auto [it, inserted] = index.emplace(span->name, rows.size());
+            if (inserted) rows.push_back({span->name});
+            Row& row = rows[it->second];
+            double ms = std::chrono::duration<double, std::milli>(span->end - span->start).count();
+            row.count++;
+            row.total_ms += ms;
+            row.max_ms = std::max(row.max_ms, ms);
+        }
+    }
+    if (rows.empty()) return;
+    std::cout << Colors::BLUE << std::left << std::setw(32) << "Phase" << std::right << std::setw(7) << "count"
+              << std::setw(12) << "total ms" << std::setw(12) << "max ms" << Colors::RESET << std::endl;
+    for (const auto& row : rows) {
+        std::cout << std::left << std::setw(32) << row.name << std::right << std::setw(7) << row.count << std::fixed << std::setprecision(1)
+                  << std::setw(12) << row.total_ms << std::setw(12) << row.max_ms << std::endl;
+    }
+}
+
+TraceFile::~TraceFile() {
+    if (path_.empty()) return;
+    try {
+        Tracer::instance().write_chrome_trace(path_);
+    } catch (const std::exception& e) {
+        std::cerr << "Warning: " << e.what() << std::endl;
+    }
+}
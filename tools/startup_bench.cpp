@@ -0,0 +1,345 @@
+// Times the commit paths that never touch the network (--repo-root, --list-configs, -m manual
+// commits, --summarize-logs) against a synthetic repository, cold and warm, and fails when a
+// budget is exceeded, so regressions in the git and config layers show up without an API key.
+// Cold runs first evict the repository and the binary from the page cache.
+#include <CLI/CLI.hpp>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace fs = std::filesystem;
+
+struct BenchOptions {
+    std::string commit_path;     // Defaults to the commit binary next to this one
+    std::string work_dir;        // Defaults to a new directory under the temp dir, removed afterwards
+    int files = 2000;            // Tracked files, i.e. index entries
+    int files_per_dir = 100;
+    int file_lines = 40;
+    int history = 200;           // Commits on the synthetic branch
+    int modified = 20;           // Tracked files changed before each manual commit
+    int log_entries = 20000;     // Lines in the repository's generation_stats.log
+    int runs = 20;               // Warm runs per path, after one untimed run
+    int cold_runs = 3;
+    bool drop_caches = false;    // Also drop the whole page cache before cold runs (needs root)
+    bool keep = false;
+    std::vector<std::string> budgets;      // PATH=MS, against the warm p95
+    std::vector<std::string> rss_budgets;  // PATH=KIB, against the maximum RSS of any run
+};
+
+struct BenchPath {
+    std::string name;
+    std::vector<std::string> args;
+    bool commits = false;  // Changes tracked files before each run, so there is something to commit
+};
+
+struct Sample {
+    double ms;
+    long rss_kib;
+};
+
+static BenchOptions options;
+
+// Runs argv in cwd with stdin, stdout and stderr on /dev/null; throws unless it exits with 0
+static Sample run(const std::vector<std::string>& argv, const fs::path& cwd) {
+    std::vector<char*> args;
+    for (const auto& arg : argv) {
+        args.push_back(const_cast<char*>(arg.c_str()));
+    }
+    args.push_back(nullptr);
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = ::fork();
+    if (pid < 0) {
+        throw std::runtime_error(std::string("fork() failed: ") + std::strerror(errno));
+    }
+    if (pid == 0) {
+        int null_fd = ::open("/dev/null", O_RDWR);
+        ::dup2(null_fd, STDIN_FILENO);
+        ::dup2(null_fd, STDOUT_FILENO);
+        ::dup2(null_fd, STDERR_FILENO);
+        if (null_fd > STDERR_FILENO) ::close(null_fd);
+        if (::chdir(cwd.c_str()) != 0) ::_exit(126);
+        ::execvp(args[0], args.data());
+        ::_exit(127);
+    }
+    int status = 0;
+    rusage usage{};
+    ::wait4(pid, &status, 0, &usage);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        std::string command;
+        for (const auto& arg : argv) {
+            command += (command.empty() ? "" : " ") + arg;
+        }
+        throw std::runtime_error("`" + command + "` failed with status " + std::to_string(WIFEXITED(status) ? WEXITSTATUS(status) : -1));
+    }
+    return {ms, usage.ru_maxrss};
+}
+
+static std::string file_content(int file, int revision) {
+    std::string content;
+    for (int line = 0; line < options.file_lines; ++line) {
+        content += "file " + std::to_string(file) + " line " + std::to_string(line) + " revision " + std::to_string(revision) + "\n";
+    }
+    return content;
+}
+
+static std::string file_path(int file) {
+    return "d" + std::to_string(file / options.files_per_dir) + "/f" + std::to_string(file) + ".txt";
+}
+
+// One commit adding every file, then one commit per step of history changing a single file,
+// streamed through git fast-import so that deep histories take seconds
+static void create_repository(const fs::path& repo) {
+    fs::create_directories(repo);
+    run({"git", "init", "-q", "-b", "main"}, repo);
+    run({"git", "config", "user.name", "Bench"}, repo);
+    run({"git", "config", "user.email", "bench@example.com"}, repo);
+
+    FILE* import = ::popen(("git -C '" + repo.string() + "' fast-import --quiet").c_str(), "w");
+    if (!import) {
+        throw std::runtime_error("Cannot start git fast-import");
+    }
+    auto write = [&](const std::string& text) { std::fwrite(text.data(), 1, text.size(), import); };
+    auto data = [&](const std::string& text) { write("data " + std::to_string(text.size()) + "\n" + text + "\n"); };
+    for (int commit = 0; commit < std::max(options.history, 1); ++commit) {
+        write("commit refs/heads/main\n");
+        write("committer Bench <bench@example.com> " + std::to_string(1700000000 + commit * 60) + " +0000\n");
+        data("Synthetic commit " + std::to_string(commit) + "\n");
+        if (commit == 0) {
+            for (int file = 0; file < options.files; ++file) {
+                write("M 100644 inline " + file_path(file) + "\n");
+                data(file_content(file, 0));
+            }
+        } else {
+            int file = commit % std::max(options.files, 1);
+            write("M 100644 inline " + file_path(file) + "\n");
+            data(file_content(file, commit));
+        }
+    }
+    if (::pclose(import) != 0) {
+        throw std::runtime_error("git fast-import failed");
+    }
+    run({"git", "reset", "-q", "--hard", "main"}, repo);
+}
+
+static void write_stats_log(const fs::path& repo) {
+    fs::create_directories(repo / ".commit");
+    std::ofstream log(repo / ".commit" / "generation_stats.log");
+    const char* models[] = {"openai/gpt-4o-mini", "anthropic/claude-3.5-haiku", "google/gemini-flash-1.5", "qwen/qwen-2.5-coder-32b"};
+    for (int i = 0; i < options.log_entries; ++i) {
+        std::time_t time = 1700000000 + static_cast<std::time_t>(i) * 600;
+        std::stringstream date;
+        date << std::put_time(std::gmtime(&time), "%Y-%m-%dT%H:%M:%SZ");
+        nlohmann::json j = {
+            {"date", date.str()},
+            {"backend", i % 5 == 0 ? "zen" : "openrouter"},
+            {"model", models[i % 4]},
+            {"input_tokens", 1000 + i % 3000},
+            {"output_tokens", 40 + i % 200},
+            {"total_cost", 0.0001 * (1 + i % 50)},
+            {"latency", 300 + i % 900},
+            {"generation_time", 800 + i % 4000},
+            {"request_time", 900 + i % 4500},
+            {"dry_run", i % 7 == 0}
+        };
+        log << j.dump() << "\n";
+    }
+}
+
+// Appends a line to the first `modified` tracked files
+static void change_files(const fs::path& repo, int round) {
+    for (int file = 0; file < std::min(options.modified, options.files); ++file) {
+        std::ofstream(repo / file_path(file), std::ios::app) << "change " << round << "\n";
+    }
+}
+
+static void evict(const fs::path& path) {
+    auto evict_file = [](const fs::path& file) {
+        int fd = ::open(file.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(fd);
+    };
+    if (fs::is_directory(path)) {
+        for (const auto& entry : fs::recursive_directory_iterator(path)) {
+            if (entry.is_regular_file()) evict_file(entry.path());
+        }
+    } else {
+        evict_file(path);
+    }
+}
+
+static void make_cold(const fs::path& repo) {
+    ::sync();
+    if (options.drop_caches) {
+        std::ofstream("/proc/sys/vm/drop_caches") << "3\n";
+    }
+    evict(repo);
+    evict(options.commit_path);
+}
+
+static std::map<std::string, double> parse_budgets(const std::vector<std::string>& specs) {
+    std::map<std::string, double> budgets;
+    for (const auto& spec : specs) {
+        auto eq = spec.find('=');
+        if (eq == std::string::npos) {
+            throw std::runtime_error("Invalid budget " + spec + " (expected PATH=VALUE)");
+        }
+        budgets[spec.substr(0, eq)] = std::stod(spec.substr(eq + 1));
+    }
+    return budgets;
+}
+
+static double mean(const std::vector<Sample>& samples) {
+    double sum = 0.0;
+    for (const auto& sample : samples) sum += sample.ms;
+    return samples.empty() ? 0.0 : sum / samples.size();
+}
+
+// Nearest-rank percentile
+static double percentile(std::vector<Sample> samples, double p) {
+    if (samples.empty()) return 0.0;
+    std::sort(samples.begin(), samples.end(), [](const Sample& a, const Sample& b) { return a.ms < b.ms; });
+    size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * samples.size()));
+    return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1].ms;
+}
+
+int main(int argc, char** argv) {
+    CLI::App app{"commit_startup_bench - time commit's non-LLM paths against a synthetic repository"};
+    app.add_option("--commit", options.commit_path, "commit binary to measure (default: the one next to this binary)");
+    app.add_option("--work-dir", options.work_dir, "Directory for the synthetic repository (default: a new temporary directory)");
+    app.add_option("--files", options.files, "Tracked files (index entries)");
+    app.add_option("--files-per-dir", options.files_per_dir, "Tracked files per directory");
+    app.add_option("--file-lines", options.file_lines, "Lines per file");
+    app.add_option("--history", options.history, "Commits of history");
+    app.add_option("--modified", options.modified, "Files changed before each manual commit");
+    app.add_option("--log-entries", options.log_entries, "Entries in the repository's generation stats log");
+    app.add_option("--runs", options.runs, "Warm runs per path");
+    app.add_option("--cold-runs", options.cold_runs, "Cold runs per path");
+    app.add_flag("--drop-caches", options.drop_caches, "Drop the whole page cache before cold runs, not just the repository and binary (needs root)");
+    app.add_flag("--keep", options.keep, "Keep the synthetic repository");
+    app.add_option("--budget", options.budgets, "Budget for the warm p95 of a path, PATH=MS (repeatable)");
+    app.add_option("--rss-budget", options.rss_budgets, "Budget for the maximum RSS of a path, PATH=KIB (repeatable)");
+    CLI11_PARSE(app, argc, argv);
+
+    if (options.files_per_dir < 1) options.files_per_dir = 1;
+    if (options.commit_path.empty()) {
+        options.commit_path = (fs::read_symlink("/proc/self/exe").parent_path() / "commit").string();
+    }
+    options.commit_path = fs::absolute(options.commit_path).string();
+
+    bool temporary = options.work_dir.empty();
+    fs::path work_dir = options.work_dir;
+    int rc = 0;
+    try {
+        if (temporary) {
+            std::string pattern = (fs::temp_directory_path() / "commit_startup_bench.XXXXXX").string();
+            if (!::mkdtemp(pattern.data())) {
+                throw std::runtime_error(std::string("mkdtemp() failed: ") + std::strerror(errno));
+            }
+            work_dir = pattern;
+        }
+        auto budgets = parse_budgets(options.budgets);
+        auto rss_budgets = parse_budgets(options.rss_budgets);
+
+        // Keep the user's config, logs, caches and daemon out of the measurement
+        fs::path home = work_dir / "home";
+        fs::create_directories(home / "config");
+        ::setenv("XDG_CONFIG_HOME", (home / "config").c_str(), 1);
+        ::setenv("XDG_DATA_HOME", (home / "data").c_str(), 1);
+        ::setenv("XDG_CACHE_HOME", (home / "cache").c_str(), 1);
+        ::setenv("XDG_RUNTIME_DIR", home.c_str(), 1);
+        ::unsetenv("COMMITD_SOCKET");  // Checked before XDG_RUNTIME_DIR
+        fs::path config_path = home / "config" / "config.txt";
+        std::ofstream(config_path) << "backend=openrouter\nmodel=openai/gpt-4o-mini\nopenrouter_api_key=bench\nauto_push=false\n";
+
+        fs::path repo = work_dir / "repo";
+        std::cout << "Creating a repository with " << options.files << " files and " << options.history << " commits in " << repo.string() << std::endl;
+        create_repository(repo);
+        write_stats_log(repo);
+
+        std::vector<BenchPath> paths = {
+            {"repo-root", {"--repo-root"}},
+            {"list-configs", {"--list-configs"}},
+            {"manual-commit", {"-a", "-m", "Bench commit"}, true},
+            {"summarize-logs", {"--summarize-logs"}},
+        };
+
+        std::cout << std::left << std::setw(16) << "path" << std::right << std::setw(12) << "cold mean" << std::setw(12) << "warm mean"
+                  << std::setw(12) << "warm p95" << std::setw(13) << "max RSS" << "  budget" << std::endl;
+        int round = 0;
+        for (const auto& path : paths) {
+            std::vector<std::string> argv = {options.commit_path, "--config", config_path.string()};
+            argv.insert(argv.end(), path.args.begin(), path.args.end());
+            auto measure = [&](bool cold) {
+                if (path.commits) change_files(repo, round++);
+                if (cold) make_cold(repo);
+                return run(argv, repo);
+            };
+
+            std::vector<Sample> cold_samples;
+            for (int i = 0; i < options.cold_runs; ++i) {
+                cold_samples.push_back(measure(true));
+            }
+            measure(false);
+            std::vector<Sample> warm_samples;
+            for (int i = 0; i < options.runs; ++i) {
+                warm_samples.push_back(measure(false));
+            }
+
+            long max_rss = 0;
+            for (const auto& samples : {cold_samples, warm_samples}) {
+                for (const auto& sample : samples) max_rss = std::max(max_rss, sample.rss_kib);
+            }
+            double p95 = percentile(warm_samples, 95);
+
+            std::string verdict;
+            if (budgets.count(path.name)) {
+                bool over = p95 > budgets[path.name];
+                verdict += (over ? "p95 OVER " : "p95 ok ") + std::to_string(static_cast<long>(budgets[path.name])) + " ms";
+                if (over) rc = 1;
+            }
+            if (rss_budgets.count(path.name)) {
+                bool over = max_rss > rss_budgets[path.name];
+                verdict += std::string(verdict.empty() ? "" : ", ") + (over ? "RSS OVER " : "RSS ok ") + std::to_string(static_cast<long>(rss_budgets[path.name])) + " KiB";
+                if (over) rc = 1;
+            }
+
+            std::cout << std::left << std::setw(16) << path.name << std::right << std::fixed << std::setprecision(1)
+                      << std::setw(9) << mean(cold_samples) << " ms" << std::setw(9) << mean(warm_samples) << " ms"
+                      << std::setw(9) << p95 << " ms" << std::setw(9) << max_rss << " KiB"
+                      << "  " << (verdict.empty() ? "-" : verdict) << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        rc = 1;
+    }
+
+    if (temporary && !options.keep && !work_dir.empty()) {
+        std::error_code ec;
+        fs::remove_all(work_dir, ec);
+    } else if (!work_dir.empty()) {
+        std::cout << "Repository kept in " << (work_dir / "repo").string() << std::endl;
+    }
+    if (rc != 0) {
+        std::cerr << "Startup budget exceeded or a run failed" << std::endl;
+    }
+    return rc;
+}
@@ -0,0 +1,446 @@
+// Local stand-in for the OpenRouter and Zen HTTP APIs. Point the backends at it with
+// --base-url http://127.0.0.1:8089/api/v1 (OpenRouter) or http://127.0.0.1:8089/zen/v1
+// (Zen) to measure CurlRequest behaviour under slow, throttled or failing providers.
+#include <CLI/CLI.hpp>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+struct ServerOptions {
+    std::string bind = "127.0.0.1";
+    int port = 8089;
+    int latency_ms = 0;          // Delay before the response headers (time to first byte)
+    int jitter_ms = 0;           // Uniform extra delay on top of latency_ms
+    long throttle_bps = 0;       // Body bytes per second, 0 for unlimited
+    bool chunked = false;        // Use chunked transfer encoding for every response
+    bool sse = false;            // Stream chat completions as server-sent events even without "stream": true
+    double error_rate = 0.0;     // Fraction of requests answered with an injected error status
+    std::vector<int> error_statuses = {429};
+    double drop_rate = 0.0;      // Fraction of connections closed halfway through the response
+    unsigned seed = 1;
+};
+
+struct Request {
+    std::string method;
+    std::string path;
+    std::string query;
+    std::string body;
+    bool keep_alive = true;
+};
+
+struct Response {
+    int status = 200;
+    std::string content_type = "application/json";
+    std::string body;
+    std::vector<std::string> sse_events;  // Sent as text/event-stream when non-empty
+    std::vector<std::string> extra_headers;
+};
+
+static ServerOptions options;
+static std::mutex rng_mutex;
+static std::mt19937 rng;
+static std::atomic<unsigned long> generation_counter{0};
+
+static double random_unit() {
+    std::lock_guard<std::mutex> lock(rng_mutex);
+    return std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+}
+
+static const char* status_text(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 429: return "Too Many Requests";
+        case 500: return "Internal Server Error";
+        case 502: return "Bad Gateway";
+        case 503: return "Service Unavailable";
+        case 504: return "Gateway Timeout";
+        default: return "Error";
+    }
+}
+
+static bool send_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::send(fd, data, len, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Sends body bytes, sleeping between slices to honour --throttle-bps
+static bool send_throttled(int fd, const std::string& data) {
+    if (options.throttle_bps <= 0) {
+        return send_all(fd, data.data(), data.size());
+    }
+    const auto slice_time = std::chrono::milliseconds(50);
+    size_t slice = std::max<size_t>(1, static_cast<size_t>(options.throttle_bps / 20));
+    for (size_t pos = 0; pos < data.size(); pos += slice) {
+        size_t len = std::min(slice, data.size() - pos);
+        if (!send_all(fd, data.data() + pos, len)) return false;
+        std::this_thread::sleep_for(slice_time);
+    }
+    return true;
+}
+
+static bool send_chunk(int fd, const std::string& data) {
+    std::stringstream ss;
+    ss << std::hex << data.size() << "\r\n";
+    return send_all(fd, ss.str().data(), ss.str().size()) && send_throttled(fd, data) && send_all(fd, "\r\n", 2);
+}
+
+static bool read_request(int fd, std::string& buffer, Request& req) {
+    size_t header_end;
+    while ((header_end = buffer.find("\r\n\r\n")) == std::string::npos) {
+        char tmp[8192];
+        ssize_t n = ::recv(fd, tmp, sizeof(tmp), 0);
+        if (n <= 0) return false;
+        buffer.append(tmp, static_cast<size_t>(n));
+    }
+    std::istringstream headers(buffer.substr(0, header_end));
+    std::string line;
+    std::getline(headers, line);
+    std::istringstream request_line(line);
+    std::string target, version;
+    request_line >> req.method >> target >> version;
+    size_t q = target.find('?');
+    req.path = target.substr(0, q);
+    req.query = q == std::string::npos ? "" : target.substr(q + 1);
+    req.keep_alive = version != "HTTP/1.0";
+
+    size_t content_length = 0;
+    while (std::getline(headers, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        std::string name = line.substr(0, colon);
+        std::string value = line.substr(colon + 1);
+        value.erase(0, value.find_first_not_of(' '));
+        for (auto& c : name) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        if (name == "content-length") {
+            content_length = std::stoul(value);
+        } else if (name == "connection") {
+            req.keep_alive = value.find("close") == std::string::npos;
+        }
+    }
+
+    size_t body_start = header_end + 4;
+    while (buffer.size() < body_start + content_length) {
+        char tmp[8192];
+        ssize_t n = ::recv(fd, tmp, sizeof(tmp), 0);
+        if (n <= 0) return false;
+        buffer.append(tmp, static_cast<size_t>(n));
+    }
+    req.body = buffer.substr(body_start, content_length);
+    buffer.erase(0, body_start + content_length);
+    return true;
+}
+
+static const char* SYNTHETIC_MESSAGE = "Update synthetic test files\n\n- Response generated by commit_test_server";
+
+static double estimate_prompt_tokens(const std::string& body) {
+    return static_cast<double>(body.size() / 4);
+}
+
+static std::vector<std::string> sse_chunks(const std::string& id, const std::string& model) {
+    std::vector<std::string> events;
+    std::istringstream words(SYNTHETIC_MESSAGE);
+    std::string word;
+    bool first = true;
+    while (words >> word) {
+        nlohmann::json chunk = {
+            {"id", id},
+            {"model", model},
+            {"choices", {{{"index", 0}, {"delta", {{"content", (first ? "" : " ") + word}}}}}}
+        };
+        events.push_back(chunk.dump());
+        first = false;
+    }
+    events.push_back("[DONE]");
+    return events;
+}
+
+static Response handle_chat(const Request& req, bool anthropic) {
+    Response res;
+    nlohmann::json body = nlohmann::json::parse(req.body, nullptr, false);
+    if (body.is_discarded()) {
+        res.status = 400;
+        res.body = R"({"error":{"message":"Request body is not valid JSON","code":400}})";
+        return res;
+    }
+    std::string model = body.value("model", "test/model");
+    std::string id = "gen-test-" + std::to_string(++generation_counter);
+    double prompt_tokens = estimate_prompt_tokens(req.body);
+    int n = body.value("n", 1);
+
+    if (!anthropic && (options.sse || body.value("stream", false))) {
+        res.sse_events = sse_chunks(id, model);
+        return res;
+    }
+
+    nlohmann::json j;
+    if (anthropic) {
+        j = {
+            {"id", id},
+            {"type", "message"},
+            {"model", model},
+            {"content", {{{"type", "text"}, {"text", SYNTHETIC_MESSAGE}}}},
+            {"usage", {{"input_tokens", prompt_tokens}, {"output_tokens", 16}}}
+        };
+    } else {
+        nlohmann::json choices = nlohmann::json::array();
+        for (int i = 0; i < std::max(1, n); ++i) {
+            choices.push_back({
+                {"index", i},
+                {"message", {{"role", "assistant"}, {"content", SYNTHETIC_MESSAGE}}},
+                {"finish_reason", "stop"}
+            });
+        }
+        j = {
+            {"id", id},
+            {"model", model},
+            {"choices", choices},
+            {"usage", {{"prompt_tokens", prompt_tokens}, {"completion_tokens", 16 * std::max(1, n)}}}
+        };
+    }
+    res.body = j.dump();
+    return res;
+}
+
+static const int MODEL_COUNT = 200;
+
+static nlohmann::json model_entry(bool zen, int i) {
+    std::string id = (zen ? "test-model-" : "test/model-") + std::to_string(i);
+    nlohmann::json m = {
+        {"id", id},
+        {"name", "Test Model " + std::to_string(i)},
+        {"description", "Synthetic model served by commit_test_server"}
+    };
+    if (zen) {
+        m["pricing"] = "Free";
+    } else {
+        m["pricing"] = {{"prompt", "0.000001"}, {"completion", "0.000002"}};
+    }
+    return m;
+}
+
+static Response handle_models(bool zen) {
+    nlohmann::json data = nlohmann::json::array();
+    for (int i = 0; i < MODEL_COUNT; ++i) {
+        data.push_back(model_entry(zen, i));
+    }
+    Response res;
+    res.body = nlohmann::json{{"data", data}}.dump();
+    return res;
+}
+
+// Zen's /models/<model>: one entry of the listing, 404 for an unknown id
+static Response handle_zen_model(const std::string& id) {
+    Response res;
+    const std::string prefix = "test-model-";
+    if (id.rfind(prefix, 0) == 0 && id.size() > prefix.size() && id.find_first_not_of("0123456789", prefix.size()) == std::string::npos) {
+        int i = std::stoi(id.substr(prefix.size()));
+        if (i < MODEL_COUNT) {
+            res.body = model_entry(true, i).dump();
+            return res;
+        }
+    }
+    res.status = 404;
+    res.body = nlohmann::json{{"error", {{"message", "Unknown model " + id}, {"code", 404}}}}.dump();
+    return res;
+}
+
+static Response route(const Request& req) {
+    Response res;
+    if (req.method == "POST" && req.path == "/api/v1/chat/completions") {
+        return handle_chat(req, false);
+    } else if (req.method == "GET" && req.path == "/api/v1/models") {
+        return handle_models(false);
+    } else if (req.method == "GET" && req.path == "/api/v1/credits") {
+        res.body = R"({"data":{"total_credits":25.0,"total_usage":7.5}})";
+    } else if (req.method == "GET" && req.path == "/api/v1/generation") {
+        res.body = nlohmann::json{{"data", {
+            {"id", req.query.substr(req.query.find('=') + 1)},
+            {"total_cost", 0.0001},
+            {"latency", options.latency_ms},
+            {"generation_time", 120},
+            {"tokens_prompt", 1000},
+            {"tokens_completion", 16}
+        }}}.dump();
+    } else if (req.method == "POST" && req.path == "/zen/v1/chat/completions") {
+        return handle_chat(req, false);
+    } else if (req.method == "POST" && req.path == "/zen/v1/messages") {
+        return handle_chat(req, true);
+    } else if (req.method == "GET" && req.path == "/zen/v1/models") {
+        return handle_models(true);
+    } else if (req.method == "GET" && req.path.rfind("/zen/v1/models/", 0) == 0) {
+        return handle_zen_model(req.path.substr(std::strlen("/zen/v1/models/")));
+    } else {
+        res.status = 404;
+        res.body = R"({"error":{"message":"Unknown endpoint","code":404}})";
+    }
+    return res;
+}
+
+// Returns false when the connection should be closed
+static bool send_response(int fd, const Request& req, Response res) {
+    if (options.error_rate > 0.0 && random_unit() < options.error_rate) {
+        int status;
+        {
+            std::lock_guard<std::mutex> lock(rng_mutex);
+            status = options.error_statuses[rng() % options.error_statuses.size()];
+        }
+        res = Response{};
+        res.status = status;
+        res.body = nlohmann::json{{"error", {{"message", "Injected " + std::to_string(status) + " from commit_test_server"}, {"code", status}}}}.dump();
+        if (status == 429) res.extra_headers.push_back("Retry-After: 1");
+    }
+
+    int delay = options.latency_ms;
+    if (options.jitter_ms > 0) {
+        delay += static_cast<int>(random_unit() * options.jitter_ms);
+    }
+    if (delay > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+    }
+
+    bool stream = !res.sse_events.empty();
+    bool chunked = options.chunked || stream;
+    std::stringstream head;
+    head << "HTTP/1.1 " << res.status << " " << status_text(res.status) << "\r\n";
+    head << "Content-Type: " << (stream ? "text/event-stream" : res.content_type) << "\r\n";
+    if (chunked) {
+        head << "Transfer-Encoding: chunked\r\n";
+    } else {
+        head << "Content-Length: " << res.body.size() << "\r\n";
+    }
+    for (const auto& h : res.extra_headers) {
+        head << h << "\r\n";
+    }
+    head << "Connection: " << (req.keep_alive ? "keep-alive" : "close") << "\r\n\r\n";
+    std::string header = head.str();
+
+    bool drop = options.drop_rate > 0.0 && random_unit() < options.drop_rate;
+    if (!send_all(fd, header.data(), header.size())) return false;
+
+    if (stream) {
+        for (size_t i = 0; i < res.sse_events.size(); ++i) {
+            if (drop && i == res.sse_events.size() / 2) return false;
+            if (!send_chunk(fd, "data: " + res.sse_events[i] + "\n\n")) return false;
+        }
+        return send_all(fd, "0\r\n\r\n", 5) && req.keep_alive;
+    }
+    if (drop) {
+        send_throttled(fd, res.body.substr(0, res.body.size() / 2));
+        return false;
+    }
+    if (chunked) {
+        const size_t chunk_size = 4096;
+        for (size_t pos = 0; pos < res.body.size(); pos += chunk_size) {
+            if (!send_chunk(fd, res.body.substr(pos, chunk_size))) return false;
+        }
+        return send_all(fd, "0\r\n\r\n", 5) && req.keep_alive;
+    }
+    return send_throttled(fd, res.body) && req.keep_alive;
+}
+
+static Response bad_request(const std::string& message) {
+    Response res;
+    res.status = 400;
+    res.body = nlohmann::json{{"error", {{"message", message}, {"code", 400}}}}.dump();
+    return res;
+}
+
+// A malformed request is answered with 400 instead of taking the whole server down
+static void serve_connection(int fd) {
+    std::string buffer;
+    Request req;
+    while (true) {
+        try {
+            if (!read_request(fd, buffer, req)) break;
+        } catch (const std::exception& e) {
+            // The framing is unknown after a bad header, so the connection cannot be reused
+            req.keep_alive = false;
+            std::cerr << "Malformed request: " << e.what() << std::endl;
+            send_response(fd, req, bad_request(std::string("Malformed request: ") + e.what()));
+            break;
+        }
+        Response res;
+        try {
+            res = route(req);
+        } catch (const std::exception& e) {
+            res = bad_request(e.what());
+        }
+        std::cerr << req.method << " " << req.path << " -> " << res.status << std::endl;
+        if (!send_response(fd, req, std::move(res))) break;
+    }
+    ::close(fd);
+}
+
+int main(int argc, char** argv) {
+    CLI::App app{"commit_test_server - local stand-in for the OpenRouter and Zen APIs"};
+    app.add_option("--bind", options.bind, "Address to listen on");
+    app.add_option("--port", options.port, "Port to listen on");
+    app.add_option("--latency-ms", options.latency_ms, "Delay before sending response headers");
+    app.add_option("--jitter-ms", options.jitter_ms, "Uniform random extra delay");
+    app.add_option("--throttle-bps", options.throttle_bps, "Limit response bodies to this many bytes per second");
+    app.add_flag("--chunked", options.chunked, "Send every response with chunked transfer encoding");
+    app.add_flag("--sse", options.sse, "Stream chat completions as server-sent events");
+    app.add_option("--error-rate", options.error_rate, "Fraction of requests answered with an injected error (0.0-1.0)");
+    app.add_option("--error-status", options.error_statuses, "Status codes to inject, chosen at random (default: 429)");
+    app.add_option("--drop-rate", options.drop_rate, "Fraction of responses cut off by closing the connection (0.0-1.0)");
+    app.add_option("--seed", options.seed, "Seed for error and drop injection");
+    CLI11_PARSE(app, argc, argv);
+
+    rng.seed(options.seed);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0) {
+        std::cerr << "Error: socket() failed: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    int yes = 1;
+    ::setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(options.port));
+    if (::inet_pton(AF_INET, options.bind.c_str(), &addr.sin_addr) != 1) {
+        std::cerr << "Error: invalid bind address " << options.bind << std::endl;
+        return 1;
+    }
+    if (::bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(listener, 128) != 0) {
+        std::cerr << "Error: cannot listen on " << options.bind << ":" << options.port << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    std::cout << "Listening on http://" << options.bind << ":" << options.port << std::endl;
+    std::cout << "  OpenRouter base URL: http://" << options.bind << ":" << options.port << "/api/v1" << std::endl;
+    std::cout << "  Zen base URL:        http://" << options.bind << ":" << options.port << "/zen/v1" << std::endl;
+
+    while (true) {
+        int fd = ::accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Error: accept() failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        std::thread(serve_connection, fd).detach();
+    }
+    ::close(listener);
+    return 0;
+}